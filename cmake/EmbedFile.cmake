@@ -0,0 +1,24 @@
+# Writes the contents of INPUT to OUTPUT as a C++ byte array named SYMBOL,
+# with its length in SYMBOL_size, in namespace sqlengine.
+#   cmake -DINPUT=<file> -DOUTPUT=<file.cpp> -DSYMBOL=<name> -P EmbedFile.cmake
+
+file(READ "${INPUT}" content HEX)
+string(LENGTH "${content}" hex_length)
+math(EXPR size "${hex_length} / 2")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${content}")
+string(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)" "\\1\n    " bytes "${bytes}")
+
+get_filename_component(name "${INPUT}" NAME)
+file(WRITE "${OUTPUT}"
+"// Generated from ${name}; do not edit
+#include <cstddef>
+
+namespace sqlengine {
+
+alignas(4) extern const unsigned char ${SYMBOL}[] = {
+    ${bytes}
+};
+extern const size_t ${SYMBOL}_size = ${size};
+
+} // namespace sqlengine
+")
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "arrow_ipc.h"
+#include "storage.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Structures of the Arrow C Data Interface, as specified by Arrow (the
+// guard lets them coexist with Arrow's own headers)
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C" {
+
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+
+} // extern "C"
+
+#endif // ARROW_C_DATA_INTERFACE
+
+namespace sqlengine {
+
+// Exchange of tables and results with Arrow through the C Data Interface.
+// A table or result is a struct array ("+s") with one child per column:
+// INTEGER as int64 ("l"), REAL as float64 ("g"), BOOLEAN as "b", TEXT as
+// utf8 ("u") and NULL-only result columns as "n".
+
+// Hands the columns over to the consumer, which owns them until it calls
+// the release callbacks; their buffers are passed without being copied
+void exportArrowColumns(std::vector<ArrowColumn> columns, int64_t length,
+                        ArrowSchema* out_schema, ArrowArray* out_array);
+
+// Rows are stored row-wise, so the values are copied into column buffers
+// once; the buffers are then exported as above
+void exportArrowTable(const Table& table, ArrowSchema* out_schema, ArrowArray* out_array);
+
+// Appends the rows of a struct array to a table, creating the table from
+// the Arrow schema if it does not exist. Columns are matched by position;
+// any integer type loads into INTEGER, float32/float64 into REAL and
+// utf8/large_utf8 into TEXT. Rows go through Table::insertRows, so nothing
+// is stored if a row does not fit the table. Takes ownership of the schema
+// and array and releases them, also when throwing std::runtime_error.
+void importArrowArray(Database& database, const std::string& table_name,
+                      ArrowSchema* schema, ArrowArray* array);
+
+} // namespace sqlengine
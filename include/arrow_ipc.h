@@ -0,0 +1,51 @@
+#pragma once
+
+#include "types.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sqlengine {
+
+// Rows per record batch of an encoded stream
+constexpr size_t kArrowBatchRows = 64 * 1024;
+
+// One column in Arrow's physical layout: a validity bitmap (bit set = not
+// NULL) followed by the values, as little-endian int64 for INTEGER, double
+// for REAL and one bit per row for BOOLEAN; TEXT has int32 offsets into
+// UTF-8 bytes. A NULL_TYPE column holds only NULLs and has no buffers.
+// The validity bitmap is left empty while the column has no NULLs.
+struct ArrowColumn {
+    std::string name;
+    DataType type;
+    bool nullable = true;
+    int64_t length = 0;
+    int64_t null_count = 0;
+    std::vector<uint8_t> validity;
+    std::vector<uint8_t> values;
+    std::vector<int32_t> offsets; // TEXT only, length + 1 entries
+
+    ArrowColumn(const std::string& n, DataType t, bool null = true);
+
+    void reserve(size_t rows);
+
+    // INTEGER values are widened in REAL columns; any other value that
+    // does not match the column type throws std::runtime_error
+    void append(const Value& value);
+};
+
+// Columns of a schema filled with rows [begin, end)
+std::vector<ArrowColumn> rowsToArrowColumns(const Schema& schema, const std::vector<Row>& rows,
+                                            size_t begin, size_t end);
+
+// Gives each NULL_TYPE column of the schema (a column whose type depends
+// on the data, such as a NULL literal) the type of its first non-NULL value
+Schema resolveResultSchema(const Schema& schema, const std::vector<Row>& rows);
+
+// Encodes rows in the Arrow IPC streaming format: a schema message, one
+// record batch per batch_rows rows and the end-of-stream marker. Clients
+// read the column buffers in place, without parsing individual values.
+std::string encodeArrowStream(const Schema& schema, const std::vector<Row>& rows,
+                              size_t batch_rows = kArrowBatchRows);
+
+} // namespace sqlengine
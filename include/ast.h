@@ -1,7 +1,11 @@
 #pragma once
 
 #include "types.h"
+#include <cstddef>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
 #include <vector>
 #include <string>
 
@@ -17,6 +21,50 @@ public:
     virtual void accept(ASTVisitor& visitor) = 0;
 };
 
+// Memory for the nodes of one parsed query. Allocation bumps a pointer
+// through blocks that are only released, all at once, when the arena is
+// destroyed, so a query's tree costs a handful of mallocs instead of one
+// per node. The arena must outlive every node allocated from it.
+class AstArena {
+public:
+    AstArena() : resource_(initial_block_, sizeof(initial_block_)) {}
+    
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+    
+    void* allocate(size_t size, size_t alignment) { return resource_.allocate(size, alignment); }
+    
+private:
+    alignas(std::max_align_t) std::byte initial_block_[4096];
+    std::pmr::monotonic_buffer_resource resource_;
+};
+
+// Owning pointer to an AST node. Nodes in an arena are destroyed in place
+// (their memory goes with the arena); others are deleted.
+struct AstDeleter {
+    bool in_arena = false;
+    void operator()(ASTNode* node) const {
+        if (in_arena) {
+            node->~ASTNode();
+        } else {
+            delete node;
+        }
+    }
+};
+
+template <typename T>
+using AstPtr = std::unique_ptr<T, AstDeleter>;
+
+// Creates a node in arena, or on the heap if arena is null
+template <typename T, typename... Args>
+AstPtr<T> makeNode(AstArena* arena, Args&&... args) {
+    if (!arena) {
+        return AstPtr<T>(new T(std::forward<Args>(args)...));
+    }
+    void* memory = arena->allocate(sizeof(T), alignof(T));
+    return AstPtr<T>(new (memory) T(std::forward<Args>(args)...), AstDeleter{true});
+}
+
 // Expression nodes
 class Expression : public ASTNode {
 public:
@@ -53,11 +101,11 @@ public:
         AND, OR
     };
     
-    std::unique_ptr<Expression> left;
+    AstPtr<Expression> left;
     Operator op;
-    std::unique_ptr<Expression> right;
+    AstPtr<Expression> right;
     
-    BinaryExpression(std::unique_ptr<Expression> l, Operator o, std::unique_ptr<Expression> r)
+    BinaryExpression(AstPtr<Expression> l, Operator o, AstPtr<Expression> r)
         : left(std::move(l)), op(o), right(std::move(r)) {}
     void accept(ASTVisitor& visitor) override;
 };
@@ -70,27 +118,60 @@ public:
     };
     
     Operator op;
-    std::unique_ptr<Expression> operand;
+    AstPtr<Expression> operand;
     
-    UnaryExpression(Operator o, std::unique_ptr<Expression> expr)
+    UnaryExpression(Operator o, AstPtr<Expression> expr)
         : op(o), operand(std::move(expr)) {}
     void accept(ASTVisitor& visitor) override;
 };
 
+// Aggregate function call
+class AggregateExpression : public Expression {
+public:
+    enum class Function {
+        COUNT, SUM, MIN, MAX, AVG
+    };
+    
+    Function function;
+    AstPtr<Expression> argument; // null for COUNT(*)
+    
+    AggregateExpression(Function f, AstPtr<Expression> arg)
+        : function(f), argument(std::move(arg)) {}
+    void accept(ASTVisitor& visitor) override;
+};
+
 // Statement nodes
 class Statement : public ASTNode {
 public:
     virtual ~Statement() = default;
 };
 
+// ORDER BY item
+struct OrderByItem {
+    std::string table; // optional
+    std::string column;
+    bool descending = false;
+    bool nulls_first = false; // defaults to descending unless NULLS FIRST/LAST is given
+};
+
+// [INNER] JOIN table [alias] ON condition
+struct JoinClause {
+    std::string table;
+    std::string alias; // optional
+    AstPtr<Expression> condition;
+};
+
 // SELECT statement
 class SelectStatement : public Statement {
 public:
-    std::vector<std::unique_ptr<Expression>> select_list;
+    std::vector<AstPtr<Expression>> select_list;
     std::string from_table;
-    std::unique_ptr<Expression> where_clause; // optional
-    std::vector<std::string> order_by; // optional
-    bool order_desc = false;
+    std::string from_alias; // optional
+    std::vector<JoinClause> joins; // optional
+    AstPtr<Expression> where_clause; // optional
+    std::vector<AstPtr<Expression>> group_by; // optional
+    AstPtr<Expression> having; // optional
+    std::vector<OrderByItem> order_by; // optional
     int limit = -1; // optional
     
     void accept(ASTVisitor& visitor) override;
@@ -101,16 +182,17 @@ class InsertStatement : public Statement {
 public:
     std::string table_name;
     std::vector<std::string> columns; // optional, if empty insert into all columns
-    std::vector<std::vector<std::unique_ptr<Expression>>> values;
+    std::vector<std::vector<AstPtr<Expression>>> values;
     
     void accept(ASTVisitor& visitor) override;
 };
 
-// CREATE TABLE statement
+// CREATE TABLE statement, or CREATE EXTERNAL TABLE name FROM 'path'
 class CreateTableStatement : public Statement {
 public:
     std::string table_name;
-    std::vector<Column> columns;
+    std::vector<Column> columns; // empty for external tables, which take the file's schema
+    std::string source_path;     // external tables only
     
     void accept(ASTVisitor& visitor) override;
 };
@@ -124,6 +206,40 @@ public:
     void accept(ASTVisitor& visitor) override;
 };
 
+// CREATE MATERIALIZED VIEW name [(column, ...)] AS SELECT ...
+class CreateMaterializedViewStatement : public Statement {
+public:
+    std::string view_name;
+    std::vector<std::string> column_names; // optional, otherwise derived from the query
+    AstPtr<SelectStatement> query;
+    
+    void accept(ASTVisitor& visitor) override;
+};
+
+// DROP MATERIALIZED VIEW statement
+class DropMaterializedViewStatement : public Statement {
+public:
+    std::string view_name;
+    
+    DropMaterializedViewStatement(const std::string& name) : view_name(name) {}
+    void accept(ASTVisitor& visitor) override;
+};
+
+// COPY table {FROM | TO} 'path' [WITH (FORMAT {CSV | COLUMNAR}, HEADER [bool], DELIMITER 'c')]
+class CopyStatement : public Statement {
+public:
+    enum class Format { CSV, COLUMNAR };
+    
+    std::string table_name;
+    std::string path;
+    bool to_file = false; // COPY TO
+    Format format = Format::CSV;
+    bool header = false;   // CSV only
+    char delimiter = ',';  // CSV only
+    
+    void accept(ASTVisitor& visitor) override;
+};
+
 // Visitor pattern interface
 class ASTVisitor {
 public:
@@ -133,10 +249,24 @@ public:
     virtual void visit(ColumnExpression& node) = 0;
     virtual void visit(BinaryExpression& node) = 0;
     virtual void visit(UnaryExpression& node) = 0;
+    virtual void visit(AggregateExpression& node) = 0;
     virtual void visit(SelectStatement& node) = 0;
     virtual void visit(InsertStatement& node) = 0;
     virtual void visit(CreateTableStatement& node) = 0;
     virtual void visit(DropTableStatement& node) = 0;
+    virtual void visit(CreateMaterializedViewStatement& node) = 0;
+    virtual void visit(DropMaterializedViewStatement& node) = 0;
+    virtual void visit(CopyStatement& node) = 0;
 };
 
+// Name of an aggregate function as written in SQL
+const char* aggregateFunctionName(AggregateExpression::Function function);
+
+// Render an expression as SQL text
+std::string expressionToString(Expression& expr);
+
+// One-line description of how a statement is executed, e.g.
+// "Scan(users) -> Filter(age > 30) -> Project(name)"
+std::string describePlan(Statement& statement);
+
 } // namespace sqlengine
\ No newline at end of file
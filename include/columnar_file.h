@@ -0,0 +1,84 @@
+#pragma once
+
+#include "types.h"
+#include "storage.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sqlengine {
+
+// Rows per row group written by writeColumnarFile
+constexpr size_t kColumnarRowGroupRows = 64 * 1024;
+
+// Columnar table file, laid out like Parquet: the rows are split into row
+// groups, and each row group stores one chunk per column. A chunk is an
+// optional dictionary page followed by a data page holding the NULL
+// positions (as run lengths) and the non-NULL values, encoded PLAIN, as
+// runs of equal values (RLE), or as run-length encoded indices into the
+// dictionary, whichever is smallest. A footer at the end of the file
+// holds the schema and, per chunk, its location, NULL count and min/max
+// values, so a reader can skip row groups and read only some columns.
+//
+//   "SQLCOL1\0" | chunks ... | footer | uint32 footer length | "SQLCOL1\0"
+
+// Location and statistics of one column chunk
+struct ColumnChunkInfo {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint64_t null_count = 0;
+    Value min; // NULL if the chunk has only NULLs or no statistics
+    Value max;
+    bool has_stats = true; // false if the chunk holds a NaN, which no min/max can order
+};
+
+struct RowGroupInfo {
+    uint64_t rows = 0;
+    std::vector<ColumnChunkInfo> columns;
+};
+
+// Writes rows to a columnar file. The file is written under a temporary
+// name and renamed, so readers never see a partial file. Throws
+// std::runtime_error on I/O errors.
+void writeColumnarFile(const std::string& path, const Schema& schema, const std::vector<Row>& rows,
+                       size_t row_group_rows = kColumnarRowGroupRows);
+
+// Reads a columnar file. Only the footer is read when the file is opened;
+// chunks are read when their row group is, with positioned reads, so one
+// reader can serve several scans at once.
+class ColumnarFileReader {
+public:
+    explicit ColumnarFileReader(const std::string& path);
+    ~ColumnarFileReader();
+
+    ColumnarFileReader(const ColumnarFileReader&) = delete;
+    ColumnarFileReader& operator=(const ColumnarFileReader&) = delete;
+
+    const std::string& getPath() const { return path_; }
+    const Schema& getSchema() const { return schema_; }
+    const std::vector<RowGroupInfo>& getRowGroups() const { return row_groups_; }
+    uint64_t getRowCount() const;
+
+    // True if the statistics of the row group show that none of its rows
+    // passes all filters
+    bool canSkip(size_t row_group, const std::vector<ScanFilter>& filters) const;
+
+    // Appends the rows of a row group, reading only the chunks of the
+    // requested columns (all columns if columns is empty); other columns
+    // are NULL
+    void readRowGroup(size_t row_group, const std::vector<bool>& columns, std::vector<Row>& rows) const;
+
+    // Rows of every row group the request's filters cannot skip
+    std::vector<Row> scan(const ScanRequest& request) const;
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    Schema schema_;
+    std::vector<RowGroupInfo> row_groups_;
+
+    void readFooter();
+    std::string readBytes(uint64_t offset, uint64_t size) const;
+};
+
+} // namespace sqlengine
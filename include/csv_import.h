@@ -0,0 +1,27 @@
+#pragma once
+
+#include "storage.h"
+#include "query_control.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sqlengine {
+
+struct CsvOptions {
+    char delimiter = ',';
+    bool header = false;   // skip the first record
+    unsigned threads = 0;  // parse threads, 0 = one per hardware thread
+};
+
+// Loads a CSV file (RFC 4180 quoting, LF or CRLF line ends) into a table.
+// The file is memory-mapped and split into chunks at record boundaries;
+// chunks are parsed in parallel, each field converted to the type of its
+// column, and all rows are stored with one Table::insertRows, so a file
+// with a bad record leaves the table unchanged. An empty unquoted field is
+// NULL and a quoted one ("") an empty string. Throws std::runtime_error
+// naming the first bad record. Returns the number of rows loaded.
+uint64_t copyCsvIntoTable(Table& table, const std::string& path, const CsvOptions& options,
+                          const QueryControl* control = nullptr);
+
+} // namespace sqlengine
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ast.h"
+#include "hash_operators.h"
+#include <vector>
+
+namespace sqlengine {
+
+// Scalar operators over Values, shared by the executor and materialized
+// view maintenance. A NULL operand yields NULL, except that AND and OR
+// follow three-valued logic (FALSE AND NULL is FALSE, TRUE OR NULL is
+// TRUE); type errors, integer overflow and division by zero throw.
+Value evaluateUnary(UnaryExpression::Operator op, const Value& operand);
+Value evaluateBinary(BinaryExpression::Operator op, const Value& left, const Value& right);
+
+// Aggregate calls in an expression tree, in evaluation order; throws if
+// aggregates are nested
+void collectAggregates(Expression& expr, std::vector<AggregateExpression*>& aggregates, bool nested = false);
+
+AggregateKind aggregateKind(const AggregateExpression& aggregate);
+
+} // namespace sqlengine
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ast.h"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sqlengine {
+
+// Expression compiled for the interpreter: a flat register program in one
+// contiguous array, run by a threaded dispatch loop instead of walking the
+// tree with dynamic_casts. Operands are registers or positions of the input
+// row, so columns are resolved once when the program is compiled and read
+// in place. Constants are preloaded into the first registers.
+//
+// Opcodes are typed where the operand types are known statically (column
+// types, literals): e.g. ADD_INT adds two INTEGERs without going through
+// the generic operators. A typed instruction whose operands turn out to be
+// anything else (NULL in particular) falls back to evaluateUnary /
+// evaluateBinary, so results and errors are exactly those of the generic
+// operators.
+class ExpressionProgram {
+public:
+    // Input row position of a leaf and its type, if known
+    struct Slot {
+        size_t index;
+        std::optional<DataType> type;
+    };
+
+    // Binds an expression to a position of the input row: column references
+    // over table rows, or GROUP BY keys and aggregates over grouped rows.
+    // Returns nullopt for expressions compiled from their operands. Errors
+    // it throws are deferred to evaluation, like those of the operators, so
+    // a statement that evaluates nothing does not fail.
+    using Binder = std::function<std::optional<Slot>(const Expression&)>;
+
+    // Evaluates to NULL
+    ExpressionProgram();
+
+    static ExpressionProgram compile(const Expression& expr, const Binder& bind);
+
+    // Not reentrant: the registers belong to the program
+    Value evaluate(const Row& row) const;
+
+private:
+    enum class OpCode : uint8_t {
+        HALT,
+        FAIL,   // throws messages_[left]
+        UNARY,  // generic, operator in sub
+        BINARY, // generic, operator in sub
+        NOT,
+        NEG_INT,
+        NEG_REAL,
+        AND,
+        OR,
+        ADD_INT,
+        SUB_INT,
+        MUL_INT,
+        DIV_INT,
+        ADD_REAL,
+        SUB_REAL,
+        MUL_REAL,
+        DIV_REAL,
+        EQ_INT,
+        NE_INT,
+        LT_INT,
+        LE_INT,
+        GT_INT,
+        GE_INT,
+        EQ_REAL,
+        NE_REAL,
+        LT_REAL,
+        LE_REAL,
+        GT_REAL,
+        GE_REAL
+    };
+
+    // Operands with kRowOperand set index the input row, others registers
+    static constexpr uint32_t kRowOperand = 1u << 31;
+
+    struct Instruction {
+        OpCode op;
+        uint8_t sub;
+        uint32_t dest;
+        uint32_t left;
+        uint32_t right;
+    };
+
+    std::vector<Instruction> code_; // ends with HALT
+    uint32_t result_ = 0;
+    size_t constant_count_ = 0;
+    mutable std::vector<Value> registers_;
+    std::vector<std::string> messages_;
+
+    struct Compiler;
+};
+
+} // namespace sqlengine
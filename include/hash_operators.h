@@ -0,0 +1,144 @@
+#pragma once
+
+#include "types.h"
+#include "memory_tracker.h"
+#include "spill_file.h"
+#include "sort.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sqlengine {
+
+// Aggregate computed by HashAggregator
+enum class AggregateKind {
+    COUNT_STAR,
+    COUNT,
+    SUM,
+    MIN,
+    MAX,
+    AVG
+};
+
+// Running state of one aggregate. Every kind only ever folds new values
+// in, so states can also be maintained incrementally as rows arrive.
+struct AggregateState {
+    Value value;
+    int64_t count = 0;
+    double sum = 0.0; // AVG only
+};
+
+// Fold one argument value into a state (the value is ignored for COUNT(*))
+void accumulateAggregate(AggregateKind kind, AggregateState& state, const Value& value);
+Value finalizeAggregate(AggregateKind kind, const AggregateState& state);
+
+// GROUP BY operator. Groups live in an in-memory hash table keyed by the
+// normalized key encoding (see encodeSortKey). When the query memory budget
+// is exhausted, groups already in the table keep aggregating in memory and
+// rows that would start a new group are written to a partition file chosen
+// by key hash. After the in-memory groups are returned, each partition is
+// aggregated on its own, repartitioning recursively with a different hash
+// seed if it still does not fit.
+class HashAggregator {
+public:
+    HashAggregator(size_t key_count, std::vector<AggregateKind> aggregates,
+                   QueryMemoryContext* memory, std::string spill_directory, size_t level = 0);
+    ~HashAggregator();
+
+    HashAggregator(const HashAggregator&) = delete;
+    HashAggregator& operator=(const HashAggregator&) = delete;
+
+    // Input rows hold the group key values followed by one argument per
+    // aggregate (ignored for COUNT(*))
+    void add(const Row& input);
+
+    // End of input; groups are then returned by next() as the key values
+    // followed by the aggregate results
+    void finish();
+    bool next(Row& row);
+
+    // Partition files written by this operator and its recursive passes
+    size_t getSpilledPartitionCount() const;
+
+private:
+    size_t key_count_;
+    std::vector<SortColumn> key_columns_;
+    std::vector<AggregateKind> aggregates_;
+    QueryMemoryContext* memory_;
+    std::string spill_directory_;
+    size_t level_;
+
+    std::unordered_map<std::string, size_t> group_index_;
+    std::vector<Row> group_keys_;
+    std::vector<AggregateState> states_; // aggregates_.size() per group
+    size_t table_bytes_ = 0;
+    std::string scratch_key_;
+
+    std::vector<std::unique_ptr<SpillFile>> partitions_;
+    size_t spilled_partitions_ = 0;
+    size_t next_partition_ = 0;
+    std::unique_ptr<HashAggregator> child_;
+    size_t output_position_ = 0;
+
+    size_t createGroup(const Row& input);
+    void accumulate(AggregateState* states, const Row& input);
+    void spillRow(const std::string& key, const Row& input);
+    void releaseTable();
+};
+
+// Inner equi-join operator. The build side is loaded into a hash table
+// keyed by the normalized key encoding and probed with rows of the other
+// side. If the build side exceeds the query memory budget, the buffered
+// and all later build rows are partitioned to disk by key hash, probe rows
+// are partitioned the same way, and each partition pair is joined on its
+// own (grace hash join), repartitioning recursively while a build
+// partition is still too large. Rows with a NULL key never match.
+class HashJoin {
+public:
+    using Output = std::function<void(const Row& probe_row, const Row& build_row)>;
+
+    HashJoin(size_t key_count, QueryMemoryContext* memory, std::string spill_directory, size_t level = 0);
+    ~HashJoin();
+
+    HashJoin(const HashJoin&) = delete;
+    HashJoin& operator=(const HashJoin&) = delete;
+
+    // All build rows must be added before the first probe
+    void addBuild(const Row& key, const Row& row);
+
+    // Matches are passed to output immediately when the build side fits in
+    // memory; otherwise they are produced by finish()
+    void probe(const Row& key, const Row& row, const Output& output);
+    void finish(const Output& output);
+
+    // Partition files written by this operator and its recursive passes
+    size_t getSpilledPartitionCount() const { return spilled_partitions_; }
+
+private:
+    std::vector<SortColumn> key_columns_;
+    QueryMemoryContext* memory_;
+    std::string spill_directory_;
+    size_t level_;
+
+    std::unordered_multimap<std::string, Row> table_;
+    size_t table_bytes_ = 0;
+    std::string scratch_key_;
+    Row scratch_values_; // key with REAL values normalized
+
+    std::vector<std::unique_ptr<SpillFile>> build_partitions_;
+    std::vector<std::unique_ptr<SpillFile>> probe_partitions_;
+    size_t spilled_partitions_ = 0;
+
+    // Encodes the key into scratch_key_; false if any key value is NULL
+    // or NaN
+    bool encodeKey(const Row& key);
+    void insertBuild(const std::string& key, const Row& row);
+    void probeEncoded(const std::string& key, const Row& row, const Output& output);
+    void startSpilling();
+    void spillRecord(std::vector<std::unique_ptr<SpillFile>>& partitions, const std::string& key, const Row& row);
+    void releaseTable();
+};
+
+} // namespace sqlengine
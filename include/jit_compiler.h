@@ -0,0 +1,106 @@
+#pragma once
+
+#include "jit_object_cache.h"
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sqlengine {
+
+// LLJIT instance shared by all code generators in the process (one
+// per object cache directory). Modules are compiled on a pool of compile
+// threads with a target machine per compilation, so sessions compiling
+// different queries proceed in parallel; a session waits only for its
+// own module. Every statement is a separate module whose functions are
+// named after its cache key, so identical modules are linked once.
+//
+// A statement's entry function is compiled before it runs. The code of
+// each of its pipelines lives in a module of its own that is only
+// compiled when a function in it is first looked up, so a pipeline that
+// never asks for its code costs nothing.
+//
+// A statement's modules are added under a resource tracker of their own.
+// At most kMaxResidentModules statements stay linked; beyond that the
+// least recently used one that no running statement holds is removed,
+// freeing its code, so a stream of distinct queries runs in bounded
+// memory.
+class JITCompiler {
+public:
+    enum class Source {
+        COMPILED,     // optimized and compiled now
+        LINKED,       // an identical module was already linked
+        OBJECT_CACHE  // loaded from the on-disk object cache
+    };
+
+    // Statements linked into the JIT at the same time
+    static constexpr size_t kMaxResidentModules = 512;
+
+    struct ResidentModule {
+        std::string key;
+        llvm::orc::ResourceTrackerSP tracker;
+    };
+
+    // The statement's code stays linked while a copy of this is alive
+    struct CompiledQuery {
+        void (*entry)(void* executor) = nullptr;
+        Source source = Source::COMPILED;
+        std::shared_ptr<const ResidentModule> module;
+    };
+
+    // Shared instance for an object cache directory ("" for none); created
+    // on first use and destroyed with its last user. Throws if the JIT
+    // cannot be created.
+    static std::shared_ptr<JITCompiler> get(const std::string& object_cache_directory = "");
+
+    JITCompiler(unsigned compile_threads, const std::string& object_cache_directory);
+    ~JITCompiler();
+
+    JITCompiler(const JITCompiler&) = delete;
+    JITCompiler& operator=(const JITCompiler&) = delete;
+
+    // Link a statement's modules and return its entry function; all
+    // modules belong to context. Thread-safe.
+    CompiledQuery compile(std::unique_ptr<llvm::Module> module,
+                          std::vector<std::unique_ptr<llvm::Module>> pipeline_modules,
+                          std::unique_ptr<llvm::LLVMContext> context, const std::string& entry_function);
+
+    // Looks up a function of the statement without waiting: its module is
+    // compiled on the compile threads if it is a pipeline module, then done
+    // gets its address, or null and the error if it could not be compiled.
+    // done may run on a compile thread, or on the caller's thread if the
+    // function is already compiled; the statement stays linked until then.
+    void lookupFunction(const CompiledQuery& query, const std::string& name,
+                        std::function<void(void* address, const std::string& error)> done);
+
+    unsigned getCompileThreads() const { return compile_threads_; }
+
+private:
+    unsigned compile_threads_;
+    std::unique_ptr<PersistentObjectCache> object_cache_;
+    std::unique_ptr<llvm::orc::LLJIT> jit_;
+
+    std::mutex mutex_;
+    // Linked statements, most recently used first, and their cache keys
+    std::list<std::shared_ptr<ResidentModule>> resident_;
+    std::unordered_map<std::string, std::list<std::shared_ptr<ResidentModule>>::iterator> resident_index_;
+
+    // Renames the statement's functions after its key and adds the modules
+    // under tracker; called with mutex_ held
+    void addModules(std::unique_ptr<llvm::Module> module,
+                    std::vector<std::unique_ptr<llvm::Module>> pipeline_modules,
+                    std::unique_ptr<llvm::LLVMContext> context, const std::string& key,
+                    const llvm::orc::ResourceTrackerSP& tracker);
+
+    // Removes least recently used statements nobody holds until at most
+    // kMaxResidentModules remain; called with mutex_ held
+    void evictModules();
+};
+
+} // namespace sqlengine
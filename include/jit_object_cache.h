@@ -0,0 +1,61 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sqlengine {
+
+// Cache key of a generated query module: hex SHA-1 over its IR, the target
+// triple, the host CPU and the LLVM version, so objects are never reused
+// across compilers or machines they were not built for. The module's name
+// is not part of the key. A statement whose pipelines have code of their
+// own passes those modules as well.
+std::string moduleCacheKey(const llvm::Module& module,
+                           const std::vector<std::unique_ptr<llvm::Module>>& pipeline_modules = {});
+
+// Object cache that keeps compiled query objects on disk, one file per
+// module named after its identifier (set to the moduleCacheKey). Objects
+// found there are linked without running the optimizer and code
+// generator, so hot queries skip compilation after a restart. Files are
+// written to a temporary name and renamed, so concurrent processes sharing
+// the directory never see partial objects.
+class PersistentObjectCache : public llvm::ObjectCache {
+public:
+    explicit PersistentObjectCache(std::string directory);
+
+    const std::string& getDirectory() const { return directory_; }
+
+    void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+    // Records whether the module with this identifier is served from disk.
+    // Only watched identifiers are recorded, so modules nobody asks about
+    // (pipeline modules) leave nothing behind.
+    void watchLoad(const std::string& module_identifier);
+
+    // True if the watched module was served from disk; stops watching it
+    bool takeLoaded(const std::string& module_identifier);
+
+    // Objects served from disk and objects written to disk
+    uint64_t getLoads() const { return loads_.load(std::memory_order_relaxed); }
+    uint64_t getStores() const { return stores_.load(std::memory_order_relaxed); }
+
+private:
+    std::string directory_;
+    std::atomic<uint64_t> loads_{0};
+    std::atomic<uint64_t> stores_{0};
+
+    // getObject runs on compile threads
+    std::mutex mutex_;
+    std::unordered_map<std::string, bool> loaded_;
+
+    std::string objectPath(const llvm::Module& module) const;
+};
+
+} // namespace sqlengine
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace sqlengine {
+
+// Executes the pipelines of a prepared statement on behalf of generated
+// code. The entry function receives the executor as an opaque pointer and
+// calls into the runtime below; exceptions never cross generated frames,
+// they are kept here and rethrown once the entry function returns.
+class PipelineExecutor {
+public:
+    virtual ~PipelineExecutor() = default;
+
+    // Whether a pipeline still has to run given what earlier ones produced
+    // (e.g. nothing is probed once a join's build side turned out empty)
+    virtual bool pipelineNeeded(size_t pipeline) = 0;
+    virtual void runPipeline(size_t pipeline) = 0;
+
+    void setError(std::exception_ptr error) { error_ = std::move(error); }
+    bool hasError() const { return error_ != nullptr; }
+    void rethrowError();
+
+private:
+    std::exception_ptr error_;
+};
+
+// Runtime functions callable from generated code, by symbol name
+struct RuntimeSymbol {
+    const char* name;
+    void* address;
+};
+const std::vector<RuntimeSymbol>& runtimeSymbols();
+
+} // namespace sqlengine
+
+extern "C" {
+int32_t sql_pipeline_needed(void* executor, int64_t pipeline);
+void sql_run_pipeline(void* executor, int64_t pipeline);
+}
@@ -42,6 +42,11 @@ enum class TokenType {
     ASC,
     DESC,
     LIMIT,
+    JOIN,
+    INNER,
+    ON,
+    GROUP,
+    HAVING,
     
     // Data types
     INTEGER_TYPE,
@@ -115,4 +120,9 @@ private:
     bool isAlphaNumeric(char c) const { return isAlpha(c) || isDigit(c); }
 };
 
+// Canonical text of a tokenized query: keywords upper-cased, literals
+// replaced by '?', whitespace collapsed. Queries that differ only in
+// constants normalize to the same string.
+std::string normalizeQuery(const std::vector<Token>& tokens);
+
 } // namespace sqlengine
\ No newline at end of file
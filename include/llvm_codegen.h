@@ -2,6 +2,14 @@
 
 #include "ast.h"
 #include "storage.h"
+#include "metrics.h"
+#include "memory_tracker.h"
+#include "hash_operators.h"
+#include "query_control.h"
+#include "materialized_view.h"
+#include "jit_compiler.h"
+#include "jit_runtime.h"
+#include "expression_program.h"
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
@@ -10,73 +18,274 @@
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 
 namespace sqlengine {
 
-class LLVMCodeGenerator : public ASTVisitor {
+class LLVMCodeGenerator : public ASTVisitor, private PipelineExecutor {
 public:
     LLVMCodeGenerator();
     ~LLVMCodeGenerator();
     
-    // Main interface
-    void generateCode(Statement& statement, Database& database);
+    // Main interface; allocations made for the statement are charged to
+    // memory, and execution loops poll control for cancellation and timeout.
+    // DDL and INSERT take effect in generateCode; a SELECT is prepared there
+    // and runs in execute().
+    void generateCode(Statement& statement, Database& database, QueryMemoryContext* memory = nullptr,
+                      const QueryControl* control = nullptr);
     void execute();
     
     // Result access
     const std::vector<Row>& getResults() const { return results_; }
+    std::vector<Row> takeResults() { return std::move(results_); }
+    
+    // Directory for temporary files of operators that spill to disk
+    void setSpillDirectory(const std::string& directory) { spill_directory_ = directory; }
+    
+    // Catalog used by CREATE/DROP MATERIALIZED VIEW
+    void setMaterializedViews(MaterializedViewCatalog* views) { materialized_views_ = views; }
+    
+    // Persist compiled query objects in a directory and reuse them across
+    // restarts (empty disables the cache). Switches to the shared JIT for
+    // that directory.
+    void setObjectCacheDirectory(const std::string& directory);
+    
+    // How compiled kernels process a batch: ROW runs one row per loop
+    // iteration, VECTOR runs kVectorWidth rows at a time on explicit LLVM
+    // vector types, independently of the auto-vectorizer
+    enum class KernelMode { ROW, VECTOR };
+    void setKernelMode(KernelMode mode) { kernel_mode_ = mode; }
+    KernelMode getKernelMode() const { return kernel_mode_; }
+    
+    // JIT compilation counters
+    const JITStats& getJITStats() const { return jit_stats_; }
+    
+    // Statistics of the last executed statement
+    uint64_t getRowsScanned() const { return rows_scanned_; }
+    uint64_t getRowsInserted() const { return rows_inserted_; }
+    uint64_t getLastCompileMicros() const { return last_compile_micros_; }
+    
+    // False if the last generated statement did its work while being
+    // generated (DDL, INSERT, COPY) and has no code left to run
+    bool hasCompiledCode() const { return !entry_function_.empty(); }
     
     // ASTVisitor implementation
     void visit(LiteralExpression& node) override;
     void visit(ColumnExpression& node) override;
     void visit(BinaryExpression& node) override;
     void visit(UnaryExpression& node) override;
+    void visit(AggregateExpression& node) override;
     void visit(SelectStatement& node) override;
     void visit(InsertStatement& node) override;
     void visit(CreateTableStatement& node) override;
     void visit(DropTableStatement& node) override;
+    void visit(CreateMaterializedViewStatement& node) override;
+    void visit(DropMaterializedViewStatement& node) override;
+    void visit(CopyStatement& node) override;
 
 private:
+    // A column of the rows flowing through a SELECT: the FROM table's
+    // columns are followed by those of each joined table
+    struct BoundColumn {
+        std::string table; // alias if one was given
+        std::string column;
+        DataType type;
+    };
+    using RowLayout = std::vector<BoundColumn>;
+    
+    // One JOIN of a SELECT, probed with the rows produced so far
+    struct JoinStage {
+        std::unique_ptr<HashJoin> join;
+        Table* build_table = nullptr;
+        std::vector<ExpressionProgram> build_keys; // compiled against build_layout
+        std::vector<ExpressionProgram> probe_keys; // compiled against probe_layout
+        std::vector<ExpressionProgram> residual;   // non-equality ON conditions
+        RowLayout build_layout;
+        RowLayout probe_layout;
+        RowLayout output_layout;
+    };
+    
+    // Compiled WHERE clause of a scan: evaluates rows [0, rows) of a batch
+    // whose referenced columns are passed as int64 arrays (REAL values as
+    // their bit pattern, BOOLEAN as 0/1) with a NULL bitmap each (unused
+    // for NOT NULL columns), writes the positions of matching rows to
+    // selection and returns their count, or -1 if any row raised an
+    // arithmetic error
+    using FilterKernel = int64_t (*)(int64_t* const* columns, uint8_t* const* nulls, int64_t rows,
+                                     int32_t* selection);
+    
+    // Rows per batch handed to a compiled kernel; scans of smaller tables
+    // stay in the interpreter
+    static constexpr size_t kBatchSize = 1024;
+    
+    // Rows per iteration of a VECTOR kernel; one byte of a NULL bitmap
+    static constexpr unsigned kVectorWidth = 8;
+    
+    // Operators of the prepared SELECT; released once execute() has run
+    // its pipelines, since they charge the statement's memory context
+    struct SelectState {
+        SelectStatement* node = nullptr;
+        Table* table = nullptr;
+        std::vector<std::unique_ptr<Table>> snapshots; // system tables read by the query
+        bool select_all = false;
+        size_t limit = SIZE_MAX;
+        std::vector<JoinStage> joins;
+        bool empty_join = false; // an inner join's build side had no rows
+        std::vector<AggregateExpression*> aggregates;
+        std::unique_ptr<HashAggregator> aggregator;
+        std::unique_ptr<ExternalSorter> sorter;
+        std::vector<std::function<void(const Row&)>> stage_inputs; // stage_inputs[i] feeds join i; the last is the consumer
+        std::vector<HashJoin::Output> stage_outputs;
+        std::function<void(const Row&)> accept; // rows that passed WHERE
+        
+        // Expressions compiled for the interpreter, over row_layout_ or,
+        // for HAVING and the select list of a grouped query, grouped rows
+        ExpressionProgram where;
+        std::vector<std::optional<ExpressionProgram>> projection; // nullopt for *
+        std::vector<ExpressionProgram> aggregate_inputs; // GROUP BY keys, then aggregate arguments
+        ExpressionProgram having;
+        
+        // WHERE compiled to a kernel (single-table scans only), in the
+        // module of the scan pipeline
+        size_t scan_pipeline = 0;
+        std::string where_kernel_name;
+        std::vector<size_t> kernel_columns; // row position of each kernel column
+        JITCompiler::CompiledQuery compiled; // keeps the kernel's module linked
+    };
+    
+    // A SELECT runs as a sequence of pipelines (join builds, the scan,
+    // aggregation output, sort output). The generated entry function runs
+    // each pipeline only if it is needed. Code generated for a pipeline
+    // (the scan's WHERE kernel) lives in a module of its own that is
+    // compiled the first time the pipeline looks it up, so a pipeline that
+    // is skipped, or scans too few rows, compiles nothing.
+    struct Pipeline {
+        std::function<bool()> needed; // null if always needed
+        std::function<void()> run;
+    };
+    
     // LLVM components
     std::unique_ptr<llvm::LLVMContext> context_;
     std::unique_ptr<llvm::Module> module_;
+    std::vector<std::unique_ptr<llvm::Module>> pipeline_modules_; // by pipeline; null if it has no code
+    std::unique_ptr<llvm::Module> runtime_module_;  // query runtime library, loaded on first use
     std::unique_ptr<llvm::IRBuilder<>> builder_;
-    std::unique_ptr<llvm::orc::LLJIT> jit_;
+    std::shared_ptr<JITCompiler> jit_;
     
     // Current state during code generation
     Database* current_database_;
+    QueryMemoryContext* memory_ = nullptr;
+    const QueryControl* control_ = nullptr;
+    uint64_t rows_since_check_ = 0;
     Table* current_table_;
     llvm::Function* current_function_;
     llvm::Value* current_value_;
+    DataType current_type_ = DataType::NULL_TYPE; // SQL type of current_value_
+    llvm::Value* current_null_ = nullptr;         // NULL flag of current_value_; nullptr if never NULL
+    
+    // State of the kernel being generated: its column arrays and NULL
+    // bitmaps, the (first) row index, the lanes inside the batch (VECTOR
+    // mode only) and the error flag of the current row(s)
+    KernelMode kernel_mode_ = KernelMode::VECTOR;
+    unsigned kernel_width_ = 1; // rows per kernel iteration
+    std::vector<llvm::Value*> kernel_columns_;
+    std::vector<llvm::Value*> kernel_nulls_; // nullptr for NOT NULL columns
+    llvm::Value* kernel_row_ = nullptr;
+    llvm::Value* kernel_active_ = nullptr;
+    llvm::Value* kernel_error_ = nullptr;
+    std::unordered_map<const Expression*, std::pair<size_t, DataType>> kernel_slots_; // column -> argument slot
     std::vector<Row> results_;
+    RowLayout row_layout_; // layout of the rows seen by WHERE and the projection
+    std::unordered_map<const Expression*, size_t> group_slots_; // GROUP BY keys and aggregates
+    std::string entry_function_; // JIT entry point of the current statement, if any
+    std::unique_ptr<SelectState> select_;
+    std::vector<Pipeline> pipelines_;
+    uint64_t module_counter_ = 0;
+    uint64_t rows_scanned_ = 0;
+    uint64_t rows_inserted_ = 0;
+    std::string spill_directory_;
+    MaterializedViewCatalog* materialized_views_ = nullptr;
+    uint64_t last_compile_micros_ = 0;
+    JITStats jit_stats_;
     
     // LLVM types
     llvm::Type* int64_type_;
     llvm::Type* double_type_;
     llvm::Type* bool_type_;
     llvm::Type* ptr_type_;
-    llvm::StructType* value_type_;
-    llvm::StructType* row_type_;
     
     // Helper methods
+    void resetModule();
     void initializeTypes();
-    void createRuntimeFunctions();
     llvm::Function* createFunction(const std::string& name, llvm::FunctionType* type);
     llvm::Value* createValue(const Value& value);
     llvm::Value* loadColumn(const std::string& column_name, llvm::Value* row_ptr);
     llvm::Value* evaluateExpression(Expression& expr, llvm::Value* row_ptr);
     
-    // Runtime function declarations
-    llvm::Function* print_int_func_;
-    llvm::Function* print_double_func_;
-    llvm::Function* print_string_func_;
-    llvm::Function* compare_values_func_;
+    // Module holding a pipeline's generated code, created on first use
+    llvm::Module& pipelineModule(size_t pipeline);
+    
+    // Declares a helper of the query runtime library in module (the
+    // statement's module or a pipeline module); the bodies of the
+    // helpers used are linked in when code generation is done
+    llvm::FunctionCallee runtimeFunction(llvm::Module& module, const std::string& name);
     
     // JIT compilation
+    void createPipelineFunctions();
     void compileAndExecute();
+    void releaseStatement();
+    
+    // PipelineExecutor implementation, called from generated code
+    bool pipelineNeeded(size_t pipeline) override;
+    void runPipeline(size_t pipeline) override;
+    
+    // Called once per row by execution loops; every QueryControl::kCheckInterval
+    // rows it throws QueryInterrupted if the query was cancelled or timed out
+    void pollInterrupt() {
+        if (control_ && ++rows_since_check_ >= QueryControl::kCheckInterval) {
+            rows_since_check_ = 0;
+            control_->checkInterrupt();
+        }
+    }
+    
+    // SELECT planning helpers
+    Table* resolveTable(const std::string& name, const std::string& alias,
+                        std::vector<std::unique_ptr<Table>>& snapshots);
+    ScanRequest buildScanRequest(const std::string& name, const Schema& schema) const;
+    std::optional<size_t> findColumn(const RowLayout& layout, const std::string& table,
+                                     const std::string& column) const;
+    size_t resolveColumn(const RowLayout& layout, const std::string& table, const std::string& column) const;
+    bool referencesOnly(Expression& expr, const RowLayout& layout, bool& has_columns) const;
+    void planJoin(JoinClause& clause, JoinStage& stage, std::vector<std::unique_ptr<Table>>& snapshots);
+    
+    // Kernels: type-checks an expression for compilation (nullopt if it
+    // must be interpreted), assigning kernel slots to its columns
+    std::optional<DataType> kernelType(Expression& expr, SelectState& state);
+    bool createFilterKernel(SelectState& state);
+    llvm::Type* laneType(llvm::Type* type) const; // type, or a vector of it in VECTOR mode
+    llvm::Value* propagateNull(llvm::Value* left_null, llvm::Value* right_null);
+    llvm::Value* checkedArithmetic(BinaryExpression::Operator op, llvm::Value* left, llvm::Value* right,
+                                   llvm::Value* null);
+    
+    // Pipelines of a prepared SELECT
+    bool loadJoin(JoinStage& stage);
+    void scanTable(SelectState& state);
+    void scanBatches(SelectState& state);
+    void emitGroups(SelectState& state);
+    void emitSorted(SelectState& state);
+    void bindGroupExpression(Expression& expr, const std::vector<std::string>& keys);
+    
+    // Expression programs over rows of a layout, and over grouped rows
+    // (GROUP BY keys followed by aggregate results)
+    ExpressionProgram compileRowExpression(Expression& expr, const RowLayout& layout) const;
+    ExpressionProgram compileGroupExpression(Expression& expr) const;
     
-    // Helper method for WHERE clause evaluation
-    bool evaluateWhereClause(Expression& expr, const Row& row);
+    bool evaluateWhereClause(const ExpressionProgram& where, const Row& row);
+    void emitResultRow(SelectState& state, const Row& row);
+    void emitGroupRow(SelectState& state, const Row& group_row);
 };
 
 } // namespace sqlengine
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "ast.h"
+#include "expression_program.h"
+#include "storage.h"
+#include "hash_operators.h"
+#include "sort.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sqlengine {
+
+// Aggregate query over one base table whose result is kept up to date as
+// rows are inserted. The view holds one aggregate state per group; every
+// inserted row that passes the WHERE clause is folded into its group
+// (SUM, COUNT, MIN, MAX and AVG only ever accumulate, and tables are
+// append-only), so reading the view costs O(groups) instead of a scan.
+// HAVING and the select list are evaluated over the groups when read.
+class MaterializedView : public TableListener {
+public:
+    // Throws if the query is not a single-table GROUP BY / aggregate query
+    MaterializedView(std::string name, std::vector<std::string> column_names,
+                     AstPtr<SelectStatement> definition, const Table& source);
+
+    const std::string& getName() const { return name_; }
+    const std::string& getSourceTable() const { return definition_->from_table; }
+    const Schema& getSchema() const { return schema_; }
+    size_t getGroupCount() const { return group_keys_.size(); }
+
+    // Delta propagation for inserted source rows. Prepare folds the rows
+    // into copies of the groups they touch, so WHERE, key, argument and
+    // overflow errors surface before the view changes; commit swaps the
+    // copies in.
+    void prepareInsert(const Row* rows, size_t count) override;
+    void commitInsert() override;
+
+    // Current result of the view query
+    std::vector<Row> getRows() const;
+
+private:
+    std::string name_;
+    AstPtr<SelectStatement> definition_;
+    Schema source_schema_;
+    Schema schema_;
+
+    std::unordered_map<const Expression*, size_t> column_slots_; // column -> source row position
+    std::unordered_map<const Expression*, size_t> group_slots_;  // key or aggregate -> group row position
+    std::vector<DataType> group_types_;
+    std::vector<AggregateExpression*> aggregates_;
+    std::vector<AggregateKind> kinds_;
+    std::vector<SortColumn> key_columns_;
+
+    // Compiled once from the definition: WHERE and the inputs read source
+    // rows, HAVING and the select list read group rows (keys, then the
+    // finalized aggregates)
+    ExpressionProgram where_;
+    std::vector<ExpressionProgram> inputs_; // GROUP BY keys, then aggregate arguments
+    ExpressionProgram having_;
+    std::vector<ExpressionProgram> projection_;
+
+    std::unordered_map<std::string, size_t> group_index_;
+    std::vector<Row> group_keys_;
+    std::vector<AggregateState> states_; // aggregates_.size() per group
+    std::string scratch_key_;
+    
+    // Groups touched by the prepared insert, with their updated states
+    struct PendingGroup {
+        std::string key;
+        size_t group;  // index into group_keys_; new groups follow the existing ones
+        Row keys;
+        std::vector<AggregateState> states;
+    };
+    std::unordered_map<std::string, size_t> pending_index_; // key -> index into pending_
+    std::vector<PendingGroup> pending_;
+    size_t pending_new_groups_ = 0;
+
+    void bindColumns(Expression& expr);
+    void bindGroupExpression(Expression& expr, const std::vector<std::string>& keys);
+    DataType inferType(Expression& expr, bool grouped) const;
+    ExpressionProgram compileRowExpression(const Expression& expr) const;
+    ExpressionProgram compileGroupExpression(const Expression& expr) const;
+    void emitGroup(const Row& keys, const AggregateState* states, std::vector<Row>& rows) const;
+};
+
+// Materialized views of a database, each registered as a read-only table
+// and attached as a listener to the table it reads
+class MaterializedViewCatalog {
+public:
+    explicit MaterializedViewCatalog(Database& database) : database_(database) {}
+    ~MaterializedViewCatalog();
+
+    MaterializedViewCatalog(const MaterializedViewCatalog&) = delete;
+    MaterializedViewCatalog& operator=(const MaterializedViewCatalog&) = delete;
+
+    // Computes the view over the current table contents
+    void create(const std::string& name, std::vector<std::string> column_names,
+                AstPtr<SelectStatement> definition);
+    void drop(const std::string& name);
+
+    const MaterializedView* get(const std::string& name) const;
+
+    // A view reading the table, or nullptr; such tables cannot be dropped
+    const MaterializedView* findDependent(const std::string& table) const;
+
+private:
+    Database& database_;
+    std::unordered_map<std::string, std::shared_ptr<MaterializedView>> views_;
+};
+
+} // namespace sqlengine
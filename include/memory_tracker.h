@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace sqlengine {
+
+// Thrown when a query would exceed its own or the engine-wide memory budget
+class MemoryLimitExceeded : public std::runtime_error {
+public:
+    explicit MemoryLimitExceeded(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Engine-wide accounting of memory used on behalf of running queries
+// (results, hash tables, sort buffers). Table data is not included.
+// A limit of 0 means unlimited.
+class MemoryTracker {
+public:
+    MemoryTracker() = default;
+
+    void setGlobalLimit(size_t bytes) { global_limit_.store(bytes, std::memory_order_relaxed); }
+    size_t getGlobalLimit() const { return global_limit_.load(std::memory_order_relaxed); }
+
+    // Default budget handed to each query
+    void setQueryLimit(size_t bytes) { query_limit_.store(bytes, std::memory_order_relaxed); }
+    size_t getQueryLimit() const { return query_limit_.load(std::memory_order_relaxed); }
+
+    // Returns false (and reserves nothing) if the global limit would be exceeded
+    bool tryReserve(size_t bytes);
+    void release(size_t bytes);
+
+    size_t getUsed() const { return used_.load(std::memory_order_relaxed); }
+    size_t getPeak() const { return peak_.load(std::memory_order_relaxed); }
+    size_t getLimitHits() const { return limit_hits_.load(std::memory_order_relaxed); }
+    void recordLimitHit() { limit_hits_.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    std::atomic<size_t> global_limit_{0};
+    std::atomic<size_t> query_limit_{0};
+    std::atomic<size_t> used_{0};
+    std::atomic<size_t> peak_{0};
+    std::atomic<size_t> limit_hits_{0};
+};
+
+// Memory accounting for a single query. Memory is granted from the global
+// tracker in chunks so that per-allocation accounting stays a plain
+// (non-atomic) counter update. Everything still held is returned to the
+// global tracker when the context is destroyed.
+class QueryMemoryContext {
+public:
+    QueryMemoryContext(MemoryTracker& global, size_t query_limit);
+    ~QueryMemoryContext();
+
+    QueryMemoryContext(const QueryMemoryContext&) = delete;
+    QueryMemoryContext& operator=(const QueryMemoryContext&) = delete;
+
+    // Account for an allocation; throws MemoryLimitExceeded when over budget
+    void reserve(size_t bytes);
+
+    // Like reserve, but reports failure instead of throwing, for operators
+    // that can spill to disk instead
+    bool tryReserve(size_t bytes);
+
+    void release(size_t bytes);
+
+    size_t getUsed() const { return used_; }
+    size_t getPeak() const { return peak_; }
+    size_t getLimit() const { return limit_; }
+
+    // Bytes still available under the per-query limit (SIZE_MAX if unlimited)
+    size_t getRemaining() const;
+
+private:
+    static constexpr size_t kGrantChunk = 64 * 1024;
+
+    MemoryTracker& global_;
+    size_t limit_;
+    size_t used_ = 0;
+    size_t peak_ = 0;
+    size_t granted_ = 0; // bytes reserved from the global tracker
+};
+
+} // namespace sqlengine
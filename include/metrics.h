@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace sqlengine {
+
+// Log2-bucketed latency histogram in microseconds.
+// Recording is lock-free so it can sit on the query path.
+class LatencyHistogram {
+public:
+    static constexpr size_t kBucketCount = 32;
+
+    void record(uint64_t micros);
+
+    uint64_t getCount() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t getTotalMicros() const { return total_micros_.load(std::memory_order_relaxed); }
+    uint64_t getMaxMicros() const { return max_micros_.load(std::memory_order_relaxed); }
+    uint64_t getBucketCount(size_t bucket) const;
+
+    // Inclusive upper bound (in microseconds) of a bucket
+    static uint64_t getBucketUpperBound(size_t bucket);
+
+    // Approximate percentile (0.0 - 1.0), reported as a bucket upper bound
+    uint64_t percentile(double p) const;
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> total_micros_{0};
+    std::atomic<uint64_t> max_micros_{0};
+};
+
+// Statement categories tracked by the engine
+enum class StatementKind {
+    SELECT,
+    INSERT,
+    CREATE_TABLE,
+    DROP_TABLE,
+    CREATE_MATERIALIZED_VIEW,
+    DROP_MATERIALIZED_VIEW,
+    COPY,
+    INVALID
+};
+
+constexpr size_t kStatementKindCount = 8;
+
+const char* statementKindName(StatementKind kind);
+
+// Counters for a single statement kind
+struct StatementMetrics {
+    std::atomic<uint64_t> executions{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> rows_returned{0};
+    LatencyHistogram latency;
+};
+
+// Engine-wide query metrics, updated in place after every statement
+class EngineMetrics {
+public:
+    void recordQuery(StatementKind kind, uint64_t micros, uint64_t rows, bool failed);
+
+    const StatementMetrics& get(StatementKind kind) const {
+        return by_kind_[static_cast<size_t>(kind)];
+    }
+
+private:
+    std::array<StatementMetrics, kStatementKindCount> by_kind_;
+};
+
+// JIT compilation counters maintained by the code generator
+struct JITStats {
+    std::atomic<uint64_t> modules_compiled{0};
+    std::atomic<uint64_t> compile_micros{0};
+    std::atomic<uint64_t> cache_hits{0};          // JIT-run statements whose module was already linked or cached
+    std::atomic<uint64_t> cache_misses{0};        // JIT-run statements compiled from scratch
+    std::atomic<uint64_t> object_cache_loads{0};  // hits served from the on-disk object cache
+    std::atomic<uint64_t> morsels_interpreted{0}; // scan morsels run before their kernel was compiled
+    std::atomic<uint64_t> morsels_compiled{0};    // scan morsels run by a compiled kernel
+    std::atomic<uint64_t> kernel_compile_errors{0}; // kernels that failed to compile; their scans were interpreted
+};
+
+} // namespace sqlengine
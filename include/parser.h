@@ -7,15 +7,32 @@
 
 namespace sqlengine {
 
+// Statement of a script with the offsets of its source text
+struct ParsedStatement {
+    AstPtr<Statement> statement;
+    size_t source_begin = 0;
+    size_t source_end = 0;
+};
+
 class Parser {
 public:
-    Parser(const std::vector<Token>& tokens);
+    // Nodes are allocated in arena if one is given (it must outlive the
+    // statements), otherwise on the heap
+    Parser(const std::vector<Token>& tokens, AstArena* arena = nullptr);
+    
+    AstPtr<Statement> parseStatement();
     
-    std::unique_ptr<Statement> parseStatement();
+    // All statements of a script, separated by ';' (empty statements are
+    // skipped); throws on the first syntax error
+    std::vector<ParsedStatement> parseScript();
     
 private:
     std::vector<Token> tokens_;
     size_t current_;
+    AstArena* arena_;
+    
+    template <typename T, typename... Args>
+    AstPtr<T> node(Args&&... args) { return makeNode<T>(arena_, std::forward<Args>(args)...); }
     
     // Utility methods
     const Token& peek() const;
@@ -24,24 +41,31 @@ private:
     Token advance();
     bool check(TokenType type) const;
     bool match(TokenType type);
+    bool matchKeyword(const std::string& keyword); // contextual keyword given as an identifier
     bool match(const std::vector<TokenType>& types);
     void consume(TokenType type, const std::string& message);
     
     // Parsing methods
-    std::unique_ptr<Statement> parseSelectStatement();
-    std::unique_ptr<Statement> parseInsertStatement();
-    std::unique_ptr<Statement> parseCreateTableStatement();
-    std::unique_ptr<Statement> parseDropTableStatement();
-    
-    std::unique_ptr<Expression> parseExpression();
-    std::unique_ptr<Expression> parseOrExpression();
-    std::unique_ptr<Expression> parseAndExpression();
-    std::unique_ptr<Expression> parseEqualityExpression();
-    std::unique_ptr<Expression> parseComparisonExpression();
-    std::unique_ptr<Expression> parseTermExpression();
-    std::unique_ptr<Expression> parseFactorExpression();
-    std::unique_ptr<Expression> parseUnaryExpression();
-    std::unique_ptr<Expression> parsePrimaryExpression();
+    AstPtr<Statement> parseSelectStatement();
+    AstPtr<Statement> parseInsertStatement();
+    AstPtr<Statement> parseCreateTableStatement();
+    AstPtr<Statement> parseCreateExternalTableStatement();
+    AstPtr<Statement> parseDropTableStatement();
+    AstPtr<Statement> parseCreateMaterializedViewStatement();
+    AstPtr<Statement> parseDropMaterializedViewStatement();
+    AstPtr<Statement> parseCopyStatement();
+    std::string parseTableAlias();
+    
+    AstPtr<Expression> parseExpression();
+    AstPtr<Expression> parseOrExpression();
+    AstPtr<Expression> parseAndExpression();
+    AstPtr<Expression> parseEqualityExpression();
+    AstPtr<Expression> parseComparisonExpression();
+    AstPtr<Expression> parseTermExpression();
+    AstPtr<Expression> parseFactorExpression();
+    AstPtr<Expression> parseUnaryExpression();
+    AstPtr<Expression> parsePrimaryExpression();
+    AstPtr<Expression> parseAggregateExpression(const std::string& name);
     
     DataType parseDataType();
     Value parseValue(const Token& token);
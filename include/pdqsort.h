@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+namespace sqlengine {
+
+// Pattern-defeating quicksort (after Orson Peters). Introsort-like worst
+// case, but linear on sorted/reverse-sorted input, equal-element runs
+// collapse quickly, and bad pivot patterns are broken up before falling
+// back to heapsort. Not stable.
+namespace pdqsort_detail {
+
+constexpr std::ptrdiff_t kInsertionSortThreshold = 24;
+constexpr std::ptrdiff_t kNintherThreshold = 128;
+constexpr std::ptrdiff_t kPartialInsertionSortLimit = 8;
+
+template<typename Iter, typename Compare>
+void insertionSort(Iter begin, Iter end, Compare& comp) {
+    if (begin == end) return;
+    for (Iter cur = begin + 1; cur != end; ++cur) {
+        Iter sift = cur;
+        Iter sift_1 = cur - 1;
+        if (comp(*sift, *sift_1)) {
+            auto tmp = std::move(*sift);
+            do {
+                *sift-- = std::move(*sift_1);
+            } while (sift != begin && comp(tmp, *--sift_1));
+            *sift = std::move(tmp);
+        }
+    }
+}
+
+// Requires an element before begin that is not greater than any element in range
+template<typename Iter, typename Compare>
+void unguardedInsertionSort(Iter begin, Iter end, Compare& comp) {
+    if (begin == end) return;
+    for (Iter cur = begin + 1; cur != end; ++cur) {
+        Iter sift = cur;
+        Iter sift_1 = cur - 1;
+        if (comp(*sift, *sift_1)) {
+            auto tmp = std::move(*sift);
+            do {
+                *sift-- = std::move(*sift_1);
+            } while (comp(tmp, *--sift_1));
+            *sift = std::move(tmp);
+        }
+    }
+}
+
+// Insertion sort that gives up after a few moves; returns true if the range is sorted
+template<typename Iter, typename Compare>
+bool partialInsertionSort(Iter begin, Iter end, Compare& comp) {
+    if (begin == end) return true;
+    std::ptrdiff_t moves = 0;
+    for (Iter cur = begin + 1; cur != end; ++cur) {
+        Iter sift = cur;
+        Iter sift_1 = cur - 1;
+        if (comp(*sift, *sift_1)) {
+            auto tmp = std::move(*sift);
+            do {
+                *sift-- = std::move(*sift_1);
+            } while (sift != begin && comp(tmp, *--sift_1));
+            *sift = std::move(tmp);
+            moves += cur - sift;
+        }
+        if (moves > kPartialInsertionSortLimit) return false;
+    }
+    return true;
+}
+
+template<typename Iter, typename Compare>
+void sort2(Iter a, Iter b, Compare& comp) {
+    if (comp(*b, *a)) std::iter_swap(a, b);
+}
+
+template<typename Iter, typename Compare>
+void sort3(Iter a, Iter b, Iter c, Compare& comp) {
+    sort2(a, b, comp);
+    sort2(b, c, comp);
+    sort2(a, b, comp);
+}
+
+// Partitions [begin, end) around the pivot *begin into elements < pivot
+// and >= pivot. Returns the pivot position and whether no swaps were needed.
+template<typename Iter, typename Compare>
+std::pair<Iter, bool> partitionRight(Iter begin, Iter end, Compare& comp) {
+    auto pivot = std::move(*begin);
+    Iter first = begin;
+    Iter last = end;
+
+    // The median-of-3 pivot selection guarantees these searches stop in range
+    while (comp(*++first, pivot));
+    if (first - 1 == begin) {
+        while (first < last && !comp(*--last, pivot));
+    } else {
+        while (!comp(*--last, pivot));
+    }
+
+    bool already_partitioned = first >= last;
+    while (first < last) {
+        std::iter_swap(first, last);
+        while (comp(*++first, pivot));
+        while (!comp(*--last, pivot));
+    }
+
+    Iter pivot_pos = first - 1;
+    *begin = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+    return {pivot_pos, already_partitioned};
+}
+
+// Like partitionRight but puts elements equal to the pivot on the left;
+// used when the pivot equals its predecessor, which skips runs of equal keys
+template<typename Iter, typename Compare>
+Iter partitionLeft(Iter begin, Iter end, Compare& comp) {
+    auto pivot = std::move(*begin);
+    Iter first = begin;
+    Iter last = end;
+
+    while (comp(pivot, *--last));
+    if (last + 1 == end) {
+        while (first < last && !comp(pivot, *++first));
+    } else {
+        while (!comp(pivot, *++first));
+    }
+
+    while (first < last) {
+        std::iter_swap(first, last);
+        while (comp(pivot, *--last));
+        while (!comp(pivot, *++first));
+    }
+
+    Iter pivot_pos = last;
+    *begin = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+    return pivot_pos;
+}
+
+template<typename Iter, typename Compare>
+void pdqsortLoop(Iter begin, Iter end, Compare& comp, int bad_allowed, bool leftmost) {
+    for (;;) {
+        std::ptrdiff_t size = end - begin;
+        if (size < kInsertionSortThreshold) {
+            if (leftmost) {
+                insertionSort(begin, end, comp);
+            } else {
+                unguardedInsertionSort(begin, end, comp);
+            }
+            return;
+        }
+
+        // Median of 3, or pseudo-median of 9 (Tukey's ninther) for large ranges
+        std::ptrdiff_t half = size / 2;
+        if (size > kNintherThreshold) {
+            sort3(begin, begin + half, end - 1, comp);
+            sort3(begin + 1, begin + (half - 1), end - 2, comp);
+            sort3(begin + 2, begin + (half + 1), end - 3, comp);
+            sort3(begin + (half - 1), begin + half, begin + (half + 1), comp);
+            std::iter_swap(begin, begin + half);
+        } else {
+            sort3(begin + half, begin, end - 1, comp);
+        }
+
+        if (!leftmost && !comp(*(begin - 1), *begin)) {
+            begin = partitionLeft(begin, end, comp) + 1;
+            continue;
+        }
+
+        auto partition = partitionRight(begin, end, comp);
+        Iter pivot_pos = partition.first;
+        bool already_partitioned = partition.second;
+
+        std::ptrdiff_t left_size = pivot_pos - begin;
+        std::ptrdiff_t right_size = end - (pivot_pos + 1);
+        bool highly_unbalanced = left_size < size / 8 || right_size < size / 8;
+
+        if (highly_unbalanced) {
+            if (--bad_allowed == 0) {
+                std::make_heap(begin, end, comp);
+                std::sort_heap(begin, end, comp);
+                return;
+            }
+
+            // Shuffle a few elements to break patterns that defeat the pivot choice
+            if (left_size >= kInsertionSortThreshold) {
+                std::iter_swap(begin, begin + left_size / 4);
+                std::iter_swap(pivot_pos - 1, pivot_pos - left_size / 4);
+                if (left_size > kNintherThreshold) {
+                    std::iter_swap(begin + 1, begin + (left_size / 4 + 1));
+                    std::iter_swap(begin + 2, begin + (left_size / 4 + 2));
+                    std::iter_swap(pivot_pos - 2, pivot_pos - (left_size / 4 + 1));
+                    std::iter_swap(pivot_pos - 3, pivot_pos - (left_size / 4 + 2));
+                }
+            }
+            if (right_size >= kInsertionSortThreshold) {
+                std::iter_swap(pivot_pos + 1, pivot_pos + (1 + right_size / 4));
+                std::iter_swap(end - 1, end - right_size / 4);
+                if (right_size > kNintherThreshold) {
+                    std::iter_swap(pivot_pos + 2, pivot_pos + (2 + right_size / 4));
+                    std::iter_swap(pivot_pos + 3, pivot_pos + (3 + right_size / 4));
+                    std::iter_swap(end - 2, end - (1 + right_size / 4));
+                    std::iter_swap(end - 3, end - (2 + right_size / 4));
+                }
+            }
+        } else if (already_partitioned &&
+                   partialInsertionSort(begin, pivot_pos, comp) &&
+                   partialInsertionSort(pivot_pos + 1, end, comp)) {
+            return;
+        }
+
+        // Recurse into the left part, loop on the right part
+        pdqsortLoop(begin, pivot_pos, comp, bad_allowed, leftmost);
+        begin = pivot_pos + 1;
+        leftmost = false;
+    }
+}
+
+} // namespace pdqsort_detail
+
+template<typename Iter, typename Compare>
+void pdqsort(Iter begin, Iter end, Compare comp) {
+    if (end - begin < 2) return;
+    int log2 = 0;
+    for (auto n = end - begin; n > 1; n >>= 1) {
+        ++log2;
+    }
+    pdqsort_detail::pdqsortLoop(begin, end, comp, log2, true);
+}
+
+} // namespace sqlengine
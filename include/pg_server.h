@@ -0,0 +1,83 @@
+#pragma once
+
+#include "query_engine.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sqlengine {
+
+// PostgreSQL frontend/backend protocol (version 3.0) over one QueryEngine,
+// so that several client processes share an engine. One thread runs an
+// epoll loop over the listening sockets and every connection; statements
+// run on that thread one at a time, so the engine is used without locks
+// and a long statement delays the other clients.
+//
+// Supported: the simple query protocol and the extended protocol (Parse,
+// Bind, Describe, Execute with a row limit, Close, Sync, Flush) with text
+// format parameters and results. Prepared statements are kept per
+// connection; Bind substitutes the parameter values into the statement as
+// literals. There is no authentication, TLS or COPY: SSL and GSSAPI
+// requests are declined and every startup is accepted.
+class PgServer {
+public:
+    explicit PgServer(QueryEngine& engine);
+    ~PgServer();
+
+    PgServer(const PgServer&) = delete;
+    PgServer& operator=(const PgServer&) = delete;
+
+    // Listening sockets; throw std::runtime_error if one cannot be set up.
+    // A stale Unix socket file at path is replaced, and removed again when
+    // the server is destroyed.
+    void listenTcp(const std::string& host, uint16_t port);
+    void listenUnix(const std::string& path);
+
+    // Serves clients until stop() is called
+    void run();
+
+    // Makes run() return; safe to call from another thread or a signal handler
+    void stop();
+
+    size_t getConnectionCount() const { return connections_.size(); }
+
+private:
+    struct Connection;
+
+    QueryEngine& engine_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::vector<int> listeners_;
+    std::vector<std::string> unix_paths_;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    int32_t next_process_id_ = 1;
+
+    void addListener(int fd);
+    void acceptClients(int listener);
+    void readClient(Connection& connection);
+    void writeClient(Connection& connection);
+    void closeClient(int fd);
+
+    // Processes the complete messages in the connection's input buffer;
+    // false once the connection is to be closed
+    bool processInput(Connection& connection);
+    bool handleStartup(Connection& connection, const char* body, size_t length);
+    void handleMessage(Connection& connection, char type, const char* body, size_t length);
+
+    void simpleQuery(Connection& connection, const std::string& sql);
+    void parse(Connection& connection, const char* body, size_t length);
+    void bind(Connection& connection, const char* body, size_t length);
+    void describe(Connection& connection, const char* body, size_t length);
+    void executePortal(Connection& connection, const char* body, size_t length);
+    void close(Connection& connection, const char* body, size_t length);
+
+    // Sends the RowDescription of a statement, or NoData if it returns no
+    // rows; false (with an error sent) if it cannot be described
+    bool sendDescription(Connection& connection, const std::string& sql);
+};
+
+} // namespace sqlengine
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sqlengine {
+
+// Thrown when a query is cancelled or runs past its deadline
+class QueryInterrupted : public std::runtime_error {
+public:
+    explicit QueryInterrupted(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Cancellation flag and deadline of one running query. cancel() may be
+// called from any thread; the executing thread polls checkInterrupt()
+// between batches of rows, so an uncancelled query pays one relaxed load
+// and a clock read per batch.
+class QueryControl {
+public:
+    // Rows processed by an execution loop between two checks
+    static constexpr uint64_t kCheckInterval = 1024;
+
+    QueryControl(uint64_t query_id, std::string sql, uint64_t timeout_ms);
+
+    uint64_t getQueryId() const { return query_id_; }
+    const std::string& getSql() const { return sql_; }
+    uint64_t getElapsedMicros() const;
+
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+    // Throws QueryInterrupted if the query was cancelled or its deadline passed
+    void checkInterrupt() const;
+
+private:
+    uint64_t query_id_;
+    std::string sql_;
+    uint64_t timeout_ms_; // 0 = no deadline
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point deadline_;
+    std::atomic<bool> cancelled_{false};
+};
+
+// Queries currently executing, so that they can be listed and cancelled
+// from other threads
+class QueryRegistry {
+public:
+    std::shared_ptr<QueryControl> start(const std::string& sql, uint64_t timeout_ms);
+    void finish(uint64_t query_id);
+
+    // Returns false if no query with this id is running
+    bool cancel(uint64_t query_id);
+
+    std::vector<std::shared_ptr<const QueryControl>> getRunning() const;
+    uint64_t getLastQueryId() const { return next_query_id_.load(std::memory_order_relaxed); }
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, std::shared_ptr<QueryControl>> running_;
+    std::atomic<uint64_t> next_query_id_{0};
+};
+
+} // namespace sqlengine
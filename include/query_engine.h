@@ -4,9 +4,18 @@
 #include "lexer.h"
 #include "parser.h"
 #include "llvm_codegen.h"
+#include "metrics.h"
+#include "slow_query_log.h"
+#include "memory_tracker.h"
+#include "query_control.h"
+#include "result_cache.h"
+#include <chrono>
 #include <string>
 #include <memory>
 
+struct ArrowSchema;
+struct ArrowArray;
+
 namespace sqlengine {
 
 class QueryEngine {
@@ -17,6 +26,43 @@ public:
     // Execute a SQL query and return results
     std::vector<Row> execute(const std::string& sql);
     
+    // Execute a script of ';'-separated statements. The script is parsed
+    // once up front (nothing runs if it has a syntax error), then the
+    // statements run in order; consecutive INSERTs into the same table are
+    // executed as a single statement, and run again one by one if that
+    // fails, so the script behaves as if each ran on its own. Stops at the
+    // first failing statement (see getLastError) and returns the results
+    // of the last one run.
+    std::vector<Row> executeScript(const std::string& sql);
+    
+    // Name and type of a result column; the type is NULL_TYPE where only
+    // the data decides it (a NULL literal)
+    struct ResultColumn {
+        std::string name;
+        DataType type;
+    };
+    
+    // Result columns of a single statement, without running it. Empty for
+    // statements other than SELECT and on errors (see getLastError).
+    std::vector<ResultColumn> describe(const std::string& sql);
+    
+    // Execute a statement and return its result in the Arrow IPC streaming
+    // format (see arrow_ipc.h): values are copied into column buffers
+    // instead of being formatted. Statements other than SELECT produce a
+    // stream without columns. Empty on errors (see getLastError).
+    std::string executeArrow(const std::string& sql);
+    
+    // Execute a statement and export its result through the Arrow C Data
+    // Interface as a struct array (see arrow_c_data.h). The caller owns
+    // the exported schema and array. Returns false on errors, leaving
+    // them untouched.
+    bool executeArrowArray(const std::string& sql, ArrowSchema* out_schema, ArrowArray* out_array);
+    
+    // Kind of the last statement run, and the rows it returned (SELECT) or
+    // stored (INSERT, COPY)
+    StatementKind getLastStatementKind() const { return last_kind_; }
+    uint64_t getLastRowCount() const { return last_row_count_; }
+    
     // Get the underlying database for direct access
     Database& getDatabase() { return database_; }
     const Database& getDatabase() const { return database_; }
@@ -24,10 +70,87 @@ public:
     // Get last error message
     const std::string& getLastError() const { return last_error_; }
     
+    // Engine metrics (also exposed through the sys_* tables)
+    const EngineMetrics& getMetrics() const { return metrics_; }
+    
+    // Log statements taking at least threshold_us to a JSON-lines file
+    void enableSlowQueryLog(const std::string& path, uint64_t threshold_us);
+    void disableSlowQueryLog();
+    const SlowQueryLog* getSlowQueryLog() const { return slow_query_log_.get(); }
+    
+    // Memory budgets for query working memory in bytes (0 = unlimited).
+    // A query over budget fails with a memory limit error.
+    void setQueryMemoryLimit(size_t bytes) { memory_tracker_.setQueryLimit(bytes); }
+    void setGlobalMemoryLimit(size_t bytes) { memory_tracker_.setGlobalLimit(bytes); }
+    const MemoryTracker& getMemoryTracker() const { return memory_tracker_; }
+    
+    // Cancel a running query by id (from any thread). Returns false if no
+    // such query is running. The query fails with a cancellation error.
+    bool cancel(uint64_t query_id) { return query_registry_.cancel(query_id); }
+    
+    // Deadline for each query in milliseconds (0 = none); a query past its
+    // deadline fails with a timeout error
+    void setQueryTimeout(uint64_t milliseconds) { query_timeout_ms_ = milliseconds; }
+    
+    // Running queries (also exposed as sys_running_queries) and the id of
+    // the most recently started one
+    const QueryRegistry& getQueryRegistry() const { return query_registry_; }
+    uint64_t getLastQueryId() const { return query_registry_.getLastQueryId(); }
+    
+    // Cache SELECT results in up to the given number of bytes (0 disables
+    // the cache). Cached results are invalidated when a table they read
+    // changes.
+    void setResultCacheCapacity(size_t bytes) { result_cache_.setCapacity(bytes); }
+    const ResultCache& getResultCache() const { return result_cache_; }
+    
+    // Materialized views created with CREATE MATERIALIZED VIEW
+    const MaterializedViewCatalog& getMaterializedViews() const { return materialized_views_; }
+    
+    // Keep compiled query objects in a directory so that they are loaded
+    // instead of recompiled after a restart
+    void enableJITObjectCache(const std::string& directory) { codegen_->setObjectCacheDirectory(directory); }
+    void disableJITObjectCache() { codegen_->setObjectCacheDirectory(""); }
+    
+    // Whether compiled WHERE kernels use explicit vector code (the default)
+    // or process one row per iteration
+    void setKernelMode(LLVMCodeGenerator::KernelMode mode) { codegen_->setKernelMode(mode); }
+    
+    // Where sorts spill sorted runs when they exceed the memory budget
+    void setSpillDirectory(const std::string& directory) { codegen_->setSpillDirectory(directory); }
+    
 private:
+    // State of a single statement execution
+    struct QueryExecution {
+        StatementKind kind = StatementKind::INVALID;
+        AstArena arena; // holds the nodes of statement, so it is declared before it
+        AstPtr<Statement> statement;
+        QueryPhaseTimings phases;
+        std::shared_ptr<QueryControl> control;
+        bool cache_hit = false;
+    };
+    
     Database database_;
+    MaterializedViewCatalog materialized_views_{database_};
     std::unique_ptr<LLVMCodeGenerator> codegen_;
     std::string last_error_;
+    StatementKind last_kind_ = StatementKind::INVALID;
+    uint64_t last_row_count_ = 0;
+    EngineMetrics metrics_;
+    MemoryTracker memory_tracker_;
+    std::unique_ptr<SlowQueryLog> slow_query_log_;
+    QueryRegistry query_registry_;
+    std::atomic<uint64_t> query_timeout_ms_{0};
+    ResultCache result_cache_;
+    
+    std::vector<Row> executeStatement(const std::string& sql, QueryExecution& execution);
+    std::vector<Row> runStatement(QueryExecution& execution, const std::string& cache_key);
+    
+    // Runs a statement for executeArrow*, with the schema of its result
+    bool executeForExport(const std::string& sql, Schema& schema, std::vector<Row>& results);
+    void finishStatement(const std::string& sql, const QueryExecution& execution,
+                         std::chrono::steady_clock::time_point start, uint64_t rows_returned);
+    void logSlowQuery(const std::string& sql, const QueryExecution& execution,
+                      uint64_t duration_us, uint64_t rows_returned);
     
     void clearError() { last_error_.clear(); }
     void setError(const std::string& error) { last_error_ = error; }
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <memory>
+#include <string>
+
+namespace sqlengine {
+
+// Helper library for generated code (NULL bitmap tests, checked
+// arithmetic), written in src/runtime/query_runtime.ll and embedded as
+// bitcode. Generated code declares the helpers it calls;
+// before compilation their bodies are linked into the module as internal
+// functions and inlined, so the optimizer sees through them.
+
+// Copy of the library in a context; function bodies are only read when
+// they are linked. Throws if the embedded bitcode cannot be read.
+std::unique_ptr<llvm::Module> loadQueryRuntime(llvm::LLVMContext& context);
+
+// Declares a helper in module with the library's prototype; throws if the
+// library has no such function
+llvm::FunctionCallee declareRuntimeFunction(llvm::Module& module, const llvm::Module& runtime,
+                                            const std::string& name);
+
+// Links the helpers module calls, internalizes and inlines them; a module
+// that calls none is left as is
+void linkQueryRuntime(llvm::Module& module);
+
+} // namespace sqlengine
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "types.h"
+#include "lexer.h"
+#include "storage.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sqlengine {
+
+// Cache of SELECT results for repeated read-only queries. Entries are keyed
+// by the normalized SQL plus the literal values and record the version of
+// every table they read; an entry is only returned while all of those
+// tables still have the same version, and is dropped otherwise. Entries are
+// evicted least recently used first to stay within the byte capacity.
+// A capacity of 0 disables the cache.
+class ResultCache {
+public:
+    struct TableVersion {
+        std::string table;
+        uint64_t version;
+    };
+
+    explicit ResultCache(size_t capacity_bytes = 0);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Shrinking the capacity evicts entries as needed
+    void setCapacity(size_t bytes);
+    size_t getCapacity() const { return capacity_.load(std::memory_order_relaxed); }
+    bool isEnabled() const { return getCapacity() > 0; }
+
+    // Cache key of a statement: normalizeQuery() text followed by the
+    // type and value of each literal
+    static std::string makeKey(const std::vector<Token>& tokens);
+
+    // Copies the cached rows into results. Returns false on a miss or when
+    // a table read by the entry has changed since it was stored.
+    bool lookup(const std::string& key, const Database& database, std::vector<Row>& results);
+
+    // Table versions must be captured before the query started executing
+    void insert(const std::string& key, std::vector<TableVersion> tables, const std::vector<Row>& rows);
+
+    void clear();
+
+    size_t getBytes() const;
+    size_t getEntryCount() const;
+    uint64_t getHits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t getMisses() const { return misses_.load(std::memory_order_relaxed); }
+    uint64_t getInvalidations() const { return invalidations_.load(std::memory_order_relaxed); }
+    uint64_t getEvictions() const { return evictions_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<TableVersion> tables;
+        std::vector<Row> rows;
+        size_t bytes;
+    };
+
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t bytes_ = 0;
+
+    std::atomic<size_t> capacity_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> invalidations_{0};
+    std::atomic<uint64_t> evictions_{0};
+
+    // Callers hold mutex_
+    void erase(std::list<Entry>::iterator entry);
+    void evictTo(size_t capacity);
+};
+
+} // namespace sqlengine
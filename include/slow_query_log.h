@@ -0,0 +1,77 @@
+#pragma once
+
+#include "lockfree_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sqlengine {
+
+// Wall time spent in each phase of a statement, in microseconds. Statements
+// that do their work during code generation (DDL, INSERT, COPY) report it
+// as execute time.
+struct QueryPhaseTimings {
+    uint64_t lex_us = 0;
+    uint64_t parse_us = 0;
+    uint64_t codegen_us = 0;
+    uint64_t compile_us = 0;
+    uint64_t execute_us = 0;
+};
+
+// One entry of the slow query log
+struct SlowQueryRecord {
+    int64_t timestamp_ms = 0; // wall clock, milliseconds since epoch
+    uint64_t duration_us = 0;
+    std::string statement;    // statement kind
+    std::string normalized_sql;
+    std::string plan;
+    uint64_t rows_scanned = 0;
+    uint64_t rows_returned = 0;
+    QueryPhaseTimings phases;
+    std::string error;
+};
+
+// Asynchronous slow query log. Queries submit records through a lock-free
+// queue; a background thread formats them as JSON lines and appends them
+// to the log file. When the queue is full, records are dropped rather than
+// stalling the query path.
+class SlowQueryLog {
+public:
+    SlowQueryLog(const std::string& path, uint64_t threshold_us, size_t queue_capacity = 1024);
+    ~SlowQueryLog();
+
+    SlowQueryLog(const SlowQueryLog&) = delete;
+    SlowQueryLog& operator=(const SlowQueryLog&) = delete;
+
+    uint64_t getThresholdMicros() const { return threshold_us_; }
+    bool isSlow(uint64_t duration_us) const { return duration_us >= threshold_us_; }
+
+    // Non-blocking; returns false if the record had to be dropped
+    bool submit(SlowQueryRecord record);
+
+    uint64_t getWrittenCount() const { return written_.load(std::memory_order_relaxed); }
+    uint64_t getDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    uint64_t threshold_us_;
+    std::ofstream out_;
+    LockFreeQueue<SlowQueryRecord> queue_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    // Only used to park the writer thread while the queue is empty
+    std::mutex wakeup_mutex_;
+    std::condition_variable wakeup_;
+    std::thread writer_;
+
+    void writerLoop();
+    size_t drain();
+    void writeRecord(const SlowQueryRecord& record);
+};
+
+} // namespace sqlengine
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "types.h"
+#include "memory_tracker.h"
+#include "spill_file.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sqlengine {
+
+// One ORDER BY key
+struct SortColumn {
+    size_t index;            // column position in the input rows
+    bool descending = false;
+    bool nulls_first = false;
+};
+
+// Append the normalized (memcmp-comparable) encoding of a row's sort key.
+// Comparing two encodings byte-wise gives the ORDER BY order, so the sort
+// never has to inspect Value types. Each column is a NULL marker byte
+// (placing NULLs first or last independently of direction) followed by
+// the value: sign-flipped big-endian integers, order-preserving IEEE
+// doubles, and escaped, terminated text. DESC columns have their value
+// bytes inverted.
+void encodeSortKey(const Row& row, const std::vector<SortColumn>& columns, std::string& out);
+
+// Sort operator that spills to disk when its input does not fit in the
+// query memory budget. Rows are buffered with their normalized keys; when
+// the budget is exhausted the buffer is sorted and written out as a run,
+// and the runs are combined with a k-way loser-tree merge over prefetching
+// readers.
+//
+// In-memory runs are sorted as fixed-size slots (inline 8-byte key prefix
+// plus a reference into a contiguous key arena) with an MSD radix sort
+// that hands small buckets to pdqsort.
+class ExternalSorter {
+public:
+    ExternalSorter(std::vector<SortColumn> columns, QueryMemoryContext* memory,
+                   std::string spill_directory);
+    ~ExternalSorter();
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    void add(Row row);
+
+    // End of input; sorted rows are then returned by next()
+    void finish();
+    bool next(Row& row);
+
+    size_t getSpilledRunCount() const { return runs_.size(); }
+
+private:
+    // Sorted in place of the rows; the first 8 key bytes are kept inline
+    // (big-endian) so most comparisons never touch the key arena
+    struct SortSlot {
+        uint64_t prefix;
+        uint64_t key_offset;
+        uint32_t key_length;
+        uint32_t row;
+    };
+
+    class Merger;
+
+    std::vector<SortColumn> columns_;
+    QueryMemoryContext* memory_;
+    std::string spill_directory_;
+
+    std::string key_arena_;
+    std::string scratch_key_;
+    std::vector<Row> rows_;
+    std::vector<SortSlot> slots_;
+    size_t output_position_ = 0;
+    size_t buffered_bytes_ = 0;
+
+    std::vector<std::unique_ptr<SpillFile>> runs_;
+    std::unique_ptr<Merger> merger_;
+
+    void sortBuffer();
+    void radixSort(SortSlot* begin, SortSlot* end, size_t depth, SortSlot* scratch);
+    void spillRun();
+    void releaseBuffer();
+};
+
+} // namespace sqlengine
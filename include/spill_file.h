@@ -0,0 +1,81 @@
+#pragma once
+
+#include "types.h"
+#include <cstdint>
+#include <future>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sqlengine {
+
+// Binary row encoding used for spilled data
+void encodeRow(const Row& row, std::string& out);
+Row decodeRow(const char* data, size_t length);
+
+// Records of operators that spill rows together with a binary key are laid
+// out as [u32 key length][key][encoded row]
+void encodeKeyedRecord(const std::string& key, const Row& row, std::string& out);
+std::string_view keyedRecordKey(const std::string& record);
+Row keyedRecordRow(const std::string& record);
+
+// Anonymous temporary file for operators that spill to disk. The file is
+// unlinked as soon as it is created, so it disappears with the descriptor
+// even if the process dies. Records are appended length-prefixed through
+// a write buffer.
+class SpillFile {
+public:
+    explicit SpillFile(const std::string& directory);
+    ~SpillFile();
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    void appendRecord(const std::string& record);
+    void finishWriting();
+
+    uint64_t getSize() const { return size_; }
+    uint64_t getRecordCount() const { return records_; }
+
+    // Positional read; returns the number of bytes read
+    size_t readAt(uint64_t offset, char* buffer, size_t length) const;
+
+private:
+    static constexpr size_t kWriteBufferSize = 256 * 1024;
+
+    int fd_ = -1;
+    std::string write_buffer_;
+    uint64_t size_ = 0;
+    uint64_t records_ = 0;
+
+    void flushBuffer();
+};
+
+// Sequential record reader over a SpillFile. While the current block is
+// being consumed, the next block is read ahead on a background task.
+class SpillReader {
+public:
+    explicit SpillReader(const SpillFile& file, size_t block_size = 256 * 1024);
+    ~SpillReader();
+
+    SpillReader(const SpillReader&) = delete;
+    SpillReader& operator=(const SpillReader&) = delete;
+
+    // Returns false at end of file
+    bool next(std::string& record);
+
+private:
+    const SpillFile& file_;
+    size_t block_size_;
+    uint64_t next_offset_ = 0;
+    std::vector<char> block_;
+    size_t position_ = 0;
+    std::future<std::vector<char>> prefetch_;
+
+    std::vector<char> readBlock(uint64_t offset) const;
+    void startPrefetch();
+    bool advanceBlock();
+    bool readBytes(char* out, size_t length);
+};
+
+} // namespace sqlengine
@@ -5,9 +5,24 @@
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <functional>
 
 namespace sqlengine {
 
+// Sees the rows inserted into a table before they are stored (used to keep
+// materialized views up to date). An insert is applied in two steps, so
+// that one listener rejecting it cannot leave another one updated:
+// prepareInsert is called on every listener and may throw to reject the
+// insert, then commitInsert on every listener applies what it prepared
+// and does not fail. A prepare that is not committed is discarded by the
+// next one.
+class TableListener {
+public:
+    virtual ~TableListener() = default;
+    virtual void prepareInsert(const Row* rows, size_t count) = 0;
+    virtual void commitInsert() = 0;
+};
+
 // Table class for in-memory storage
 class Table {
 public:
@@ -17,19 +32,86 @@ public:
     void insertRow(const Row& row);
     void insertRow(Row&& row);
     
+    // Validates every row, and lets every listener check them, before
+    // storing any of them, so a rejected batch leaves the table unchanged
+    void insertRows(std::vector<Row>&& rows);
+    
     const std::vector<Row>& getRows() const { return rows_; }
     const Schema& getSchema() const { return schema_; }
     const std::string& getName() const { return name_; }
     
     size_t getRowCount() const { return rows_.size(); }
+    size_t getByteSize() const { return byte_size_; }
+    
+    // Changes whenever the contents change. Versions are unique across all
+    // tables, so a dropped and recreated table never reuses one.
+    uint64_t getVersion() const { return version_; }
     
     // Validate row against schema
     bool validateRow(const Row& row) const;
+    
+    void addListener(std::shared_ptr<TableListener> listener);
+    void removeListener(const TableListener* listener);
 
 private:
     std::string name_;
     Schema schema_;
     std::vector<Row> rows_;
+    size_t byte_size_ = 0;
+    uint64_t version_;
+    std::vector<std::shared_ptr<TableListener>> listeners_;
+    
+    void notifyInsert(const Row* rows, size_t count);
+};
+
+// Condition "column op value" that every row of a scan has to pass
+struct ScanFilter {
+    enum class Op { EQUAL, NOT_EQUAL, LESS_THAN, LESS_EQUAL, GREATER_THAN, GREATER_EQUAL };
+    
+    size_t column;
+    Op op;
+    Value value; // not NULL
+};
+
+// What a query reads from a table, so that a source able to skip data
+// produces only that: columns not marked in columns may be left NULL, and
+// rows failing a filter may be left out (the query still checks them)
+struct ScanRequest {
+    std::vector<bool> columns;
+    std::vector<ScanFilter> filters;
+};
+
+// Read-only table whose rows are produced on demand when scanned
+// (used for system tables, materialized views and external tables)
+class VirtualTable {
+public:
+    using RowGenerator = std::function<std::vector<Row>()>;
+    using ScanGenerator = std::function<std::vector<Row>(const ScanRequest&)>;
+    
+    VirtualTable(const std::string& name, const Schema& schema, RowGenerator generator);
+    
+    // Table backed by a file, which is dropped with DROP TABLE
+    VirtualTable(const std::string& name, const Schema& schema, ScanGenerator generator,
+                 const std::string& source_path);
+    
+    const Schema& getSchema() const { return schema_; }
+    const std::string& getName() const { return name_; }
+    
+    // File an external table reads, empty for other virtual tables
+    const std::string& getSourcePath() const { return source_path_; }
+    
+    // Build a point-in-time snapshot of the table contents
+    std::unique_ptr<Table> materialize() const;
+    
+    // Snapshot of what a scan needs; columns outside the request are NULL
+    std::unique_ptr<Table> materialize(const ScanRequest& request) const;
+
+private:
+    std::string name_;
+    Schema schema_;
+    RowGenerator generator_;
+    ScanGenerator scan_generator_;
+    std::string source_path_;
 };
 
 // Database class to manage multiple tables
@@ -46,9 +128,22 @@ public:
     void dropTable(const std::string& name);
     
     std::vector<std::string> getTableNames() const;
+    
+    // Version of a table's contents, or 0 if it does not exist
+    uint64_t getTableVersion(const std::string& name) const;
+    
+    // Virtual (read-only) table management
+    void registerVirtualTable(const std::string& name, const Schema& schema,
+                              VirtualTable::RowGenerator generator);
+    void registerExternalTable(const std::string& name, const Schema& schema,
+                               VirtualTable::ScanGenerator generator, const std::string& source_path);
+    const VirtualTable* getVirtualTable(const std::string& name) const;
+    bool hasVirtualTable(const std::string& name) const;
+    void dropVirtualTable(const std::string& name);
 
 private:
     std::unordered_map<std::string, std::unique_ptr<Table>> tables_;
+    std::unordered_map<std::string, std::unique_ptr<VirtualTable>> virtual_tables_;
 };
 
 } // namespace sqlengine
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "storage.h"
+#include "metrics.h"
+#include "memory_tracker.h"
+#include "query_control.h"
+#include "result_cache.h"
+
+namespace sqlengine {
+
+// Register the read-only sys_* tables on a database.
+//
+//   sys_queries        per statement kind: executions, errors, rows, latency percentiles
+//   sys_query_latency  latency histogram buckets per statement kind
+//   sys_tables         per table: row count, column count, estimated bytes
+//   sys_jit_cache      JIT compilation and cache counters
+//   sys_memory         memory usage by component
+//   sys_running_queries queries currently executing, with their ids for cancel()
+//   sys_result_cache   result cache counters
+//
+// Rows are built from the live counters only when a table is scanned.
+void registerSystemTables(Database& database, const EngineMetrics& metrics, const JITStats& jit_stats,
+                          const MemoryTracker& memory_tracker, const QueryRegistry& query_registry,
+                          const ResultCache& result_cache);
+
+} // namespace sqlengine
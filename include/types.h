@@ -41,6 +41,11 @@ public:
         return std::holds_alternative<std::nullptr_t>(data_);
     }
     
+    template<typename T>
+    bool holds() const {
+        return std::holds_alternative<T>(data_);
+    }
+    
     // Comparison operators
     bool operator==(const Value& other) const;
     bool operator<(const Value& other) const;
@@ -67,6 +72,9 @@ struct Column {
 // Row representation
 using Row = std::vector<Value>;
 
+// Approximate heap footprint of a row in bytes
+size_t estimateRowSize(const Row& row);
+
 // Schema definition
 class Schema {
 public:
@@ -83,12 +83,28 @@ int main() {
         // Query products
         executeSQL(engine, "SELECT * FROM products");
         
+        // Join and aggregate
+        executeSQL(engine, "CREATE TABLE orders (id INTEGER, user_id INTEGER, product_id INTEGER)");
+        executeSQL(engine, "INSERT INTO orders VALUES (1, 1, 1), (2, 1, 2), (3, 3, 2)");
+        executeSQL(engine, "SELECT u.name, COUNT(*), SUM(p.price) FROM users u JOIN orders o ON u.id = o.user_id "
+                           "JOIN products p ON p.id = o.product_id GROUP BY u.name ORDER BY u.name");
+        
+        // Materialized view maintained on every insert
+        executeSQL(engine, "CREATE MATERIALIZED VIEW orders_per_user AS "
+                           "SELECT user_id, COUNT(*) FROM orders GROUP BY user_id");
+        executeSQL(engine, "INSERT INTO orders VALUES (4, 2, 1)");
+        executeSQL(engine, "SELECT * FROM orders_per_user ORDER BY user_id");
+        
         // Drop a table
         executeSQL(engine, "DROP TABLE products");
         
         // Try to query dropped table (should fail)
         executeSQL(engine, "SELECT * FROM products");
         
+        // Inspect engine metrics through the system tables
+        executeSQL(engine, "SELECT * FROM sys_tables");
+        executeSQL(engine, "SELECT statement, executions, errors, p99_us FROM sys_queries WHERE executions > 0");
+        
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,101 @@
+#include "pg_server.h"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace sqlengine;
+
+namespace {
+
+PgServer* running_server = nullptr;
+
+void handleSignal(int) {
+    if (running_server) {
+        running_server->stop();
+    }
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --host HOST              TCP address to listen on (default 127.0.0.1)\n"
+              << "  --port PORT              TCP port, also names the Unix socket (default 5432)\n"
+              << "  --no-tcp                 Only listen on the Unix socket\n"
+              << "  --socket-dir DIR         Directory of the Unix socket .s.PGSQL.<port>\n"
+              << "                           (default /tmp; empty disables it)\n"
+              << "  --query-timeout-ms N     Fail statements running longer than N ms\n"
+              << "  --query-memory-limit N   Working memory per statement in bytes\n"
+              << "  --result-cache-bytes N   Cache SELECT results in up to N bytes\n"
+              << "  --jit-cache-dir DIR      Keep compiled queries in DIR across restarts\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string host = "127.0.0.1";
+    uint16_t port = 5432;
+    bool tcp = true;
+    std::string socket_dir = "/tmp";
+    QueryEngine engine;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (option == "--no-tcp") {
+            tcp = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--host") {
+            host = value;
+        } else if (option == "--port") {
+            port = static_cast<uint16_t>(std::stoul(value));
+        } else if (option == "--socket-dir") {
+            socket_dir = value;
+        } else if (option == "--query-timeout-ms") {
+            engine.setQueryTimeout(std::stoull(value));
+        } else if (option == "--query-memory-limit") {
+            engine.setQueryMemoryLimit(std::stoull(value));
+        } else if (option == "--result-cache-bytes") {
+            engine.setResultCacheCapacity(std::stoull(value));
+        } else if (option == "--jit-cache-dir") {
+            engine.enableJITObjectCache(value);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    try {
+        PgServer server(engine);
+        if (tcp) {
+            server.listenTcp(host, port);
+            std::cout << "Listening on " << host << ":" << port << "\n";
+        }
+        if (!socket_dir.empty()) {
+            // The path psql and libpq derive from -h DIR and -p PORT
+            std::string path = socket_dir + "/.s.PGSQL." + std::to_string(port);
+            server.listenUnix(path);
+            std::cout << "Listening on " << path << "\n";
+        }
+
+        running_server = &server;
+        std::signal(SIGINT, handleSignal);
+        std::signal(SIGTERM, handleSignal);
+        std::signal(SIGPIPE, SIG_IGN);
+        server.run();
+        running_server = nullptr;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,315 @@
+#include "arrow_c_data.h"
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace sqlengine {
+
+namespace {
+
+// Stands in for empty buffers, which the interface requires to be non-null
+alignas(8) const uint8_t kEmptyBuffer[8] = {};
+
+const void* bufferPointer(const void* data, size_t size) {
+    return size > 0 ? data : kEmptyBuffer;
+}
+
+const char* arrowFormat(DataType type) {
+    switch (type) {
+        case DataType::INTEGER: return "l";
+        case DataType::REAL: return "g";
+        case DataType::TEXT: return "u";
+        case DataType::BOOLEAN: return "b";
+        case DataType::NULL_TYPE: return "n";
+    }
+    return "n";
+}
+
+// Each exported schema and array node owns its private data, so that a
+// consumer can move children out and release them on their own. A parent
+// releases the children that are still in place.
+struct ExportedSchema {
+    std::string format;
+    std::string name;
+    std::vector<ArrowSchema> children;
+    std::vector<ArrowSchema*> child_pointers;
+};
+
+struct ExportedArray {
+    std::unique_ptr<ArrowColumn> column;
+    std::vector<const void*> buffers;
+    std::vector<ArrowArray> children;
+    std::vector<ArrowArray*> child_pointers;
+};
+
+void releaseSchema(ArrowSchema* schema) {
+    auto exported = static_cast<ExportedSchema*>(schema->private_data);
+    for (auto& child : exported->children) {
+        if (child.release) {
+            child.release(&child);
+        }
+    }
+    delete exported;
+    schema->release = nullptr;
+}
+
+void releaseArray(ArrowArray* array) {
+    auto exported = static_cast<ExportedArray*>(array->private_data);
+    for (auto& child : exported->children) {
+        if (child.release) {
+            child.release(&child);
+        }
+    }
+    delete exported;
+    array->release = nullptr;
+}
+
+void initSchema(ArrowSchema* schema, std::unique_ptr<ExportedSchema> exported, int64_t flags) {
+    schema->format = exported->format.c_str();
+    schema->name = exported->name.c_str();
+    schema->metadata = nullptr;
+    schema->flags = flags;
+    schema->n_children = static_cast<int64_t>(exported->children.size());
+    schema->children = exported->child_pointers.empty() ? nullptr : exported->child_pointers.data();
+    schema->dictionary = nullptr;
+    schema->release = releaseSchema;
+    schema->private_data = exported.release();
+}
+
+void initArray(ArrowArray* array, std::unique_ptr<ExportedArray> exported, int64_t length, int64_t null_count) {
+    array->length = length;
+    array->null_count = null_count;
+    array->offset = 0;
+    array->n_buffers = static_cast<int64_t>(exported->buffers.size());
+    array->n_children = static_cast<int64_t>(exported->children.size());
+    array->buffers = exported->buffers.empty() ? nullptr : exported->buffers.data();
+    array->children = exported->child_pointers.empty() ? nullptr : exported->child_pointers.data();
+    array->dictionary = nullptr;
+    array->release = releaseArray;
+    array->private_data = exported.release();
+}
+
+void exportColumn(std::unique_ptr<ArrowColumn> column, ArrowArray* out) {
+    auto exported = std::make_unique<ExportedArray>();
+    if (column->type != DataType::NULL_TYPE) {
+        exported->buffers.push_back(column->null_count > 0 ? column->validity.data() : nullptr);
+        if (column->type == DataType::TEXT) {
+            exported->buffers.push_back(column->offsets.data());
+        }
+        exported->buffers.push_back(bufferPointer(column->values.data(), column->values.size()));
+    }
+    int64_t length = column->length;
+    int64_t null_count = column->null_count;
+    exported->column = std::move(column);
+    initArray(out, std::move(exported), length, null_count);
+}
+
+// Releases an imported schema and array when the import finishes
+struct ImportGuard {
+    ArrowSchema* schema;
+    ArrowArray* array;
+
+    ~ImportGuard() {
+        if (array && array->release) array->release(array);
+        if (schema && schema->release) schema->release(schema);
+    }
+};
+
+bool isValid(const ArrowArray& array, int64_t index) {
+    auto validity = array.n_buffers > 0 ? static_cast<const uint8_t*>(array.buffers[0]) : nullptr;
+    return array.null_count == 0 || !validity || (validity[index / 8] >> (index % 8)) & 1;
+}
+
+DataType importedType(const ArrowSchema& schema) {
+    if (!schema.format || std::strlen(schema.format) != 1) {
+        throw std::runtime_error("Unsupported Arrow format: " + std::string(schema.format ? schema.format : ""));
+    }
+    switch (schema.format[0]) {
+        case 'c': case 'C': case 's': case 'S':
+        case 'i': case 'I': case 'l': case 'L':
+            return DataType::INTEGER;
+        case 'f': case 'g':
+            return DataType::REAL;
+        case 'b':
+            return DataType::BOOLEAN;
+        case 'u': case 'U':
+            return DataType::TEXT;
+        case 'n':
+            return DataType::NULL_TYPE;
+        default:
+            throw std::runtime_error("Unsupported Arrow format: " + std::string(schema.format));
+    }
+}
+
+template<typename T>
+void loadIntegers(const ArrowArray& array, int64_t offset, size_t column, std::vector<Row>& rows) {
+    auto values = static_cast<const T*>(array.buffers[1]);
+    for (size_t row = 0; row < rows.size(); ++row) {
+        int64_t index = offset + static_cast<int64_t>(row);
+        if (!isValid(array, index)) continue;
+        T value = values[index];
+        if (!std::numeric_limits<T>::is_signed &&
+            static_cast<uint64_t>(value) > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+            throw std::runtime_error("Arrow value does not fit in INTEGER");
+        }
+        rows[row][column] = Value(static_cast<int64_t>(value));
+    }
+}
+
+template<typename T>
+void loadReals(const ArrowArray& array, int64_t offset, size_t column, std::vector<Row>& rows) {
+    auto values = static_cast<const T*>(array.buffers[1]);
+    for (size_t row = 0; row < rows.size(); ++row) {
+        int64_t index = offset + static_cast<int64_t>(row);
+        if (isValid(array, index)) {
+            rows[row][column] = Value(static_cast<double>(values[index]));
+        }
+    }
+}
+
+template<typename Offset>
+void loadStrings(const ArrowArray& array, int64_t offset, size_t column, std::vector<Row>& rows) {
+    auto offsets = static_cast<const Offset*>(array.buffers[1]);
+    auto data = static_cast<const char*>(array.buffers[2]);
+    for (size_t row = 0; row < rows.size(); ++row) {
+        int64_t index = offset + static_cast<int64_t>(row);
+        if (isValid(array, index)) {
+            rows[row][column] = Value(std::string(data + offsets[index], data + offsets[index + 1]));
+        }
+    }
+}
+
+// Fills one column of the rows from a child array; rows start out NULL
+void loadColumn(const ArrowSchema& schema, const ArrowArray& array, int64_t parent_offset,
+                size_t column, std::vector<Row>& rows) {
+    if (array.length < parent_offset + static_cast<int64_t>(rows.size())) {
+        throw std::runtime_error("Arrow child array is shorter than its parent");
+    }
+    int64_t offset = parent_offset + array.offset;
+    switch (schema.format[0]) {
+        case 'c': loadIntegers<int8_t>(array, offset, column, rows); break;
+        case 'C': loadIntegers<uint8_t>(array, offset, column, rows); break;
+        case 's': loadIntegers<int16_t>(array, offset, column, rows); break;
+        case 'S': loadIntegers<uint16_t>(array, offset, column, rows); break;
+        case 'i': loadIntegers<int32_t>(array, offset, column, rows); break;
+        case 'I': loadIntegers<uint32_t>(array, offset, column, rows); break;
+        case 'l': loadIntegers<int64_t>(array, offset, column, rows); break;
+        case 'L': loadIntegers<uint64_t>(array, offset, column, rows); break;
+        case 'f': loadReals<float>(array, offset, column, rows); break;
+        case 'g': loadReals<double>(array, offset, column, rows); break;
+        case 'u': loadStrings<int32_t>(array, offset, column, rows); break;
+        case 'U': loadStrings<int64_t>(array, offset, column, rows); break;
+        case 'b': {
+            auto bits = static_cast<const uint8_t*>(array.buffers[1]);
+            for (size_t row = 0; row < rows.size(); ++row) {
+                int64_t index = offset + static_cast<int64_t>(row);
+                if (isValid(array, index)) {
+                    rows[row][column] = Value(static_cast<bool>((bits[index / 8] >> (index % 8)) & 1));
+                }
+            }
+            break;
+        }
+        default:
+            break; // 'n': every value is NULL
+    }
+}
+
+} // namespace
+
+void exportArrowColumns(std::vector<ArrowColumn> columns, int64_t length,
+                        ArrowSchema* out_schema, ArrowArray* out_array) {
+    auto schema = std::make_unique<ExportedSchema>();
+    auto array = std::make_unique<ExportedArray>();
+    schema->format = "+s";
+    schema->children.resize(columns.size());
+    array->buffers.push_back(nullptr); // no struct-level NULLs
+    array->children.resize(columns.size());
+
+    for (size_t i = 0; i < columns.size(); ++i) {
+        auto child = std::make_unique<ExportedSchema>();
+        child->format = arrowFormat(columns[i].type);
+        child->name = columns[i].name;
+        bool nullable = columns[i].nullable || columns[i].type == DataType::NULL_TYPE;
+        initSchema(&schema->children[i], std::move(child), nullable ? ARROW_FLAG_NULLABLE : 0);
+        schema->child_pointers.push_back(&schema->children[i]);
+
+        exportColumn(std::make_unique<ArrowColumn>(std::move(columns[i])), &array->children[i]);
+        array->child_pointers.push_back(&array->children[i]);
+    }
+
+    initSchema(out_schema, std::move(schema), 0);
+    initArray(out_array, std::move(array), length, 0);
+}
+
+void exportArrowTable(const Table& table, ArrowSchema* out_schema, ArrowArray* out_array) {
+    const auto& rows = table.getRows();
+    auto columns = rowsToArrowColumns(table.getSchema(), rows, 0, rows.size());
+    exportArrowColumns(std::move(columns), static_cast<int64_t>(rows.size()), out_schema, out_array);
+}
+
+void importArrowArray(Database& database, const std::string& table_name,
+                      ArrowSchema* schema, ArrowArray* array) {
+    ImportGuard guard{schema, array};
+    if (!schema->format || std::strcmp(schema->format, "+s") != 0) {
+        throw std::runtime_error("Arrow import expects a struct array");
+    }
+    if (array->n_children != schema->n_children) {
+        throw std::runtime_error("Arrow array does not match its schema");
+    }
+    if (array->null_count != 0 && array->n_buffers > 0 && array->buffers[0]) {
+        throw std::runtime_error("Arrow struct array with NULL rows cannot be loaded");
+    }
+
+    std::vector<DataType> types;
+    for (int64_t i = 0; i < schema->n_children; ++i) {
+        types.push_back(importedType(*schema->children[i]));
+    }
+
+    bool created = false;
+    Table* table = database.getTable(table_name);
+    if (!table) {
+        Schema table_schema;
+        for (int64_t i = 0; i < schema->n_children; ++i) {
+            const ArrowSchema& child = *schema->children[i];
+            if (types[i] == DataType::NULL_TYPE) {
+                throw std::runtime_error("Cannot create a column from Arrow null type");
+            }
+            std::string name = child.name && *child.name ? child.name : "column_" + std::to_string(i + 1);
+            table_schema.addColumn(Column(name, types[i], (child.flags & ARROW_FLAG_NULLABLE) != 0));
+        }
+        database.createTable(table_name, table_schema);
+        table = database.getTable(table_name);
+        created = true;
+    }
+
+    try {
+        const Schema& table_schema = table->getSchema();
+        if (table_schema.getColumnCount() != types.size()) {
+            throw std::runtime_error("Arrow array has " + std::to_string(types.size()) +
+                                     " columns, table " + table_name + " has " +
+                                     std::to_string(table_schema.getColumnCount()));
+        }
+        for (size_t i = 0; i < types.size(); ++i) {
+            const Column& column = table_schema.getColumn(i);
+            if (types[i] != column.type && types[i] != DataType::NULL_TYPE) {
+                throw std::runtime_error("Arrow column " + std::to_string(i + 1) +
+                                         " does not match the type of column " + column.name);
+            }
+        }
+
+        // Filled a column at a time, then stored through the bulk insert
+        std::vector<Row> rows(static_cast<size_t>(array->length), Row(types.size()));
+        for (size_t i = 0; i < types.size(); ++i) {
+            loadColumn(*schema->children[i], *array->children[i], array->offset, i, rows);
+        }
+        table->insertRows(std::move(rows));
+    } catch (...) {
+        if (created) {
+            database.dropTable(table_name);
+        }
+        throw;
+    }
+}
+
+} // namespace sqlengine
@@ -0,0 +1,449 @@
+#include "arrow_ipc.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace sqlengine {
+
+namespace {
+
+// Arrow metadata constants (Schema.fbs and Message.fbs)
+constexpr int16_t kMetadataVersionV5 = 4;
+constexpr uint8_t kHeaderSchema = 1;
+constexpr uint8_t kHeaderRecordBatch = 3;
+constexpr uint8_t kTypeNull = 1;
+constexpr uint8_t kTypeInt = 2;
+constexpr uint8_t kTypeFloatingPoint = 3;
+constexpr uint8_t kTypeUtf8 = 5;
+constexpr uint8_t kTypeBool = 6;
+constexpr int16_t kPrecisionDouble = 2;
+constexpr uint32_t kContinuation = 0xFFFFFFFF;
+
+// Arrow requires buffers and messages to start at multiples of 8
+constexpr size_t kAlignment = 8;
+
+size_t bitmapBytes(int64_t bits) {
+    return static_cast<size_t>((bits + 7) / 8);
+}
+
+size_t alignUp(size_t size) {
+    return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+void setBit(std::vector<uint8_t>& bitmap, int64_t index, bool value) {
+    if (bitmap.size() < bitmapBytes(index + 1)) {
+        bitmap.resize(bitmapBytes(index + 1), 0);
+    }
+    if (value) {
+        bitmap[index / 8] |= static_cast<uint8_t>(1u << (index % 8));
+    }
+}
+
+// The bitmap is only built once the first NULL arrives; the rows before
+// it are all valid
+void appendValidity(ArrowColumn& column, bool valid) {
+    if (column.validity.empty()) {
+        if (valid) return;
+        for (int64_t row = 0; row < column.length; ++row) {
+            setBit(column.validity, row, true);
+        }
+    }
+    setBit(column.validity, column.length, valid);
+}
+
+template<typename T>
+void appendScalar(std::vector<uint8_t>& values, T value) {
+    size_t offset = values.size();
+    values.resize(offset + sizeof(T));
+    std::memcpy(values.data() + offset, &value, sizeof(T));
+}
+
+// Minimal FlatBuffers encoder for the Arrow metadata messages. Objects are
+// laid out front to back: a table is written with placeholders for its
+// references and the objects it references are appended after it, so
+// every uoffset points forward as the format requires. Scalars are
+// aligned to their size relative to the start of the buffer.
+class FlatBuffer {
+public:
+    struct Object;
+    using Ref = std::shared_ptr<Object>;
+
+    struct Field {
+        uint16_t id;
+        size_t size;     // inline size: a scalar's width, or 4 for a reference
+        uint64_t scalar;
+        Ref object;
+    };
+
+    struct Object {
+        enum class Kind { TABLE, STRING, TABLE_VECTOR, STRUCT_VECTOR } kind;
+        std::vector<Field> fields;   // TABLE
+        std::string bytes;           // STRING, or the packed STRUCT_VECTOR elements
+        size_t count = 0;            // STRUCT_VECTOR
+        std::vector<Ref> elements;   // TABLE_VECTOR
+    };
+
+    static Ref table() { return make(Object::Kind::TABLE); }
+
+    static Ref string(const std::string& value) {
+        auto object = make(Object::Kind::STRING);
+        object->bytes = value;
+        return object;
+    }
+
+    static Ref tables(std::vector<Ref> elements) {
+        auto object = make(Object::Kind::TABLE_VECTOR);
+        object->elements = std::move(elements);
+        return object;
+    }
+
+    // Vector of structs made of two int64s (Arrow's FieldNode and Buffer)
+    static Ref longPairs(const std::vector<std::pair<int64_t, int64_t>>& pairs) {
+        auto object = make(Object::Kind::STRUCT_VECTOR);
+        object->count = pairs.size();
+        for (const auto& pair : pairs) {
+            object->bytes.append(reinterpret_cast<const char*>(&pair.first), sizeof(int64_t));
+            object->bytes.append(reinterpret_cast<const char*>(&pair.second), sizeof(int64_t));
+        }
+        return object;
+    }
+
+    template<typename T>
+    static void add(const Ref& table, uint16_t id, T value) {
+        uint64_t scalar = 0;
+        std::memcpy(&scalar, &value, sizeof(T));
+        table->fields.push_back({id, sizeof(T), scalar, nullptr});
+    }
+
+    static void add(const Ref& table, uint16_t id, Ref object) {
+        table->fields.push_back({id, sizeof(uint32_t), 0, std::move(object)});
+    }
+
+    // Serializes a buffer whose root is the given table, padded to kAlignment
+    static std::string finish(const Object& root) {
+        std::string buffer(sizeof(uint32_t), '\0');
+        patchOffset(buffer, 0, write(buffer, root));
+        buffer.resize(alignUp(buffer.size()), '\0');
+        return buffer;
+    }
+
+private:
+    static Ref make(Object::Kind kind) {
+        auto object = std::make_shared<Object>();
+        object->kind = kind;
+        return object;
+    }
+
+    static void pad(std::string& buffer, size_t alignment, size_t bias = 0) {
+        while ((buffer.size() + bias) % alignment != 0) {
+            buffer.push_back('\0');
+        }
+    }
+
+    template<typename T>
+    static void put(std::string& buffer, T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void patchOffset(std::string& buffer, size_t at, size_t target) {
+        uint32_t offset = static_cast<uint32_t>(target - at);
+        std::memcpy(&buffer[at], &offset, sizeof(offset));
+    }
+
+    // Writes the object at the end of the buffer and returns its position
+    static size_t write(std::string& buffer, const Object& object) {
+        switch (object.kind) {
+            case Object::Kind::STRING: {
+                pad(buffer, sizeof(uint32_t));
+                size_t position = buffer.size();
+                put(buffer, static_cast<uint32_t>(object.bytes.size()));
+                buffer.append(object.bytes);
+                buffer.push_back('\0');
+                return position;
+            }
+            case Object::Kind::STRUCT_VECTOR: {
+                // Elements follow the length and are 8-byte aligned
+                pad(buffer, sizeof(int64_t), sizeof(uint32_t));
+                size_t position = buffer.size();
+                put(buffer, static_cast<uint32_t>(object.count));
+                buffer.append(object.bytes);
+                return position;
+            }
+            case Object::Kind::TABLE_VECTOR: {
+                pad(buffer, sizeof(uint32_t));
+                size_t position = buffer.size();
+                put(buffer, static_cast<uint32_t>(object.elements.size()));
+                size_t slots = buffer.size();
+                buffer.append(object.elements.size() * sizeof(uint32_t), '\0');
+                for (size_t i = 0; i < object.elements.size(); ++i) {
+                    patchOffset(buffer, slots + i * sizeof(uint32_t), write(buffer, *object.elements[i]));
+                }
+                return position;
+            }
+            case Object::Kind::TABLE:
+                break;
+        }
+
+        // Inline layout: the vtable offset, then the fields widest first so
+        // that aligning the table to 8 bytes aligns every field
+        std::vector<const Field*> fields;
+        uint16_t field_slots = 0;
+        for (const auto& field : object.fields) {
+            fields.push_back(&field);
+            field_slots = std::max<uint16_t>(field_slots, field.id + 1);
+        }
+        std::stable_sort(fields.begin(), fields.end(),
+                         [](const Field* a, const Field* b) { return a->size > b->size; });
+        std::vector<uint16_t> field_offsets(field_slots, 0);
+        size_t table_size = sizeof(int32_t);
+        for (const Field* field : fields) {
+            table_size = (table_size + field->size - 1) / field->size * field->size;
+            field_offsets[field->id] = static_cast<uint16_t>(table_size);
+            table_size += field->size;
+        }
+
+        // The vtable precedes the table, which refers back to it
+        pad(buffer, sizeof(uint16_t));
+        size_t vtable = buffer.size();
+        put(buffer, static_cast<uint16_t>(sizeof(uint16_t) * (2 + field_slots)));
+        put(buffer, static_cast<uint16_t>(table_size));
+        for (uint16_t offset : field_offsets) {
+            put(buffer, offset);
+        }
+
+        pad(buffer, kAlignment);
+        size_t position = buffer.size();
+        put(buffer, static_cast<int32_t>(position - vtable));
+        buffer.resize(position + table_size, '\0');
+        for (const Field* field : fields) {
+            if (!field->object) {
+                std::memcpy(&buffer[position + field_offsets[field->id]], &field->scalar, field->size);
+            }
+        }
+        for (const Field* field : fields) {
+            if (field->object) {
+                size_t at = position + field_offsets[field->id];
+                patchOffset(buffer, at, write(buffer, *field->object));
+            }
+        }
+        return position;
+    }
+};
+
+FlatBuffer::Ref arrowType(DataType type, uint8_t& type_id) {
+    auto table = FlatBuffer::table();
+    switch (type) {
+        case DataType::INTEGER:
+            type_id = kTypeInt;
+            FlatBuffer::add(table, 0, int32_t(64)); // bitWidth
+            FlatBuffer::add(table, 1, true);        // is_signed
+            break;
+        case DataType::REAL:
+            type_id = kTypeFloatingPoint;
+            FlatBuffer::add(table, 0, kPrecisionDouble);
+            break;
+        case DataType::TEXT:
+            type_id = kTypeUtf8;
+            break;
+        case DataType::BOOLEAN:
+            type_id = kTypeBool;
+            break;
+        case DataType::NULL_TYPE:
+            type_id = kTypeNull;
+            break;
+    }
+    return table;
+}
+
+// Appends one encapsulated message: continuation marker, metadata length,
+// the Message flatbuffer and the body
+void writeMessage(std::string& out, uint8_t header_type, FlatBuffer::Ref header, const std::string& body) {
+    auto message = FlatBuffer::table();
+    FlatBuffer::add(message, 0, kMetadataVersionV5);
+    FlatBuffer::add(message, 1, header_type);
+    FlatBuffer::add(message, 2, std::move(header));
+    FlatBuffer::add(message, 3, static_cast<int64_t>(body.size()));
+    std::string metadata = FlatBuffer::finish(*message);
+
+    uint32_t continuation = kContinuation;
+    int32_t length = static_cast<int32_t>(metadata.size());
+    out.append(reinterpret_cast<const char*>(&continuation), sizeof(continuation));
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.append(metadata);
+    out.append(body);
+}
+
+void writeSchemaMessage(std::string& out, const Schema& schema) {
+    std::vector<FlatBuffer::Ref> fields;
+    for (const auto& column : schema.getColumns()) {
+        auto field = FlatBuffer::table();
+        uint8_t type_id = 0;
+        auto type = arrowType(column.type, type_id);
+        FlatBuffer::add(field, 0, FlatBuffer::string(column.name));
+        FlatBuffer::add(field, 1, column.nullable || column.type == DataType::NULL_TYPE);
+        FlatBuffer::add(field, 2, type_id);
+        FlatBuffer::add(field, 3, std::move(type));
+        FlatBuffer::add(field, 5, FlatBuffer::tables({})); // children
+        fields.push_back(std::move(field));
+    }
+
+    auto header = FlatBuffer::table();
+    FlatBuffer::add(header, 1, FlatBuffer::tables(std::move(fields)));
+    writeMessage(out, kHeaderSchema, std::move(header), "");
+}
+
+void writeRecordBatch(std::string& out, const std::vector<ArrowColumn>& columns, int64_t length) {
+    std::vector<std::pair<int64_t, int64_t>> nodes;
+    std::vector<std::pair<int64_t, int64_t>> buffers;
+    std::string body;
+    auto addBuffer = [&](const void* data, size_t size) {
+        buffers.emplace_back(static_cast<int64_t>(body.size()), static_cast<int64_t>(size));
+        body.append(static_cast<const char*>(data), size);
+        body.resize(alignUp(body.size()), '\0');
+    };
+
+    for (const auto& column : columns) {
+        nodes.emplace_back(column.length, column.null_count);
+        if (column.type == DataType::NULL_TYPE) {
+            continue;
+        }
+        addBuffer(column.validity.data(), column.null_count > 0 ? bitmapBytes(column.length) : 0);
+        if (column.type == DataType::TEXT) {
+            addBuffer(column.offsets.data(), column.offsets.size() * sizeof(int32_t));
+        }
+        addBuffer(column.values.data(), column.values.size());
+    }
+
+    auto header = FlatBuffer::table();
+    FlatBuffer::add(header, 0, length);
+    FlatBuffer::add(header, 1, FlatBuffer::longPairs(nodes));
+    FlatBuffer::add(header, 2, FlatBuffer::longPairs(buffers));
+    writeMessage(out, kHeaderRecordBatch, std::move(header), body);
+}
+
+} // namespace
+
+ArrowColumn::ArrowColumn(const std::string& n, DataType t, bool null)
+    : name(n), type(t), nullable(null) {
+    if (type == DataType::TEXT) {
+        offsets.push_back(0);
+    }
+}
+
+void ArrowColumn::reserve(size_t rows) {
+    switch (type) {
+        case DataType::INTEGER:
+        case DataType::REAL:
+            values.reserve(rows * sizeof(int64_t));
+            break;
+        case DataType::BOOLEAN:
+            values.reserve(bitmapBytes(rows));
+            break;
+        case DataType::TEXT:
+            offsets.reserve(rows + 1);
+            break;
+        case DataType::NULL_TYPE:
+            break;
+    }
+}
+
+void ArrowColumn::append(const Value& value) {
+    bool valid = !value.isNull();
+    if (valid && value.getType() != type &&
+        !(type == DataType::REAL && value.getType() == DataType::INTEGER)) {
+        throw std::runtime_error("Value " + value.toString() + " does not match the type of column " + name);
+    }
+    appendValidity(*this, valid);
+    if (!valid) {
+        ++null_count;
+    }
+
+    // NULL slots hold zeros (or an empty string)
+    switch (type) {
+        case DataType::INTEGER:
+            appendScalar<int64_t>(values, valid ? value.get<int64_t>() : 0);
+            break;
+        case DataType::REAL: {
+            double d = 0.0;
+            if (valid) {
+                d = value.getType() == DataType::INTEGER ? static_cast<double>(value.get<int64_t>())
+                                                         : value.get<double>();
+            }
+            appendScalar<double>(values, d);
+            break;
+        }
+        case DataType::BOOLEAN:
+            setBit(values, length, valid && value.get<bool>());
+            break;
+        case DataType::TEXT: {
+            if (valid) {
+                const auto& text = value.get<std::string>();
+                if (values.size() + text.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+                    throw std::runtime_error("Text of column " + name + " exceeds 2 GB in one batch");
+                }
+                values.insert(values.end(), text.begin(), text.end());
+            }
+            offsets.push_back(static_cast<int32_t>(values.size()));
+            break;
+        }
+        case DataType::NULL_TYPE:
+            break;
+    }
+    ++length;
+}
+
+std::vector<ArrowColumn> rowsToArrowColumns(const Schema& schema, const std::vector<Row>& rows,
+                                            size_t begin, size_t end) {
+    std::vector<ArrowColumn> columns;
+    columns.reserve(schema.getColumnCount());
+    for (const auto& column : schema.getColumns()) {
+        columns.emplace_back(column.name, column.type, column.nullable);
+        columns.back().reserve(end - begin);
+    }
+    for (size_t i = begin; i < end; ++i) {
+        const Row& row = rows[i];
+        if (row.size() != columns.size()) {
+            throw std::runtime_error("Row does not match the result schema");
+        }
+        for (size_t c = 0; c < columns.size(); ++c) {
+            columns[c].append(row[c]);
+        }
+    }
+    return columns;
+}
+
+Schema resolveResultSchema(const Schema& schema, const std::vector<Row>& rows) {
+    Schema resolved;
+    for (size_t c = 0; c < schema.getColumnCount(); ++c) {
+        Column column = schema.getColumn(c);
+        if (column.type == DataType::NULL_TYPE) {
+            for (const auto& row : rows) {
+                if (c < row.size() && !row[c].isNull()) {
+                    column.type = row[c].getType();
+                    break;
+                }
+            }
+        }
+        resolved.addColumn(column);
+    }
+    return resolved;
+}
+
+std::string encodeArrowStream(const Schema& schema, const std::vector<Row>& rows, size_t batch_rows) {
+    std::string out;
+    writeSchemaMessage(out, schema);
+    for (size_t begin = 0; begin < rows.size(); begin += batch_rows) {
+        size_t end = std::min(rows.size(), begin + batch_rows);
+        auto columns = rowsToArrowColumns(schema, rows, begin, end);
+        writeRecordBatch(out, columns, static_cast<int64_t>(end - begin));
+    }
+
+    // End-of-stream marker: a continuation followed by a zero length
+    uint32_t end_of_stream[2] = {kContinuation, 0};
+    out.append(reinterpret_cast<const char*>(end_of_stream), sizeof(end_of_stream));
+    return out;
+}
+
+} // namespace sqlengine
@@ -1,4 +1,5 @@
 #include "ast.h"
+#include <sstream>
 
 namespace sqlengine {
 
@@ -18,6 +19,10 @@ void UnaryExpression::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
+void AggregateExpression::accept(ASTVisitor& visitor) {
+    visitor.visit(*this);
+}
+
 void SelectStatement::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
@@ -34,4 +39,179 @@ void DropTableStatement::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
+void CreateMaterializedViewStatement::accept(ASTVisitor& visitor) {
+    visitor.visit(*this);
+}
+
+void DropMaterializedViewStatement::accept(ASTVisitor& visitor) {
+    visitor.visit(*this);
+}
+
+void CopyStatement::accept(ASTVisitor& visitor) {
+    visitor.visit(*this);
+}
+
+const char* aggregateFunctionName(AggregateExpression::Function function) {
+    switch (function) {
+        case AggregateExpression::Function::COUNT: return "COUNT";
+        case AggregateExpression::Function::SUM: return "SUM";
+        case AggregateExpression::Function::MIN: return "MIN";
+        case AggregateExpression::Function::MAX: return "MAX";
+        case AggregateExpression::Function::AVG: return "AVG";
+    }
+    return "?";
+}
+
+namespace {
+
+const char* operatorSymbol(BinaryExpression::Operator op) {
+    switch (op) {
+        case BinaryExpression::Operator::ADD: return "+";
+        case BinaryExpression::Operator::SUBTRACT: return "-";
+        case BinaryExpression::Operator::MULTIPLY: return "*";
+        case BinaryExpression::Operator::DIVIDE: return "/";
+        case BinaryExpression::Operator::EQUAL: return "=";
+        case BinaryExpression::Operator::NOT_EQUAL: return "<>";
+        case BinaryExpression::Operator::LESS_THAN: return "<";
+        case BinaryExpression::Operator::LESS_EQUAL: return "<=";
+        case BinaryExpression::Operator::GREATER_THAN: return ">";
+        case BinaryExpression::Operator::GREATER_EQUAL: return ">=";
+        case BinaryExpression::Operator::AND: return "AND";
+        case BinaryExpression::Operator::OR: return "OR";
+    }
+    return "?";
+}
+
+// Visitor that renders expressions and summarizes statements as text
+class PlanPrinter : public ASTVisitor {
+public:
+    std::ostringstream out;
+    
+    void visit(LiteralExpression& node) override {
+        if (node.value.getType() == DataType::TEXT) {
+            out << "'" << node.value.toString() << "'";
+        } else {
+            out << node.value.toString();
+        }
+    }
+    
+    void visit(ColumnExpression& node) override {
+        if (!node.table_name.empty()) {
+            out << node.table_name << ".";
+        }
+        out << node.column_name;
+    }
+    
+    void visit(BinaryExpression& node) override {
+        out << "(";
+        node.left->accept(*this);
+        out << " " << operatorSymbol(node.op) << " ";
+        node.right->accept(*this);
+        out << ")";
+    }
+    
+    void visit(UnaryExpression& node) override {
+        out << (node.op == UnaryExpression::Operator::NOT ? "NOT " : "-");
+        node.operand->accept(*this);
+    }
+    
+    void visit(AggregateExpression& node) override {
+        out << aggregateFunctionName(node.function) << "(";
+        if (node.argument) {
+            node.argument->accept(*this);
+        } else {
+            out << "*";
+        }
+        out << ")";
+    }
+    
+    void visit(SelectStatement& node) override {
+        out << "Scan(" << node.from_table << ")";
+        for (auto& join : node.joins) {
+            out << " -> HashJoin(" << join.table << " ON ";
+            join.condition->accept(*this);
+            out << ")";
+        }
+        if (node.where_clause) {
+            out << " -> Filter(";
+            node.where_clause->accept(*this);
+            out << ")";
+        }
+        if (!node.group_by.empty()) {
+            out << " -> HashAggregate(";
+            for (size_t i = 0; i < node.group_by.size(); ++i) {
+                if (i > 0) out << ", ";
+                node.group_by[i]->accept(*this);
+            }
+            out << ")";
+        }
+        if (node.having) {
+            out << " -> Filter(";
+            node.having->accept(*this);
+            out << ")";
+        }
+        if (!node.order_by.empty()) {
+            out << " -> Sort(";
+            for (size_t i = 0; i < node.order_by.size(); ++i) {
+                const auto& item = node.order_by[i];
+                if (i > 0) out << ", ";
+                if (!item.table.empty()) out << item.table << ".";
+                out << item.column << (item.descending ? " DESC" : "");
+                if (item.nulls_first != item.descending) {
+                    out << (item.nulls_first ? " NULLS FIRST" : " NULLS LAST");
+                }
+            }
+            out << ")";
+        }
+        if (node.limit >= 0) {
+            out << " -> Limit(" << node.limit << ")";
+        }
+        out << " -> Project(";
+        for (size_t i = 0; i < node.select_list.size(); ++i) {
+            if (i > 0) out << ", ";
+            node.select_list[i]->accept(*this);
+        }
+        out << ")";
+    }
+    
+    void visit(InsertStatement& node) override {
+        out << "Insert(" << node.table_name << ", rows=" << node.values.size() << ")";
+    }
+    
+    void visit(CreateTableStatement& node) override {
+        out << (node.source_path.empty() ? "CreateTable(" : "CreateExternalTable(") << node.table_name << ")";
+    }
+    
+    void visit(DropTableStatement& node) override {
+        out << "DropTable(" << node.table_name << ")";
+    }
+    
+    void visit(CreateMaterializedViewStatement& node) override {
+        out << "CreateMaterializedView(" << node.view_name << ")";
+    }
+    
+    void visit(DropMaterializedViewStatement& node) override {
+        out << "DropMaterializedView(" << node.view_name << ")";
+    }
+    
+    void visit(CopyStatement& node) override {
+        out << (node.to_file ? "CopyTo(" : "CopyFrom(") << node.table_name << ", "
+            << (node.format == CopyStatement::Format::CSV ? "csv" : "columnar") << ")";
+    }
+};
+
+} // namespace
+
+std::string expressionToString(Expression& expr) {
+    PlanPrinter printer;
+    expr.accept(printer);
+    return printer.out.str();
+}
+
+std::string describePlan(Statement& statement) {
+    PlanPrinter printer;
+    statement.accept(printer);
+    return printer.out.str();
+}
+
 } // namespace sqlengine
\ No newline at end of file
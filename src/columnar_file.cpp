@@ -0,0 +1,641 @@
+#include "columnar_file.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace sqlengine {
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'Q', 'L', 'C', 'O', 'L', '1', '\0'};
+
+// Dictionaries larger than this, or with more entries than half the
+// chunk's values, are not considered
+constexpr size_t kMaxDictionaryEntries = 64 * 1024;
+
+enum class PageKind : uint8_t { DICTIONARY = 0, DATA = 1 };
+enum class Encoding : uint8_t { PLAIN = 0, RLE = 1, DICTIONARY = 2 };
+
+[[noreturn]] void corrupt(const std::string& path, const std::string& what) {
+    throw std::runtime_error("Corrupt columnar file " + path + ": " + what);
+}
+
+class ByteWriter {
+public:
+    explicit ByteWriter(std::string& out) : out_(out) {}
+
+    void u8(uint8_t value) { out_.push_back(static_cast<char>(value)); }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void fixed(const void* data, size_t size) { out_.append(static_cast<const char*>(data), size); }
+
+    void string(const std::string& value) {
+        varint(value.size());
+        out_.append(value);
+    }
+
+    // Value of a known type: zigzag varint for INTEGER, 8 bytes for REAL,
+    // one byte for BOOLEAN and length-prefixed bytes for TEXT
+    void plain(DataType type, const Value& value) {
+        switch (type) {
+            case DataType::INTEGER: {
+                int64_t v = value.get<int64_t>();
+                varint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+                break;
+            }
+            case DataType::REAL: {
+                double v = value.get<double>();
+                fixed(&v, sizeof(v));
+                break;
+            }
+            case DataType::BOOLEAN:
+                u8(value.get<bool>() ? 1 : 0);
+                break;
+            case DataType::TEXT:
+                string(value.get<std::string>());
+                break;
+            case DataType::NULL_TYPE:
+                break;
+        }
+    }
+
+private:
+    std::string& out_;
+};
+
+class ByteReader {
+public:
+    ByteReader(const char* data, size_t size, const std::string& path)
+        : p_(data), end_(data + size), path_(&path) {}
+
+    bool atEnd() const { return p_ == end_; }
+
+    uint8_t u8() {
+        need(1);
+        return static_cast<uint8_t>(*p_++);
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = u8();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        corrupt(*path_, "bad varint");
+    }
+
+    void fixed(void* data, size_t size) {
+        need(size);
+        std::memcpy(data, p_, size);
+        p_ += size;
+    }
+
+    std::string string() {
+        uint64_t size = varint();
+        need(size);
+        std::string value(p_, size);
+        p_ += size;
+        return value;
+    }
+
+    Value plain(DataType type) {
+        switch (type) {
+            case DataType::INTEGER: {
+                uint64_t v = varint();
+                return Value(static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1)));
+            }
+            case DataType::REAL: {
+                double v;
+                fixed(&v, sizeof(v));
+                return Value(v);
+            }
+            case DataType::BOOLEAN:
+                return Value(u8() != 0);
+            case DataType::TEXT:
+                return Value(string());
+            case DataType::NULL_TYPE:
+                break;
+        }
+        corrupt(*path_, "bad column type");
+    }
+
+    // Reader over the next size bytes
+    ByteReader sub(uint64_t size) {
+        need(size);
+        ByteReader reader(p_, size, *path_);
+        p_ += size;
+        return reader;
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+    const std::string* path_;
+
+    void need(uint64_t size) const {
+        if (size > static_cast<uint64_t>(end_ - p_)) corrupt(*path_, "truncated data");
+    }
+};
+
+bool validType(uint8_t type) {
+    return type <= static_cast<uint8_t>(DataType::BOOLEAN);
+}
+
+void writePage(std::string& chunk, PageKind kind, Encoding encoding, const std::string& body) {
+    ByteWriter writer(chunk);
+    writer.u8(static_cast<uint8_t>(kind));
+    writer.u8(static_cast<uint8_t>(encoding));
+    writer.varint(body.size());
+    chunk.append(body);
+}
+
+// Encodes rows [begin, end) of one column as a chunk and fills in its
+// NULL count and statistics
+std::string encodeChunk(const std::vector<Row>& rows, size_t begin, size_t end, size_t column,
+                        DataType type, ColumnChunkInfo& info) {
+    std::vector<const Value*> values;
+    const Value* min = nullptr;
+    const Value* max = nullptr;
+    bool has_nan = false;
+    std::vector<uint64_t> null_runs; // alternating non-NULL and NULL run lengths
+    bool in_nulls = false;
+    uint64_t run = 0;
+    for (size_t i = begin; i < end; ++i) {
+        const Value& value = rows[i][column];
+        if (value.isNull() != in_nulls) {
+            null_runs.push_back(run);
+            in_nulls = !in_nulls;
+            run = 0;
+        }
+        ++run;
+        if (value.isNull()) {
+            ++info.null_count;
+            continue;
+        }
+        if (value.getType() != type) {
+            throw std::runtime_error("Value " + value.toString() + " does not match its column type");
+        }
+        values.push_back(&value);
+        if (type == DataType::REAL && std::isnan(value.get<double>())) {
+            has_nan = true;
+            continue;
+        }
+        if (!min || value < *min) min = &value;
+        if (!max || *max < value) max = &value;
+    }
+    null_runs.push_back(run);
+    if (has_nan) {
+        // NaN passes some comparisons no min/max can rule out
+        info.has_stats = false;
+    } else if (min) {
+        info.min = *min;
+        info.max = *max;
+    }
+
+    std::string header;
+    ByteWriter head(header);
+    head.varint(end - begin);
+    head.varint(info.null_count);
+    if (info.null_count > 0) {
+        head.varint(null_runs.size());
+        for (uint64_t length : null_runs) {
+            head.varint(length);
+        }
+    }
+
+    // PLAIN
+    std::string best;
+    ByteWriter plain(best);
+    for (const Value* value : values) {
+        plain.plain(type, *value);
+    }
+    Encoding best_encoding = Encoding::PLAIN;
+
+    // RLE: runs of equal values
+    std::string rle;
+    ByteWriter rle_writer(rle);
+    std::vector<std::pair<uint64_t, const Value*>> runs;
+    for (const Value* value : values) {
+        if (!runs.empty() && *runs.back().second == *value) {
+            ++runs.back().first;
+        } else {
+            runs.emplace_back(1, value);
+        }
+    }
+    rle_writer.varint(runs.size());
+    for (const auto& [length, value] : runs) {
+        rle_writer.varint(length);
+        rle_writer.plain(type, *value);
+    }
+    if (rle.size() < best.size()) {
+        best.swap(rle);
+        best_encoding = Encoding::RLE;
+    }
+
+    // DICTIONARY: runs of indices into the distinct values
+    std::string dictionary;
+    size_t dictionary_limit = std::min(kMaxDictionaryEntries, values.size() / 2);
+    if (type != DataType::BOOLEAN && dictionary_limit > 0) {
+        std::unordered_map<std::string, uint64_t> index;
+        std::vector<const Value*> entries;
+        std::vector<std::pair<uint64_t, uint64_t>> index_runs;
+        std::string key;
+        for (const auto& [length, value] : runs) {
+            key.clear();
+            ByteWriter(key).plain(type, *value);
+            auto [it, inserted] = index.emplace(key, entries.size());
+            if (inserted) {
+                if (entries.size() == dictionary_limit) break;
+                entries.push_back(value);
+            }
+            if (!index_runs.empty() && index_runs.back().second == it->second) {
+                index_runs.back().first += length;
+            } else {
+                index_runs.emplace_back(length, it->second);
+            }
+        }
+        if (index.size() <= dictionary_limit) {
+            std::string dictionary_body;
+            ByteWriter dictionary_writer(dictionary_body);
+            dictionary_writer.varint(entries.size());
+            for (const Value* entry : entries) {
+                dictionary_writer.plain(type, *entry);
+            }
+            std::string indices;
+            ByteWriter index_writer(indices);
+            index_writer.varint(index_runs.size());
+            for (const auto& [length, entry] : index_runs) {
+                index_writer.varint(length);
+                index_writer.varint(entry);
+            }
+            if (dictionary_body.size() + indices.size() < best.size()) {
+                writePage(dictionary, PageKind::DICTIONARY, Encoding::PLAIN, dictionary_body);
+                best.swap(indices);
+                best_encoding = Encoding::DICTIONARY;
+            }
+        }
+    }
+
+    std::string chunk = best_encoding == Encoding::DICTIONARY ? dictionary : std::string();
+    writePage(chunk, PageKind::DATA, best_encoding, header + best);
+    return chunk;
+}
+
+// Values of a chunk, one per row of the row group
+std::vector<Value> decodeChunk(const std::string& bytes, DataType type, uint64_t rows, const std::string& path) {
+    ByteReader reader(bytes.data(), bytes.size(), path);
+    std::vector<Value> dictionary;
+    auto kind = static_cast<PageKind>(reader.u8());
+    auto encoding = static_cast<Encoding>(reader.u8());
+    ByteReader page = reader.sub(reader.varint());
+    if (kind == PageKind::DICTIONARY) {
+        for (uint64_t n = page.varint(); n > 0; --n) {
+            dictionary.push_back(page.plain(type));
+        }
+        kind = static_cast<PageKind>(reader.u8());
+        encoding = static_cast<Encoding>(reader.u8());
+        page = reader.sub(reader.varint());
+    }
+    if (kind != PageKind::DATA || page.varint() != rows) {
+        corrupt(path, "bad data page");
+    }
+
+    uint64_t null_count = page.varint();
+    if (null_count > rows) {
+        corrupt(path, "bad NULL count");
+    }
+    std::vector<uint64_t> null_runs{rows};
+    if (null_count > 0) {
+        null_runs.resize(page.varint());
+        for (auto& length : null_runs) {
+            length = page.varint();
+        }
+    }
+
+    std::vector<Value> values;
+    values.reserve(rows - null_count);
+    switch (encoding) {
+        case Encoding::PLAIN:
+            while (values.size() < rows - null_count) {
+                values.push_back(page.plain(type));
+            }
+            break;
+        case Encoding::RLE:
+        case Encoding::DICTIONARY:
+            for (uint64_t n = page.varint(); n > 0; --n) {
+                uint64_t length = page.varint();
+                Value value;
+                if (encoding == Encoding::RLE) {
+                    value = page.plain(type);
+                } else {
+                    uint64_t entry = page.varint();
+                    if (entry >= dictionary.size()) corrupt(path, "bad dictionary index");
+                    value = dictionary[entry];
+                }
+                if (length > rows - null_count - values.size()) corrupt(path, "bad run length");
+                values.insert(values.end(), length, value);
+            }
+            break;
+        default:
+            corrupt(path, "unknown encoding");
+    }
+    if (values.size() != rows - null_count) {
+        corrupt(path, "value count does not match");
+    }
+
+    // Spread the values over the non-NULL runs
+    std::vector<Value> column;
+    column.reserve(rows);
+    size_t next = 0;
+    bool nulls = false;
+    for (uint64_t length : null_runs) {
+        if (length > rows - column.size() || (!nulls && length > values.size() - next)) {
+            corrupt(path, "bad NULL runs");
+        }
+        for (uint64_t i = 0; i < length; ++i) {
+            column.push_back(nulls ? Value() : std::move(values[next++]));
+        }
+        nulls = !nulls;
+    }
+    if (column.size() != rows) {
+        corrupt(path, "bad NULL runs");
+    }
+    return column;
+}
+
+// Orders a column value against a filter value; false if they cannot be
+// compared (e.g. TEXT against INTEGER, or NaN)
+bool compareValues(const Value& a, const Value& b, int& result) {
+    DataType ta = a.getType();
+    DataType tb = b.getType();
+    if ((ta == DataType::REAL && std::isnan(a.get<double>())) ||
+        (tb == DataType::REAL && std::isnan(b.get<double>()))) {
+        return false;
+    }
+    if (ta == tb) {
+        result = a < b ? -1 : (b < a ? 1 : 0);
+        return true;
+    }
+    auto numeric = [](DataType t) { return t == DataType::INTEGER || t == DataType::REAL; };
+    if (!numeric(ta) || !numeric(tb)) {
+        return false;
+    }
+    double da = ta == DataType::INTEGER ? static_cast<double>(a.get<int64_t>()) : a.get<double>();
+    double db = tb == DataType::INTEGER ? static_cast<double>(b.get<int64_t>()) : b.get<double>();
+    result = da < db ? -1 : (db < da ? 1 : 0);
+    return true;
+}
+
+} // namespace
+
+void writeColumnarFile(const std::string& path, const Schema& schema, const std::vector<Row>& rows,
+                       size_t row_group_rows) {
+    // A unique name next to the target, so that concurrent writers of the
+    // same path never share a temporary file and the rename stays within
+    // one file system
+    std::vector<char> temp_buffer(path.begin(), path.end());
+    const char suffix[] = ".XXXXXX";
+    temp_buffer.insert(temp_buffer.end(), suffix, suffix + sizeof(suffix));
+    int fd = ::mkstemp(temp_buffer.data());
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create a temporary file for " + path + ": " + std::strerror(errno));
+    }
+    std::string temp_path(temp_buffer.data());
+    // mkstemp creates the file private to its owner
+    ::fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    ::close(fd);
+
+    try {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Cannot create " + temp_path + ": " + std::strerror(errno));
+        }
+        uint64_t offset = sizeof(kMagic);
+        out.write(kMagic, sizeof(kMagic));
+        std::vector<RowGroupInfo> row_groups;
+        for (size_t begin = 0; begin < rows.size(); begin += row_group_rows) {
+            size_t end = std::min(rows.size(), begin + row_group_rows);
+            RowGroupInfo group;
+            group.rows = end - begin;
+            group.columns.resize(schema.getColumnCount());
+            for (size_t c = 0; c < schema.getColumnCount(); ++c) {
+                auto& info = group.columns[c];
+                std::string chunk = encodeChunk(rows, begin, end, c, schema.getColumn(c).type, info);
+                info.offset = offset;
+                info.size = chunk.size();
+                out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+                offset += chunk.size();
+            }
+            row_groups.push_back(std::move(group));
+        }
+
+        std::string footer;
+        ByteWriter writer(footer);
+        writer.varint(schema.getColumnCount());
+        for (const auto& column : schema.getColumns()) {
+            writer.string(column.name);
+            writer.u8(static_cast<uint8_t>(column.type));
+            writer.u8(column.nullable ? 1 : 0);
+        }
+        writer.varint(row_groups.size());
+        for (const auto& group : row_groups) {
+            writer.varint(group.rows);
+            for (size_t c = 0; c < group.columns.size(); ++c) {
+                const auto& info = group.columns[c];
+                writer.varint(info.offset);
+                writer.varint(info.size);
+                writer.varint(info.null_count);
+                writer.u8(!info.has_stats ? 2 : info.min.isNull() ? 0 : 1);
+                if (!info.min.isNull()) {
+                    writer.plain(schema.getColumn(c).type, info.min);
+                    writer.plain(schema.getColumn(c).type, info.max);
+                }
+            }
+        }
+        uint32_t footer_length = static_cast<uint32_t>(footer.size());
+        out.write(footer.data(), static_cast<std::streamsize>(footer.size()));
+        out.write(reinterpret_cast<const char*>(&footer_length), sizeof(footer_length));
+        out.write(kMagic, sizeof(kMagic));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Cannot write " + temp_path + ": " + std::strerror(errno));
+        }
+        std::filesystem::rename(temp_path, path);
+    } catch (...) {
+        std::error_code ignored;
+        std::filesystem::remove(temp_path, ignored);
+        throw;
+    }
+}
+
+ColumnarFileReader::ColumnarFileReader(const std::string& path) : path_(path) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+    try {
+        readFooter();
+    } catch (...) {
+        ::close(fd_);
+        throw;
+    }
+}
+
+ColumnarFileReader::~ColumnarFileReader() {
+    ::close(fd_);
+}
+
+std::string ColumnarFileReader::readBytes(uint64_t offset, uint64_t size) const {
+    std::string bytes(size, '\0');
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd_, &bytes[done], size - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            throw std::runtime_error("Cannot read " + path_ + ": " + std::strerror(errno));
+        }
+        if (n == 0) corrupt(path_, "truncated file");
+        done += static_cast<size_t>(n);
+    }
+    return bytes;
+}
+
+void ColumnarFileReader::readFooter() {
+    struct stat info;
+    if (::fstat(fd_, &info) != 0) {
+        throw std::runtime_error("Cannot stat " + path_ + ": " + std::strerror(errno));
+    }
+    uint64_t file_size = static_cast<uint64_t>(info.st_size);
+    constexpr uint64_t kTrailerSize = sizeof(uint32_t) + sizeof(kMagic);
+    if (file_size < sizeof(kMagic) + kTrailerSize || readBytes(0, sizeof(kMagic)) != std::string(kMagic, 8)) {
+        corrupt(path_, "not a columnar file");
+    }
+    std::string trailer = readBytes(file_size - kTrailerSize, kTrailerSize);
+    if (trailer.compare(sizeof(uint32_t), sizeof(kMagic), kMagic, sizeof(kMagic)) != 0) {
+        corrupt(path_, "missing footer");
+    }
+    uint32_t footer_length;
+    std::memcpy(&footer_length, trailer.data(), sizeof(footer_length));
+    if (footer_length > file_size - sizeof(kMagic) - kTrailerSize) {
+        corrupt(path_, "bad footer length");
+    }
+    uint64_t data_end = file_size - kTrailerSize - footer_length;
+    std::string footer = readBytes(data_end, footer_length);
+    ByteReader reader(footer.data(), footer.size(), path_);
+
+    for (uint64_t n = reader.varint(); n > 0; --n) {
+        std::string name = reader.string();
+        uint8_t type = reader.u8();
+        bool nullable = reader.u8() != 0;
+        if (!validType(type)) corrupt(path_, "bad column type");
+        schema_.addColumn(Column(name, static_cast<DataType>(type), nullable));
+    }
+    for (uint64_t n = reader.varint(); n > 0; --n) {
+        RowGroupInfo group;
+        group.rows = reader.varint();
+        group.columns.resize(schema_.getColumnCount());
+        for (size_t c = 0; c < group.columns.size(); ++c) {
+            auto& chunk = group.columns[c];
+            chunk.offset = reader.varint();
+            chunk.size = reader.varint();
+            chunk.null_count = reader.varint();
+            if (chunk.offset < sizeof(kMagic) || chunk.offset > data_end || chunk.size > data_end - chunk.offset) {
+                corrupt(path_, "bad chunk location");
+            }
+            uint8_t stats = reader.u8();
+            if (stats == 1) {
+                chunk.min = reader.plain(schema_.getColumn(c).type);
+                chunk.max = reader.plain(schema_.getColumn(c).type);
+            } else if (stats == 2) {
+                chunk.has_stats = false;
+            } else if (stats != 0) {
+                corrupt(path_, "bad chunk statistics");
+            }
+        }
+        row_groups_.push_back(std::move(group));
+    }
+}
+
+uint64_t ColumnarFileReader::getRowCount() const {
+    uint64_t rows = 0;
+    for (const auto& group : row_groups_) {
+        rows += group.rows;
+    }
+    return rows;
+}
+
+bool ColumnarFileReader::canSkip(size_t row_group, const std::vector<ScanFilter>& filters) const {
+    const auto& group = row_groups_.at(row_group);
+    for (const auto& filter : filters) {
+        const auto& chunk = group.columns.at(filter.column);
+        if (!chunk.has_stats) {
+            continue;
+        }
+        if (chunk.min.isNull()) {
+            return true; // only NULLs, which never pass a comparison
+        }
+        int vs_min;
+        int vs_max;
+        if (!compareValues(chunk.min, filter.value, vs_min) || !compareValues(chunk.max, filter.value, vs_max)) {
+            continue;
+        }
+        bool skip = false;
+        switch (filter.op) {
+            case ScanFilter::Op::EQUAL: skip = vs_min > 0 || vs_max < 0; break;
+            case ScanFilter::Op::NOT_EQUAL: skip = vs_min == 0 && vs_max == 0; break;
+            case ScanFilter::Op::LESS_THAN: skip = vs_min >= 0; break;
+            case ScanFilter::Op::LESS_EQUAL: skip = vs_min > 0; break;
+            case ScanFilter::Op::GREATER_THAN: skip = vs_max <= 0; break;
+            case ScanFilter::Op::GREATER_EQUAL: skip = vs_max < 0; break;
+        }
+        if (skip) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ColumnarFileReader::readRowGroup(size_t row_group, const std::vector<bool>& columns,
+                                      std::vector<Row>& rows) const {
+    const auto& group = row_groups_.at(row_group);
+    size_t first = rows.size();
+    rows.resize(first + group.rows, Row(schema_.getColumnCount()));
+    for (size_t c = 0; c < schema_.getColumnCount(); ++c) {
+        if (!columns.empty() && (c >= columns.size() || !columns[c])) {
+            continue;
+        }
+        const auto& chunk = group.columns[c];
+        auto values = decodeChunk(readBytes(chunk.offset, chunk.size), schema_.getColumn(c).type, group.rows, path_);
+        for (size_t i = 0; i < values.size(); ++i) {
+            rows[first + i][c] = std::move(values[i]);
+        }
+    }
+}
+
+std::vector<Row> ColumnarFileReader::scan(const ScanRequest& request) const {
+    std::vector<Row> rows;
+    for (size_t group = 0; group < row_groups_.size(); ++group) {
+        if (!canSkip(group, request.filters)) {
+            readRowGroup(group, request.columns, rows);
+        }
+    }
+    return rows;
+}
+
+} // namespace sqlengine
@@ -0,0 +1,391 @@
+#include "csv_import.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sqlengine {
+
+namespace {
+
+// Chunks are at least this large, and each thread gets a few of them so
+// that uneven chunks balance out
+constexpr size_t kMinChunkBytes = 1 << 20;
+constexpr size_t kChunksPerThread = 4;
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat info;
+        if (::fstat(fd_, &info) != 0) {
+            int error = errno;
+            ::close(fd_);
+            throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(error));
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ == 0) {
+            return;
+        }
+        void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (data == MAP_FAILED) {
+            int error = errno;
+            ::close(fd_);
+            throw std::runtime_error("Cannot map " + path + ": " + std::strerror(error));
+        }
+        ::madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(data);
+    }
+
+    ~MappedFile() {
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+        ::close(fd_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+
+private:
+    int fd_ = -1;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Runs fn(0) ... fn(count - 1) on up to threads threads
+template<typename Fn>
+void parallelFor(size_t count, unsigned threads, Fn fn) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            fn(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < std::min<size_t>(threads, count); ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+// First delimiter, quote, CR or LF in [p, end), 16 bytes per step with SSE2
+const char* findSpecial(const char* p, const char* end, char delimiter) {
+#ifdef __SSE2__
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    const __m128i quotes = _mm_set1_epi8('"');
+    const __m128i line_feeds = _mm_set1_epi8('\n');
+    const __m128i returns = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, delimiters), _mm_cmpeq_epi8(bytes, quotes)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(bytes, line_feeds), _mm_cmpeq_epi8(bytes, returns)));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return p + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != delimiter && *p != '"' && *p != '\n' && *p != '\r') {
+        ++p;
+    }
+    return p;
+}
+
+size_t countQuotes(const char* p, const char* end) {
+    size_t count = 0;
+#ifdef __SSE2__
+    const __m128i quotes = _mm_set1_epi8('"');
+    while (end - p >= 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        count += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quotes))));
+        p += 16;
+    }
+#endif
+    for (; p < end; ++p) {
+        count += *p == '"';
+    }
+    return count;
+}
+
+// Start of the record after the first line end outside quotes, given
+// whether p is inside a quoted field ("" escapes toggle twice)
+const char* nextRecordStart(const char* p, const char* end, bool in_quotes) {
+    for (; p < end; ++p) {
+        if (*p == '"') {
+            in_quotes = !in_quotes;
+        } else if (*p == '\n' && !in_quotes) {
+            return p + 1;
+        }
+    }
+    return end;
+}
+
+// A malformed record, numbered within its chunk
+struct RecordError {
+    uint64_t record;
+    std::string message;
+};
+
+struct ChunkResult {
+    std::vector<Row> rows;
+    uint64_t records = 0;
+    bool has_error = false;
+    RecordError error;
+    std::exception_ptr failure; // the query was interrupted
+};
+
+class ChunkParser {
+public:
+    ChunkParser(const Schema& schema, char delimiter, const QueryControl* control)
+        : schema_(schema), delimiter_(delimiter), control_(control) {}
+
+    // Parses the records in [p, end); stops at the first bad one, or when
+    // stop() returns true
+    template<typename StopFn>
+    void parse(const char* p, const char* end, ChunkResult& result, StopFn stop) {
+        while (p < end) {
+            if (*p == '\n' || *p == '\r') {
+                p = skipLineEnd(p, end); // blank line
+                continue;
+            }
+            if (result.records % QueryControl::kCheckInterval == 0) {
+                if (control_) control_->checkInterrupt();
+                if (stop()) return;
+            }
+            ++result.records;
+            try {
+                Row row;
+                row.reserve(schema_.getColumnCount());
+                p = parseRecord(p, end, row);
+                result.rows.push_back(std::move(row));
+            } catch (const std::runtime_error& e) {
+                result.has_error = true;
+                result.error = {result.records, e.what()};
+                return;
+            }
+        }
+    }
+
+private:
+    const Schema& schema_;
+    char delimiter_;
+    const QueryControl* control_;
+    std::string unescaped_;
+
+    static const char* skipLineEnd(const char* p, const char* end) {
+        if (*p == '\r') ++p;
+        if (p < end && *p == '\n') ++p;
+        return p;
+    }
+
+    const char* parseRecord(const char* p, const char* end, Row& row) {
+        while (true) {
+            const char* field_end;
+            if (p < end && *p == '"') {
+                field_end = parseQuoted(p + 1, end);
+                addField(unescaped_.data(), unescaped_.size(), true, row);
+                if (field_end < end && *field_end != delimiter_ && *field_end != '\n' && *field_end != '\r') {
+                    throw std::runtime_error("unexpected character after quoted field");
+                }
+            } else {
+                // Chunks are split by quote parity, so quotes are only
+                // allowed around whole fields
+                field_end = findSpecial(p, end, delimiter_);
+                if (field_end < end && *field_end == '"') {
+                    throw std::runtime_error("quote inside unquoted field");
+                }
+                addField(p, static_cast<size_t>(field_end - p), false, row);
+            }
+
+            if (field_end == end) {
+                p = end;
+                break;
+            }
+            if (*field_end == delimiter_) {
+                p = field_end + 1;
+                continue;
+            }
+            p = skipLineEnd(field_end, end);
+            break;
+        }
+        if (row.size() != schema_.getColumnCount()) {
+            throw std::runtime_error("expected " + std::to_string(schema_.getColumnCount()) + " fields, found " +
+                                     std::to_string(row.size()));
+        }
+        return p;
+    }
+
+    // Collects the contents of a quoted field starting after its opening
+    // quote; returns the position after the closing quote
+    const char* parseQuoted(const char* p, const char* end) {
+        unescaped_.clear();
+        while (true) {
+            auto quote = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(end - p)));
+            if (!quote) {
+                throw std::runtime_error("unterminated quoted field");
+            }
+            unescaped_.append(p, quote);
+            if (quote + 1 < end && quote[1] == '"') {
+                unescaped_.push_back('"');
+                p = quote + 2;
+            } else {
+                return quote + 1;
+            }
+        }
+    }
+
+    void addField(const char* data, size_t size, bool quoted, Row& row) {
+        size_t index = row.size();
+        if (index >= schema_.getColumnCount()) {
+            throw std::runtime_error("more than " + std::to_string(schema_.getColumnCount()) + " fields");
+        }
+        const Column& column = schema_.getColumn(index);
+        if (size == 0 && !quoted) {
+            if (!column.nullable) {
+                throw std::runtime_error("NULL value for NOT NULL column " + column.name);
+            }
+            row.emplace_back();
+            return;
+        }
+        row.push_back(convert(data, size, column));
+    }
+
+    static Value convert(const char* data, size_t size, const Column& column) {
+        const char* end = data + size;
+        switch (column.type) {
+            case DataType::INTEGER: {
+                int64_t value;
+                auto parsed = std::from_chars(data, end, value);
+                if (parsed.ec == std::errc() && parsed.ptr == end) return Value(value);
+                break;
+            }
+            case DataType::REAL: {
+                double value;
+                auto parsed = std::from_chars(data, end, value);
+                if (parsed.ec == std::errc() && parsed.ptr == end) return Value(value);
+                break;
+            }
+            case DataType::BOOLEAN: {
+                std::string text(data, size);
+                std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+                if (text == "true" || text == "t" || text == "1") return Value(true);
+                if (text == "false" || text == "f" || text == "0") return Value(false);
+                break;
+            }
+            case DataType::TEXT:
+                return Value(std::string(data, size));
+            case DataType::NULL_TYPE:
+                break;
+        }
+        const char* type_names[] = {"INTEGER", "REAL", "TEXT", "BOOLEAN", "NULL"};
+        throw std::runtime_error("invalid " + std::string(type_names[static_cast<int>(column.type)]) + " value '" +
+                                 std::string(data, size) + "' for column " + column.name);
+    }
+};
+
+} // namespace
+
+uint64_t copyCsvIntoTable(Table& table, const std::string& path, const CsvOptions& options,
+                          const QueryControl* control) {
+    if (options.delimiter == '"' || options.delimiter == '\n' || options.delimiter == '\r') {
+        throw std::runtime_error("Invalid CSV delimiter");
+    }
+    MappedFile file(path);
+    const char* begin = file.begin();
+    const char* end = file.end();
+    if (options.header && begin) {
+        begin = nextRecordStart(begin, end, false);
+    }
+    size_t size = static_cast<size_t>(end - begin);
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    size_t chunk_count = std::max<size_t>(1, std::min<size_t>(threads * kChunksPerThread, size / kMinChunkBytes));
+
+    // Chunks start at the first record boundary after an even split. Whether
+    // a split point lies inside a quoted field follows from the parity of
+    // the quotes before it, which are counted in parallel.
+    std::vector<const char*> splits(chunk_count + 1);
+    for (size_t i = 0; i <= chunk_count; ++i) {
+        splits[i] = begin + size * i / chunk_count;
+    }
+    std::vector<size_t> quotes(chunk_count);
+    parallelFor(chunk_count, threads, [&](size_t i) { quotes[i] = countQuotes(splits[i], splits[i + 1]); });
+    std::vector<const char*> starts(chunk_count + 1);
+    starts[0] = begin;
+    starts[chunk_count] = end;
+    size_t quotes_before = 0;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        quotes_before += quotes[i - 1];
+        starts[i] = std::max(starts[i - 1], nextRecordStart(splits[i], end, quotes_before % 2 == 1));
+    }
+
+    // A chunk stops early once an earlier chunk has failed, so the chunks
+    // before the first failure are always parsed completely
+    const Schema& schema = table.getSchema();
+    std::vector<ChunkResult> results(chunk_count);
+    std::atomic<size_t> first_failed{chunk_count};
+    parallelFor(chunk_count, threads, [&](size_t i) {
+        ChunkParser parser(schema, options.delimiter, control);
+        auto stop = [&]() { return first_failed.load(std::memory_order_relaxed) < i; };
+        try {
+            parser.parse(starts[i], starts[i + 1], results[i], stop);
+        } catch (...) {
+            results[i].failure = std::current_exception();
+        }
+        if (results[i].has_error || results[i].failure) {
+            size_t failed = first_failed.load();
+            while (i < failed && !first_failed.compare_exchange_weak(failed, i)) {
+            }
+        }
+    });
+
+    uint64_t record_base = options.header ? 1 : 0;
+    size_t row_count = 0;
+    for (auto& result : results) {
+        if (result.failure) {
+            std::rethrow_exception(result.failure);
+        }
+        if (result.has_error) {
+            throw std::runtime_error("CSV record " + std::to_string(record_base + result.error.record) + " of " +
+                                     path + ": " + result.error.message);
+        }
+        record_base += result.records;
+        row_count += result.rows.size();
+    }
+
+    std::vector<Row> rows;
+    rows.reserve(row_count);
+    for (auto& result : results) {
+        std::move(result.rows.begin(), result.rows.end(), std::back_inserter(rows));
+        result.rows = std::vector<Row>();
+    }
+    table.insertRows(std::move(rows));
+    return row_count;
+}
+
+} // namespace sqlengine
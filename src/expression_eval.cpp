@@ -0,0 +1,176 @@
+#include "expression_eval.h"
+#include <cstdint>
+#include <stdexcept>
+
+namespace sqlengine {
+
+namespace {
+
+bool isNumeric(const Value& value) {
+    return value.getType() == DataType::INTEGER || value.getType() == DataType::REAL;
+}
+
+double toDouble(const Value& value) {
+    return value.getType() == DataType::INTEGER
+        ? static_cast<double>(value.get<int64_t>())
+        : value.get<double>();
+}
+
+Value evaluateArithmetic(BinaryExpression::Operator op, const Value& left, const Value& right) {
+    if (!isNumeric(left) || !isNumeric(right)) {
+        throw std::runtime_error("Arithmetic requires numeric operands");
+    }
+    
+    if (left.getType() == DataType::INTEGER && right.getType() == DataType::INTEGER) {
+        // Same checks as the generated code (see sql_*_checked in the
+        // query runtime): a bad row fails the query, never the process
+        int64_t l = left.get<int64_t>();
+        int64_t r = right.get<int64_t>();
+        int64_t result = 0;
+        bool overflow = false;
+        switch (op) {
+            case BinaryExpression::Operator::ADD:
+                overflow = __builtin_add_overflow(l, r, &result);
+                break;
+            case BinaryExpression::Operator::SUBTRACT:
+                overflow = __builtin_sub_overflow(l, r, &result);
+                break;
+            case BinaryExpression::Operator::MULTIPLY:
+                overflow = __builtin_mul_overflow(l, r, &result);
+                break;
+            default:
+                if (r == 0) {
+                    throw std::runtime_error("Division by zero");
+                }
+                overflow = l == INT64_MIN && r == -1;
+                result = overflow ? 0 : l / r;
+                break;
+        }
+        if (overflow) {
+            throw std::runtime_error("Integer overflow");
+        }
+        return Value(result);
+    }
+    
+    double l = toDouble(left);
+    double r = toDouble(right);
+    switch (op) {
+        case BinaryExpression::Operator::ADD: return Value(l + r);
+        case BinaryExpression::Operator::SUBTRACT: return Value(l - r);
+        case BinaryExpression::Operator::MULTIPLY: return Value(l * r);
+        default: return Value(l / r);
+    }
+}
+
+Value evaluateComparison(BinaryExpression::Operator op, const Value& left, const Value& right) {
+    // Mixed INTEGER/REAL comparisons are done in floating point
+    if (left.getType() != right.getType()) {
+        if (!isNumeric(left) || !isNumeric(right)) {
+            throw std::runtime_error("Type mismatch in comparison");
+        }
+        return evaluateComparison(op, Value(toDouble(left)), Value(toDouble(right)));
+    }
+    
+    switch (op) {
+        case BinaryExpression::Operator::EQUAL: return Value(left == right);
+        case BinaryExpression::Operator::NOT_EQUAL: return Value(left != right);
+        case BinaryExpression::Operator::LESS_THAN: return Value(left < right);
+        case BinaryExpression::Operator::LESS_EQUAL: return Value(left <= right);
+        case BinaryExpression::Operator::GREATER_THAN: return Value(left > right);
+        default: return Value(left >= right);
+    }
+}
+
+// Three-valued AND/OR: FALSE AND NULL is FALSE and TRUE OR NULL is TRUE;
+// otherwise a NULL operand makes the result NULL
+Value evaluateLogical(BinaryExpression::Operator op, const Value& left, const Value& right) {
+    if ((!left.isNull() && left.getType() != DataType::BOOLEAN) ||
+        (!right.isNull() && right.getType() != DataType::BOOLEAN)) {
+        throw std::runtime_error("AND/OR require boolean operands");
+    }
+    bool deciding = op == BinaryExpression::Operator::OR;
+    if ((!left.isNull() && left.get<bool>() == deciding) || (!right.isNull() && right.get<bool>() == deciding)) {
+        return Value(deciding);
+    }
+    if (left.isNull() || right.isNull()) {
+        return Value();
+    }
+    return Value(!deciding);
+}
+
+} // namespace
+
+Value evaluateUnary(UnaryExpression::Operator op, const Value& operand) {
+    if (operand.isNull()) {
+        return operand;
+    }
+    
+    switch (op) {
+        case UnaryExpression::Operator::NOT:
+            if (operand.getType() != DataType::BOOLEAN) {
+                throw std::runtime_error("NOT requires a boolean operand");
+            }
+            return Value(!operand.get<bool>());
+        case UnaryExpression::Operator::MINUS:
+            if (operand.getType() == DataType::INTEGER) {
+                if (operand.get<int64_t>() == INT64_MIN) {
+                    throw std::runtime_error("Integer overflow");
+                }
+                return Value(-operand.get<int64_t>());
+            }
+            if (operand.getType() == DataType::REAL) {
+                return Value(-operand.get<double>());
+            }
+            throw std::runtime_error("Unary minus requires a numeric operand");
+    }
+    return Value();
+}
+
+Value evaluateBinary(BinaryExpression::Operator op, const Value& left, const Value& right) {
+    if (op == BinaryExpression::Operator::AND || op == BinaryExpression::Operator::OR) {
+        return evaluateLogical(op, left, right);
+    }
+    if (left.isNull() || right.isNull()) {
+        return Value();
+    }
+    
+    switch (op) {
+        case BinaryExpression::Operator::ADD:
+        case BinaryExpression::Operator::SUBTRACT:
+        case BinaryExpression::Operator::MULTIPLY:
+        case BinaryExpression::Operator::DIVIDE:
+            return evaluateArithmetic(op, left, right);
+        default:
+            return evaluateComparison(op, left, right);
+    }
+}
+
+void collectAggregates(Expression& expr, std::vector<AggregateExpression*>& aggregates, bool nested) {
+    if (auto aggregate = dynamic_cast<AggregateExpression*>(&expr)) {
+        if (nested) {
+            throw std::runtime_error("Aggregate functions cannot be nested");
+        }
+        aggregates.push_back(aggregate);
+        if (aggregate->argument) {
+            collectAggregates(*aggregate->argument, aggregates, true);
+        }
+    } else if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        collectAggregates(*unary->operand, aggregates, nested);
+    } else if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        collectAggregates(*binary->left, aggregates, nested);
+        collectAggregates(*binary->right, aggregates, nested);
+    }
+}
+
+AggregateKind aggregateKind(const AggregateExpression& aggregate) {
+    switch (aggregate.function) {
+        case AggregateExpression::Function::COUNT:
+            return aggregate.argument ? AggregateKind::COUNT : AggregateKind::COUNT_STAR;
+        case AggregateExpression::Function::SUM: return AggregateKind::SUM;
+        case AggregateExpression::Function::MIN: return AggregateKind::MIN;
+        case AggregateExpression::Function::MAX: return AggregateKind::MAX;
+        default: return AggregateKind::AVG;
+    }
+}
+
+} // namespace sqlengine
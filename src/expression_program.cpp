@@ -0,0 +1,360 @@
+#include "expression_program.h"
+#include "expression_eval.h"
+#include <stdexcept>
+
+namespace sqlengine {
+
+namespace {
+
+// Operands of a REAL instruction as doubles; false unless both are numeric
+// and at least one is REAL, in which case the generic operator runs
+bool realOperands(const Value& left, const Value& right, double& l, double& r) {
+    bool left_int = left.holds<int64_t>();
+    bool right_int = right.holds<int64_t>();
+    if ((!left_int && !left.holds<double>()) || (!right_int && !right.holds<double>()) ||
+        (left_int && right_int)) {
+        return false;
+    }
+    l = left_int ? static_cast<double>(left.get<int64_t>()) : left.get<double>();
+    r = right_int ? static_cast<double>(right.get<int64_t>()) : right.get<double>();
+    return true;
+}
+
+bool isNumeric(const std::optional<DataType>& type) {
+    return type == DataType::INTEGER || type == DataType::REAL;
+}
+
+} // namespace
+
+struct ExpressionProgram::Compiler {
+    // While compiling, constants and temporaries are numbered separately;
+    // temporaries are moved behind the constants once all are known
+    static constexpr uint32_t kConstant = 1u << 30;
+
+    struct Operand {
+        uint32_t ref;
+        std::optional<DataType> type;
+    };
+
+    ExpressionProgram& program;
+    const Binder& bind;
+    std::vector<Value> constants;
+    uint32_t temporaries = 0;
+
+    Operand constant(const Value& value) {
+        constants.push_back(value);
+        std::optional<DataType> type;
+        if (!value.isNull()) {
+            type = value.getType();
+        }
+        return {kConstant | static_cast<uint32_t>(constants.size() - 1), type};
+    }
+
+    Operand emit(OpCode op, uint8_t sub, const Operand& left, const Operand& right, std::optional<DataType> type) {
+        uint32_t dest = temporaries++;
+        program.code_.push_back({op, sub, dest, left.ref, right.ref});
+        return {dest, type};
+    }
+
+    Operand fail(const std::string& message) {
+        program.messages_.push_back(message);
+        Operand index{static_cast<uint32_t>(program.messages_.size() - 1), std::nullopt};
+        return emit(OpCode::FAIL, 0, index, index, std::nullopt);
+    }
+
+    Operand compile(const Expression& expr) {
+        std::optional<Slot> slot;
+        try {
+            slot = bind(expr);
+        } catch (const std::runtime_error& error) {
+            return fail(error.what());
+        }
+        if (slot) {
+            return {kRowOperand | static_cast<uint32_t>(slot->index), slot->type};
+        }
+
+        if (auto literal = dynamic_cast<const LiteralExpression*>(&expr)) {
+            return constant(literal->value);
+        }
+        if (auto unary = dynamic_cast<const UnaryExpression*>(&expr)) {
+            return compileUnary(*unary);
+        }
+        if (auto binary = dynamic_cast<const BinaryExpression*>(&expr)) {
+            return compileBinary(*binary);
+        }
+        return fail("Unsupported expression");
+    }
+
+    Operand compileUnary(const UnaryExpression& unary) {
+        Operand operand = compile(*unary.operand);
+        if (unary.op == UnaryExpression::Operator::NOT) {
+            OpCode op = operand.type == DataType::BOOLEAN ? OpCode::NOT : OpCode::UNARY;
+            return emit(op, static_cast<uint8_t>(unary.op), operand, operand, DataType::BOOLEAN);
+        }
+        if (operand.type == DataType::INTEGER) {
+            return emit(OpCode::NEG_INT, 0, operand, operand, operand.type);
+        }
+        if (operand.type == DataType::REAL) {
+            return emit(OpCode::NEG_REAL, 0, operand, operand, operand.type);
+        }
+        return emit(OpCode::UNARY, static_cast<uint8_t>(unary.op), operand, operand, std::nullopt);
+    }
+
+    Operand compileBinary(const BinaryExpression& binary) {
+        using Operator = BinaryExpression::Operator;
+        Operand left = compile(*binary.left);
+        Operand right = compile(*binary.right);
+        auto sub = static_cast<uint8_t>(binary.op);
+        bool integers = left.type == DataType::INTEGER && right.type == DataType::INTEGER;
+        bool numeric = isNumeric(left.type) && isNumeric(right.type);
+
+        switch (binary.op) {
+            case Operator::AND:
+            case Operator::OR: {
+                bool booleans = left.type == DataType::BOOLEAN && right.type == DataType::BOOLEAN;
+                OpCode op = !booleans ? OpCode::BINARY : binary.op == Operator::AND ? OpCode::AND : OpCode::OR;
+                return emit(op, sub, left, right, DataType::BOOLEAN);
+            }
+            case Operator::ADD:
+            case Operator::SUBTRACT:
+            case Operator::MULTIPLY:
+            case Operator::DIVIDE: {
+                if (!numeric) {
+                    return emit(OpCode::BINARY, sub, left, right, std::nullopt);
+                }
+                // ADD, SUBTRACT, MULTIPLY and DIVIDE are consecutive, as are the opcodes
+                auto offset = static_cast<uint8_t>(binary.op) - static_cast<uint8_t>(Operator::ADD);
+                auto base = static_cast<uint8_t>(integers ? OpCode::ADD_INT : OpCode::ADD_REAL);
+                return emit(static_cast<OpCode>(base + offset), sub, left, right,
+                            integers ? DataType::INTEGER : DataType::REAL);
+            }
+            default: {
+                if (!numeric) {
+                    return emit(OpCode::BINARY, sub, left, right, DataType::BOOLEAN);
+                }
+                // Likewise for the six comparisons
+                auto offset = static_cast<uint8_t>(binary.op) - static_cast<uint8_t>(Operator::EQUAL);
+                auto base = static_cast<uint8_t>(integers ? OpCode::EQ_INT : OpCode::EQ_REAL);
+                return emit(static_cast<OpCode>(base + offset), sub, left, right, DataType::BOOLEAN);
+            }
+        }
+    }
+
+    uint32_t relocate(uint32_t ref) const {
+        if (ref & kRowOperand) {
+            return ref;
+        }
+        if (ref & kConstant) {
+            return ref & ~kConstant;
+        }
+        return static_cast<uint32_t>(constants.size()) + ref;
+    }
+};
+
+ExpressionProgram::ExpressionProgram()
+    : code_{{OpCode::HALT, 0, 0, 0, 0}}, constant_count_(1), registers_(1) {}
+
+ExpressionProgram ExpressionProgram::compile(const Expression& expr, const Binder& bind) {
+    ExpressionProgram program;
+    program.code_.clear();
+    Compiler compiler{program, bind, {}, 0};
+    uint32_t result = compiler.compile(expr).ref;
+
+    for (auto& instruction : program.code_) {
+        instruction.dest = compiler.relocate(instruction.dest);
+        if (instruction.op != OpCode::FAIL) {
+            instruction.left = compiler.relocate(instruction.left);
+            instruction.right = compiler.relocate(instruction.right);
+        }
+    }
+    program.code_.push_back({OpCode::HALT, 0, 0, 0, 0});
+    program.result_ = compiler.relocate(result);
+    program.constant_count_ = compiler.constants.size();
+    program.registers_ = std::move(compiler.constants);
+    program.registers_.resize(program.constant_count_ + compiler.temporaries);
+    return program;
+}
+
+Value ExpressionProgram::evaluate(const Row& row) const {
+    // Threaded dispatch: every instruction jumps straight to the handler of
+    // the next one. Indexed by OpCode.
+    static void* const dispatch[] = {
+        &&op_halt, &&op_fail, &&op_unary, &&op_binary, &&op_not, &&op_neg_int, &&op_neg_real,
+        &&op_and, &&op_or,
+        &&op_add_int, &&op_sub_int, &&op_mul_int, &&op_div_int,
+        &&op_add_real, &&op_sub_real, &&op_mul_real, &&op_div_real,
+        &&op_eq_int, &&op_ne_int, &&op_lt_int, &&op_le_int, &&op_gt_int, &&op_ge_int,
+        &&op_eq_real, &&op_ne_real, &&op_lt_real, &&op_le_real, &&op_gt_real, &&op_ge_real,
+    };
+    static_assert(sizeof(dispatch) / sizeof(dispatch[0]) == static_cast<size_t>(OpCode::GE_REAL) + 1,
+                  "dispatch table out of sync with OpCode");
+
+    Value* registers = registers_.data();
+    const Instruction* pc = code_.data();
+
+#define SQL_OPERAND(ref) ((ref) & kRowOperand ? row[(ref) & ~kRowOperand] : registers[(ref)])
+#define SQL_DISPATCH() goto *dispatch[static_cast<size_t>(pc->op)]
+#define SQL_NEXT() \
+    ++pc;          \
+    SQL_DISPATCH()
+#define SQL_GENERIC_BINARY() \
+    registers[pc->dest] = evaluateBinary(static_cast<BinaryExpression::Operator>(pc->sub), left, right)
+
+// INTEGER arithmetic; overflow is left to the generic operator to report
+#define SQL_INT_ARITHMETIC(builtin)                                                              \
+    {                                                                                            \
+        const Value& left = SQL_OPERAND(pc->left);                                               \
+        const Value& right = SQL_OPERAND(pc->right);                                             \
+        int64_t result;                                                                          \
+        if (left.holds<int64_t>() && right.holds<int64_t>() &&                                   \
+            !builtin(left.get<int64_t>(), right.get<int64_t>(), &result)) {                      \
+            registers[pc->dest] = Value(result);                                                 \
+        } else {                                                                                 \
+            SQL_GENERIC_BINARY();                                                                \
+        }                                                                                        \
+        SQL_NEXT();                                                                              \
+    }
+#define SQL_REAL_OPERATION(expression)                                                           \
+    {                                                                                            \
+        const Value& left = SQL_OPERAND(pc->left);                                               \
+        const Value& right = SQL_OPERAND(pc->right);                                             \
+        double l;                                                                                \
+        double r;                                                                                \
+        if (realOperands(left, right, l, r)) {                                                   \
+            registers[pc->dest] = Value(expression);                                             \
+        } else {                                                                                 \
+            SQL_GENERIC_BINARY();                                                                \
+        }                                                                                        \
+        SQL_NEXT();                                                                              \
+    }
+#define SQL_INT_COMPARISON(op)                                                                   \
+    {                                                                                            \
+        const Value& left = SQL_OPERAND(pc->left);                                               \
+        const Value& right = SQL_OPERAND(pc->right);                                             \
+        if (left.holds<int64_t>() && right.holds<int64_t>()) {                                   \
+            registers[pc->dest] = Value(left.get<int64_t>() op right.get<int64_t>());            \
+        } else {                                                                                 \
+            SQL_GENERIC_BINARY();                                                                \
+        }                                                                                        \
+        SQL_NEXT();                                                                              \
+    }
+#define SQL_LOGICAL(op)                                                                          \
+    {                                                                                            \
+        const Value& left = SQL_OPERAND(pc->left);                                               \
+        const Value& right = SQL_OPERAND(pc->right);                                             \
+        if (left.holds<bool>() && right.holds<bool>()) {                                         \
+            registers[pc->dest] = Value(left.get<bool>() op right.get<bool>());                  \
+        } else {                                                                                 \
+            SQL_GENERIC_BINARY();                                                                \
+        }                                                                                        \
+        SQL_NEXT();                                                                              \
+    }
+
+    SQL_DISPATCH();
+
+op_halt:
+    return SQL_OPERAND(result_);
+op_fail:
+    throw std::runtime_error(messages_[pc->left]);
+op_unary:
+    registers[pc->dest] = evaluateUnary(static_cast<UnaryExpression::Operator>(pc->sub), SQL_OPERAND(pc->left));
+    SQL_NEXT();
+op_binary: {
+    const Value& left = SQL_OPERAND(pc->left);
+    const Value& right = SQL_OPERAND(pc->right);
+    SQL_GENERIC_BINARY();
+    SQL_NEXT();
+}
+op_not: {
+    const Value& operand = SQL_OPERAND(pc->left);
+    if (operand.holds<bool>()) {
+        registers[pc->dest] = Value(!operand.get<bool>());
+    } else {
+        registers[pc->dest] = evaluateUnary(UnaryExpression::Operator::NOT, operand);
+    }
+    SQL_NEXT();
+}
+op_neg_int: {
+    const Value& operand = SQL_OPERAND(pc->left);
+    if (operand.holds<int64_t>() && operand.get<int64_t>() != INT64_MIN) {
+        registers[pc->dest] = Value(-operand.get<int64_t>());
+    } else {
+        registers[pc->dest] = evaluateUnary(UnaryExpression::Operator::MINUS, operand);
+    }
+    SQL_NEXT();
+}
+op_neg_real: {
+    const Value& operand = SQL_OPERAND(pc->left);
+    if (operand.holds<double>()) {
+        registers[pc->dest] = Value(-operand.get<double>());
+    } else {
+        registers[pc->dest] = evaluateUnary(UnaryExpression::Operator::MINUS, operand);
+    }
+    SQL_NEXT();
+}
+op_and:
+    SQL_LOGICAL(&&)
+op_or:
+    SQL_LOGICAL(||)
+op_add_int:
+    SQL_INT_ARITHMETIC(__builtin_add_overflow)
+op_sub_int:
+    SQL_INT_ARITHMETIC(__builtin_sub_overflow)
+op_mul_int:
+    SQL_INT_ARITHMETIC(__builtin_mul_overflow)
+op_div_int: {
+    const Value& left = SQL_OPERAND(pc->left);
+    const Value& right = SQL_OPERAND(pc->right);
+    if (left.holds<int64_t>() && right.holds<int64_t>() && right.get<int64_t>() != 0 &&
+        !(left.get<int64_t>() == INT64_MIN && right.get<int64_t>() == -1)) {
+        registers[pc->dest] = Value(left.get<int64_t>() / right.get<int64_t>());
+    } else {
+        SQL_GENERIC_BINARY();
+    }
+    SQL_NEXT();
+}
+op_add_real:
+    SQL_REAL_OPERATION(l + r)
+op_sub_real:
+    SQL_REAL_OPERATION(l - r)
+op_mul_real:
+    SQL_REAL_OPERATION(l * r)
+op_div_real:
+    SQL_REAL_OPERATION(l / r)
+op_eq_int:
+    SQL_INT_COMPARISON(==)
+op_ne_int:
+    SQL_INT_COMPARISON(!=)
+op_lt_int:
+    SQL_INT_COMPARISON(<)
+op_le_int:
+    SQL_INT_COMPARISON(<=)
+op_gt_int:
+    SQL_INT_COMPARISON(>)
+op_ge_int:
+    SQL_INT_COMPARISON(>=)
+// Same results as Value's operators, which derive <=, > and >= from < and ==
+op_eq_real:
+    SQL_REAL_OPERATION(l == r)
+op_ne_real:
+    SQL_REAL_OPERATION(!(l == r))
+op_lt_real:
+    SQL_REAL_OPERATION(l < r)
+op_le_real:
+    SQL_REAL_OPERATION(l < r || l == r)
+op_gt_real:
+    SQL_REAL_OPERATION(!(l < r || l == r))
+op_ge_real:
+    SQL_REAL_OPERATION(!(l < r))
+
+#undef SQL_LOGICAL
+#undef SQL_INT_COMPARISON
+#undef SQL_REAL_OPERATION
+#undef SQL_INT_ARITHMETIC
+#undef SQL_GENERIC_BINARY
+#undef SQL_NEXT
+#undef SQL_DISPATCH
+#undef SQL_OPERAND
+}
+
+} // namespace sqlengine
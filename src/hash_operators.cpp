@@ -0,0 +1,439 @@
+#include "hash_operators.h"
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+namespace sqlengine {
+
+namespace {
+
+// Fan-out of one partitioning pass and the number of passes before an
+// operator gives up and reports the memory limit
+constexpr size_t kSpillPartitions = 16;
+constexpr size_t kMaxPartitionLevels = 6;
+
+// Approximate per-entry overhead of the node-based hash tables
+constexpr size_t kHashEntryOverhead = 64;
+
+// Partition of a key at a given recursion level. Every level mixes in a
+// different seed, so keys that collided in one partition are spread out
+// again when it is repartitioned.
+size_t partitionOf(const std::string& key, size_t level) {
+    uint64_t h = std::hash<std::string>{}(key) + (level + 1) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return static_cast<size_t>(h % kSpillPartitions);
+}
+
+// Join keys match when they compare equal in WHERE, where INTEGER and REAL
+// compare as numbers. A REAL with an integral value is encoded as the
+// INTEGER it equals (so 1.0 joins 1 and -0.0 joins 0); integers themselves
+// keep their exact encoding, so distinct large integers never collide.
+// NaN equals nothing, like NULL.
+bool normalizeJoinKey(Value& value) {
+    double d = value.get<double>();
+    if (std::isnan(d)) {
+        return false;
+    }
+    if (d == std::trunc(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0) {
+        value = Value(static_cast<int64_t>(d));
+    }
+    return true;
+}
+
+std::vector<SortColumn> keyColumns(size_t key_count) {
+    std::vector<SortColumn> columns;
+    for (size_t i = 0; i < key_count; ++i) {
+        columns.push_back({i});
+    }
+    return columns;
+}
+
+void appendToPartition(std::vector<std::unique_ptr<SpillFile>>& partitions, size_t partition,
+                       const std::string& directory, const std::string& record, size_t& created) {
+    auto& file = partitions[partition];
+    if (!file) {
+        file = std::make_unique<SpillFile>(directory);
+        ++created;
+    }
+    file->appendRecord(record);
+}
+
+// Hash tables take at most half of a limited query budget so that rows
+// they produce can still be materialized downstream; beyond that they spill
+bool reserveTableMemory(QueryMemoryContext* memory, size_t held, size_t bytes) {
+    if (!memory) {
+        return true;
+    }
+    if (memory->getLimit() > 0 && held + bytes > memory->getLimit() / 2) {
+        return false;
+    }
+    return memory->tryReserve(bytes);
+}
+
+bool isNumeric(const Value& value) {
+    return value.getType() == DataType::INTEGER || value.getType() == DataType::REAL;
+}
+
+double toDouble(const Value& value) {
+    return value.getType() == DataType::INTEGER
+        ? static_cast<double>(value.get<int64_t>())
+        : value.get<double>();
+}
+
+// Ordering for MIN/MAX; INTEGER and REAL arguments compare numerically
+bool lessThan(const Value& left, const Value& right) {
+    if (left.getType() != right.getType() && isNumeric(left) && isNumeric(right)) {
+        return toDouble(left) < toDouble(right);
+    }
+    return left < right;
+}
+
+} // namespace
+
+// Aggregate state updates
+void accumulateAggregate(AggregateKind kind, AggregateState& state, const Value& value) {
+    if (kind == AggregateKind::COUNT_STAR) {
+        ++state.count;
+        return;
+    }
+    if (value.isNull()) {
+        return;
+    }
+
+    switch (kind) {
+        case AggregateKind::COUNT:
+            ++state.count;
+            break;
+        case AggregateKind::SUM:
+            if (!isNumeric(value)) {
+                throw std::runtime_error("SUM requires a numeric argument");
+            }
+            ++state.count;
+            if (state.value.isNull()) {
+                state.value = value;
+            } else if (state.value.getType() == DataType::INTEGER && value.getType() == DataType::INTEGER) {
+                int64_t sum;
+                if (__builtin_add_overflow(state.value.get<int64_t>(), value.get<int64_t>(), &sum)) {
+                    throw std::runtime_error("Integer overflow");
+                }
+                state.value = Value(sum);
+            } else {
+                state.value = Value(toDouble(state.value) + toDouble(value));
+            }
+            break;
+        case AggregateKind::AVG:
+            if (!isNumeric(value)) {
+                throw std::runtime_error("AVG requires a numeric argument");
+            }
+            ++state.count;
+            state.sum += toDouble(value);
+            break;
+        case AggregateKind::MIN:
+            if (state.value.isNull() || lessThan(value, state.value)) {
+                state.value = value;
+            }
+            break;
+        case AggregateKind::MAX:
+            if (state.value.isNull() || lessThan(state.value, value)) {
+                state.value = value;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+Value finalizeAggregate(AggregateKind kind, const AggregateState& state) {
+    switch (kind) {
+        case AggregateKind::COUNT_STAR:
+        case AggregateKind::COUNT:
+            return Value(state.count);
+        case AggregateKind::AVG:
+            return state.count > 0 ? Value(state.sum / static_cast<double>(state.count)) : Value();
+        default:
+            return state.value;
+    }
+}
+
+// HashAggregator implementation
+
+HashAggregator::HashAggregator(size_t key_count, std::vector<AggregateKind> aggregates,
+                               QueryMemoryContext* memory, std::string spill_directory, size_t level)
+    : key_count_(key_count), key_columns_(keyColumns(key_count)), aggregates_(std::move(aggregates)),
+      memory_(memory), spill_directory_(std::move(spill_directory)), level_(level) {}
+
+HashAggregator::~HashAggregator() {
+    child_.reset();
+    releaseTable();
+}
+
+void HashAggregator::add(const Row& input) {
+    scratch_key_.clear();
+    encodeSortKey(input, key_columns_, scratch_key_);
+
+    auto it = group_index_.find(scratch_key_);
+    if (it != group_index_.end()) {
+        accumulate(&states_[it->second * aggregates_.size()], input);
+        return;
+    }
+
+    // Once spilling has started, new groups always go to disk so that a key
+    // is never split between the table and a partition
+    if (!partitions_.empty()) {
+        spillRow(scratch_key_, input);
+        return;
+    }
+
+    size_t bytes = scratch_key_.size() + estimateRowSize(input) +
+                   aggregates_.size() * sizeof(AggregateState) + kHashEntryOverhead;
+    if (!reserveTableMemory(memory_, table_bytes_, bytes)) {
+        // Without group keys there is only one group, and at the deepest
+        // level another pass would not help: both are hard errors
+        if (key_count_ == 0 || level_ + 1 >= kMaxPartitionLevels) {
+            memory_->reserve(bytes);
+        } else {
+            partitions_.resize(kSpillPartitions);
+            spillRow(scratch_key_, input);
+            return;
+        }
+    }
+    table_bytes_ += bytes;
+
+    size_t group = createGroup(input);
+    accumulate(&states_[group * aggregates_.size()], input);
+}
+
+size_t HashAggregator::createGroup(const Row& input) {
+    size_t group = group_keys_.size();
+    group_index_.emplace(scratch_key_, group);
+    group_keys_.emplace_back(input.begin(), input.begin() + key_count_);
+    states_.resize(states_.size() + aggregates_.size());
+    return group;
+}
+
+void HashAggregator::accumulate(AggregateState* states, const Row& input) {
+    for (size_t i = 0; i < aggregates_.size(); ++i) {
+        accumulateAggregate(aggregates_[i], states[i], input[key_count_ + i]);
+    }
+}
+
+void HashAggregator::spillRow(const std::string& key, const Row& input) {
+    std::string record;
+    encodeRow(input, record);
+    appendToPartition(partitions_, partitionOf(key, level_), spill_directory_, record, spilled_partitions_);
+}
+
+void HashAggregator::finish() {
+    // An aggregate without GROUP BY returns one row even for empty input
+    if (key_count_ == 0 && group_keys_.empty()) {
+        group_keys_.emplace_back();
+        states_.resize(aggregates_.size());
+    }
+
+    for (auto& partition : partitions_) {
+        if (partition) {
+            partition->finishWriting();
+        }
+    }
+}
+
+bool HashAggregator::next(Row& row) {
+    if (output_position_ < group_keys_.size()) {
+        const AggregateState* states = &states_[output_position_ * aggregates_.size()];
+        row = std::move(group_keys_[output_position_]);
+        for (size_t i = 0; i < aggregates_.size(); ++i) {
+            row.push_back(finalizeAggregate(aggregates_[i], states[i]));
+        }
+        ++output_position_;
+        return true;
+    }
+
+    // The in-memory groups are done; their memory goes to the partitions
+    releaseTable();
+
+    for (;;) {
+        if (child_) {
+            if (child_->next(row)) {
+                return true;
+            }
+            spilled_partitions_ += child_->getSpilledPartitionCount();
+            child_.reset();
+        }
+
+        while (next_partition_ < partitions_.size() && !partitions_[next_partition_]) {
+            ++next_partition_;
+        }
+        if (next_partition_ >= partitions_.size()) {
+            return false;
+        }
+
+        std::unique_ptr<SpillFile> partition = std::move(partitions_[next_partition_++]);
+        child_ = std::make_unique<HashAggregator>(key_count_, aggregates_, memory_, spill_directory_, level_ + 1);
+        SpillReader reader(*partition);
+        std::string record;
+        while (reader.next(record)) {
+            child_->add(decodeRow(record.data(), record.size()));
+        }
+        child_->finish();
+    }
+}
+
+size_t HashAggregator::getSpilledPartitionCount() const {
+    return spilled_partitions_ + (child_ ? child_->getSpilledPartitionCount() : 0);
+}
+
+void HashAggregator::releaseTable() {
+    if (memory_ && table_bytes_ > 0) {
+        memory_->release(table_bytes_);
+    }
+    table_bytes_ = 0;
+    output_position_ = 0;
+    std::unordered_map<std::string, size_t>().swap(group_index_);
+    std::vector<Row>().swap(group_keys_);
+    std::vector<AggregateState>().swap(states_);
+}
+
+// HashJoin implementation
+HashJoin::HashJoin(size_t key_count, QueryMemoryContext* memory, std::string spill_directory, size_t level)
+    : key_columns_(keyColumns(key_count)), memory_(memory),
+      spill_directory_(std::move(spill_directory)), level_(level) {}
+
+HashJoin::~HashJoin() {
+    releaseTable();
+}
+
+bool HashJoin::encodeKey(const Row& key) {
+    bool has_real = false;
+    for (const auto& value : key) {
+        if (value.isNull()) {
+            return false;
+        }
+        has_real |= value.getType() == DataType::REAL;
+    }
+    scratch_key_.clear();
+    if (!has_real) {
+        encodeSortKey(key, key_columns_, scratch_key_);
+        return true;
+    }
+    
+    scratch_values_ = key;
+    for (auto& value : scratch_values_) {
+        if (value.getType() == DataType::REAL && !normalizeJoinKey(value)) {
+            return false;
+        }
+    }
+    encodeSortKey(scratch_values_, key_columns_, scratch_key_);
+    return true;
+}
+
+void HashJoin::addBuild(const Row& key, const Row& row) {
+    if (encodeKey(key)) {
+        insertBuild(scratch_key_, row);
+    }
+}
+
+void HashJoin::probe(const Row& key, const Row& row, const Output& output) {
+    if (encodeKey(key)) {
+        probeEncoded(scratch_key_, row, output);
+    }
+}
+
+void HashJoin::insertBuild(const std::string& key, const Row& row) {
+    if (!build_partitions_.empty()) {
+        spillRecord(build_partitions_, key, row);
+        return;
+    }
+
+    size_t bytes = key.size() + estimateRowSize(row) + kHashEntryOverhead;
+    if (!reserveTableMemory(memory_, table_bytes_, bytes)) {
+        // At the deepest level the partition is dominated by a few keys
+        // and another pass would not shrink it
+        if (level_ + 1 >= kMaxPartitionLevels) {
+            memory_->reserve(bytes);
+        } else {
+            startSpilling();
+            spillRecord(build_partitions_, key, row);
+            return;
+        }
+    }
+    table_bytes_ += bytes;
+    table_.emplace(key, row);
+}
+
+void HashJoin::probeEncoded(const std::string& key, const Row& row, const Output& output) {
+    if (!build_partitions_.empty()) {
+        spillRecord(probe_partitions_, key, row);
+        return;
+    }
+
+    auto range = table_.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        output(row, it->second);
+    }
+}
+
+void HashJoin::startSpilling() {
+    build_partitions_.resize(kSpillPartitions);
+    probe_partitions_.resize(kSpillPartitions);
+
+    for (const auto& entry : table_) {
+        spillRecord(build_partitions_, entry.first, entry.second);
+    }
+    releaseTable();
+}
+
+void HashJoin::spillRecord(std::vector<std::unique_ptr<SpillFile>>& partitions,
+                           const std::string& key, const Row& row) {
+    std::string record;
+    encodeKeyedRecord(key, row, record);
+    appendToPartition(partitions, partitionOf(key, level_), spill_directory_, record, spilled_partitions_);
+}
+
+void HashJoin::finish(const Output& output) {
+    releaseTable();
+
+    for (size_t i = 0; i < build_partitions_.size(); ++i) {
+        std::unique_ptr<SpillFile> build = std::move(build_partitions_[i]);
+        std::unique_ptr<SpillFile> probe = std::move(probe_partitions_[i]);
+        if (!build || !probe) {
+            continue; // one side is empty, so nothing in this partition matches
+        }
+        build->finishWriting();
+        probe->finishWriting();
+
+        HashJoin child(key_columns_.size(), memory_, spill_directory_, level_ + 1);
+        std::string record;
+        {
+            SpillReader reader(*build);
+            while (reader.next(record)) {
+                child.insertBuild(std::string(keyedRecordKey(record)), keyedRecordRow(record));
+            }
+        }
+        build.reset();
+        {
+            SpillReader reader(*probe);
+            while (reader.next(record)) {
+                child.probeEncoded(std::string(keyedRecordKey(record)), keyedRecordRow(record), output);
+            }
+        }
+        child.finish(output);
+        spilled_partitions_ += child.getSpilledPartitionCount();
+    }
+
+    build_partitions_.clear();
+    probe_partitions_.clear();
+}
+
+void HashJoin::releaseTable() {
+    if (memory_ && table_bytes_ > 0) {
+        memory_->release(table_bytes_);
+    }
+    table_bytes_ = 0;
+    std::unordered_multimap<std::string, Row>().swap(table_);
+}
+
+} // namespace sqlengine
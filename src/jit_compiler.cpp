@@ -0,0 +1,283 @@
+#include "jit_compiler.h"
+#include "jit_runtime.h"
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sqlengine {
+
+namespace {
+
+// Compiles one module on the calling compile thread. An object found in
+// the cache is used as is; otherwise the module is optimized at O2, which
+// also simplifies the runtime helpers inlined into it, and compiled with
+// a target machine of its own.
+class QueryCompiler : public llvm::orc::IRCompileLayer::IRCompiler {
+public:
+    QueryCompiler(llvm::orc::JITTargetMachineBuilder target, llvm::ObjectCache* cache)
+        : IRCompiler(llvm::orc::irManglingOptionsFromTargetOptions(target.getOptions())),
+          target_(std::move(target)), cache_(cache) {}
+
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(llvm::Module& module) override {
+        if (cache_) {
+            if (auto object = cache_->getObject(&module)) {
+                return std::move(object);
+            }
+        }
+
+        auto machine = target_.createTargetMachine();
+        if (!machine) {
+            return machine.takeError();
+        }
+        optimize(module, **machine);
+
+        llvm::orc::SimpleCompiler compile(**machine);
+        auto object = compile(module);
+        if (object && cache_) {
+            cache_->notifyObjectCompiled(&module, (*object)->getMemBufferRef());
+        }
+        return object;
+    }
+
+private:
+    llvm::orc::JITTargetMachineBuilder target_;
+    llvm::ObjectCache* cache_;
+
+    static void optimize(llvm::Module& module, llvm::TargetMachine& machine) {
+        llvm::LoopAnalysisManager loop_analyses;
+        llvm::FunctionAnalysisManager function_analyses;
+        llvm::CGSCCAnalysisManager cgscc_analyses;
+        llvm::ModuleAnalysisManager module_analyses;
+        llvm::PassBuilder builder(&machine);
+        builder.registerModuleAnalyses(module_analyses);
+        builder.registerCGSCCAnalyses(cgscc_analyses);
+        builder.registerFunctionAnalyses(function_analyses);
+        builder.registerLoopAnalyses(loop_analyses);
+        builder.crossRegisterProxies(loop_analyses, function_analyses, cgscc_analyses, module_analyses);
+
+        auto passes = builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+        passes.run(module, module_analyses);
+    }
+};
+
+#if LLVM_VERSION_MAJOR >= 15
+uint64_t symbolAddress(const llvm::orc::ExecutorAddr& symbol) {
+    return symbol.getValue();
+}
+#else
+llvm::JITTargetAddress symbolAddress(const llvm::JITEvaluatedSymbol& symbol) {
+    return symbol.getAddress();
+}
+#endif
+
+} // namespace
+
+std::shared_ptr<JITCompiler> JITCompiler::get(const std::string& object_cache_directory) {
+    static std::mutex registry_mutex;
+    static std::unordered_map<std::string, std::weak_ptr<JITCompiler>> registry;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& entry = registry[object_cache_directory];
+    if (auto compiler = entry.lock()) {
+        return compiler;
+    }
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    auto compiler = std::make_shared<JITCompiler>(threads, object_cache_directory);
+    entry = compiler;
+    return compiler;
+}
+
+JITCompiler::JITCompiler(unsigned compile_threads, const std::string& object_cache_directory)
+    : compile_threads_(compile_threads) {
+    if (!object_cache_directory.empty()) {
+        object_cache_ = std::make_unique<PersistentObjectCache>(object_cache_directory);
+    }
+
+    llvm::orc::LLJITBuilder builder;
+    builder.setNumCompileThreads(compile_threads_);
+    PersistentObjectCache* cache = object_cache_.get();
+    builder.setCompileFunctionCreator([cache](llvm::orc::JITTargetMachineBuilder target)
+            -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+        return std::make_unique<QueryCompiler>(std::move(target), cache);
+    });
+
+    auto jit_or_err = builder.create();
+    if (!jit_or_err) {
+        throw std::runtime_error("Failed to create JIT: " + llvm::toString(jit_or_err.takeError()));
+    }
+    jit_ = std::move(*jit_or_err);
+
+    // Runtime functions are resolved to their addresses in this process
+    llvm::orc::SymbolMap runtime;
+    for (const auto& symbol : runtimeSymbols()) {
+        runtime[jit_->mangleAndIntern(symbol.name)] = llvm::JITEvaluatedSymbol(
+            llvm::pointerToJITTargetAddress(symbol.address),
+            llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+    }
+    if (auto err = jit_->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(runtime)))) {
+        throw std::runtime_error("Failed to define JIT runtime: " + llvm::toString(std::move(err)));
+    }
+}
+
+JITCompiler::~JITCompiler() {
+    // Trackers refer to the JIT's session, and the compile threads may use
+    // the object cache until the JIT is gone
+    resident_index_.clear();
+    resident_.clear();
+    jit_.reset();
+}
+
+void JITCompiler::addModules(std::unique_ptr<llvm::Module> module,
+                             std::vector<std::unique_ptr<llvm::Module>> pipeline_modules,
+                             std::unique_ptr<llvm::LLVMContext> context, const std::string& key,
+                             const llvm::orc::ResourceTrackerSP& tracker) {
+    // Functions defined by the statement get the key as a suffix, in all
+    // its modules so that calls across them still resolve
+    std::vector<llvm::Module*> parts = {module.get()};
+    for (auto& pipeline_module : pipeline_modules) {
+        parts.push_back(pipeline_module.get());
+    }
+    std::unordered_set<std::string> defined;
+    for (llvm::Module* part : parts) {
+        for (auto& function : part->functions()) {
+            if (!function.isDeclaration()) {
+                defined.insert(function.getName().str());
+            }
+        }
+    }
+    for (llvm::Module* part : parts) {
+        for (auto& function : part->functions()) {
+            if (defined.count(function.getName().str())) {
+                function.setName(function.getName() + "_" + key);
+            }
+        }
+    }
+    module->setModuleIdentifier(key);
+
+    // A module is compiled when one of its symbols is first looked up, so
+    // a pipeline module costs nothing until its pipeline asks for its code
+    llvm::orc::ThreadSafeContext shared_context(std::move(context));
+    for (size_t i = 0; i < pipeline_modules.size(); ++i) {
+        pipeline_modules[i]->setModuleIdentifier(key + "_pipeline" + std::to_string(i));
+        auto tsm = llvm::orc::ThreadSafeModule(std::move(pipeline_modules[i]), shared_context);
+        if (auto err = jit_->addIRModule(tracker, std::move(tsm))) {
+            throw std::runtime_error("Failed to add module to JIT: " + llvm::toString(std::move(err)));
+        }
+    }
+    if (auto err = jit_->addIRModule(tracker, llvm::orc::ThreadSafeModule(std::move(module), shared_context))) {
+        throw std::runtime_error("Failed to add module to JIT: " + llvm::toString(std::move(err)));
+    }
+}
+
+void JITCompiler::evictModules() {
+    bool evicted = false;
+    auto it = resident_.end();
+    while (resident_.size() > kMaxResidentModules && it != resident_.begin()) {
+        --it;
+        if (it->use_count() > 1) {
+            // A running statement still calls into it
+            continue;
+        }
+        if (auto err = (*it)->tracker->remove()) {
+            llvm::consumeError(std::move(err));
+        }
+        resident_index_.erase((*it)->key);
+        it = resident_.erase(it);
+        evicted = true;
+    }
+    if (evicted) {
+        jit_->getExecutionSession().getSymbolStringPool()->clearDeadEntries();
+    }
+}
+
+JITCompiler::CompiledQuery JITCompiler::compile(std::unique_ptr<llvm::Module> module,
+                                                std::vector<std::unique_ptr<llvm::Module>> pipeline_modules,
+                                                std::unique_ptr<llvm::LLVMContext> context,
+                                                const std::string& entry_function) {
+    module->setTargetTriple(jit_->getTargetTriple().str());
+    module->setDataLayout(jit_->getDataLayout());
+    for (auto& pipeline_module : pipeline_modules) {
+        pipeline_module->setTargetTriple(jit_->getTargetTriple().str());
+        pipeline_module->setDataLayout(jit_->getDataLayout());
+    }
+    std::string key = moduleCacheKey(*module, pipeline_modules);
+    std::string symbol_name = entry_function + "_" + key;
+
+    CompiledQuery compiled;
+    bool add;
+    {
+        // Adding a module does not compile it, so the lock is held until
+        // the module is in the JIT and other sessions can look it up.
+        // Copies of a statement's lease are only taken under the lock or
+        // from a lease already held, so eviction never races with them.
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = resident_index_.find(key);
+        add = found == resident_index_.end();
+        if (add) {
+            auto resident = std::make_shared<ResidentModule>();
+            resident->key = key;
+            resident->tracker = jit_->getMainJITDylib().createResourceTracker();
+            if (object_cache_) {
+                object_cache_->watchLoad(key);
+            }
+            try {
+                addModules(std::move(module), std::move(pipeline_modules), std::move(context), key,
+                           resident->tracker);
+            } catch (...) {
+                if (object_cache_) {
+                    object_cache_->takeLoaded(key);
+                }
+                if (auto err = resident->tracker->remove()) {
+                    llvm::consumeError(std::move(err));
+                }
+                throw;
+            }
+            resident_.push_front(resident);
+            resident_index_[key] = resident_.begin();
+            compiled.module = resident;
+            evictModules();
+        } else {
+            resident_.splice(resident_.begin(), resident_, found->second);
+            compiled.module = *found->second;
+            compiled.source = Source::LINKED;
+        }
+    }
+
+    // The first lookup materializes the entry module on a compile thread; lookups
+    // from other sessions for the same module wait for that result
+    auto symbol = jit_->lookup(symbol_name);
+    if (add && object_cache_ && object_cache_->takeLoaded(key)) {
+        compiled.source = Source::OBJECT_CACHE;
+    }
+    if (!symbol) {
+        throw std::runtime_error("JIT lookup failed: " + llvm::toString(symbol.takeError()));
+    }
+
+    compiled.entry = reinterpret_cast<void (*)(void*)>(symbolAddress(*symbol));
+    return compiled;
+}
+
+void JITCompiler::lookupFunction(const CompiledQuery& query, const std::string& name,
+                                 std::function<void(void* address, const std::string& error)> done) {
+    auto& session = jit_->getExecutionSession();
+    auto symbol = session.intern(jit_->mangle(name + "_" + query.module->key));
+    std::shared_ptr<const ResidentModule> module = query.module;
+    session.lookup(llvm::orc::LookupKind::Static, llvm::orc::makeJITDylibSearchOrder(&jit_->getMainJITDylib()),
+                   llvm::orc::SymbolLookupSet(symbol), llvm::orc::SymbolState::Ready,
+                   [module, symbol, done = std::move(done)](llvm::Expected<llvm::orc::SymbolMap> result) {
+                       if (!result) {
+                           done(nullptr, llvm::toString(result.takeError()));
+                           return;
+                       }
+                       done(llvm::jitTargetAddressToPointer<void*>((*result)[symbol].getAddress()), "");
+                   },
+                   llvm::orc::NoDependenciesToRegister);
+}
+
+} // namespace sqlengine
@@ -0,0 +1,113 @@
+#include "jit_object_cache.h"
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace sqlengine {
+
+namespace {
+
+// The IR is printed without the module name, which differs per statement
+void printModuleBody(const llvm::Module& module, llvm::raw_ostream& out) {
+    for (const auto& global : module.globals()) {
+        global.print(out);
+        out << '\n';
+    }
+    for (const auto& function : module.functions()) {
+        function.print(out);
+    }
+}
+
+} // namespace
+
+std::string moduleCacheKey(const llvm::Module& module,
+                           const std::vector<std::unique_ptr<llvm::Module>>& pipeline_modules) {
+    std::string ir;
+    llvm::raw_string_ostream out(ir);
+    printModuleBody(module, out);
+    for (const auto& pipeline_module : pipeline_modules) {
+        out << "; lazy\n";
+        printModuleBody(*pipeline_module, out);
+    }
+    out.flush();
+
+    llvm::SHA1 hash;
+    hash.update(ir);
+    hash.update(module.getTargetTriple());
+    hash.update(module.getDataLayoutStr());
+    hash.update(llvm::sys::getHostCPUName());
+    hash.update(LLVM_VERSION_STRING);
+    return llvm::toHex(hash.final(), /*LowerCase=*/true);
+}
+
+PersistentObjectCache::PersistentObjectCache(std::string directory) : directory_(std::move(directory)) {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        throw std::runtime_error("Cannot create JIT cache directory " + directory_ + ": " + error.message());
+    }
+}
+
+void PersistentObjectCache::notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) {
+    std::string path = objectPath(*module);
+    std::string temp_path = path + ".tmp" + std::to_string(reinterpret_cast<uintptr_t>(module));
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(object.getBufferStart(), static_cast<std::streamsize>(object.getBufferSize()));
+        if (!file) {
+            // The cache is an optimization; a failed write only costs a recompile
+            std::remove(temp_path.c_str());
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::remove(temp_path.c_str());
+        return;
+    }
+    stores_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> PersistentObjectCache::getObject(const llvm::Module* module) {
+    auto buffer = llvm::MemoryBuffer::getFile(objectPath(*module), /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        return nullptr;
+    }
+    loads_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto watched = loaded_.find(module->getModuleIdentifier());
+    if (watched != loaded_.end()) {
+        watched->second = true;
+    }
+    return std::move(*buffer);
+}
+
+void PersistentObjectCache::watchLoad(const std::string& module_identifier) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loaded_[module_identifier] = false;
+}
+
+bool PersistentObjectCache::takeLoaded(const std::string& module_identifier) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto watched = loaded_.find(module_identifier);
+    if (watched == loaded_.end()) {
+        return false;
+    }
+    bool loaded = watched->second;
+    loaded_.erase(watched);
+    return loaded;
+}
+
+std::string PersistentObjectCache::objectPath(const llvm::Module& module) const {
+    return (std::filesystem::path(directory_) / (module.getModuleIdentifier() + ".o")).string();
+}
+
+} // namespace sqlengine
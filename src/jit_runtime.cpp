@@ -0,0 +1,45 @@
+#include "jit_runtime.h"
+
+namespace sqlengine {
+
+void PipelineExecutor::rethrowError() {
+    if (error_) {
+        std::exception_ptr error = std::move(error_);
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+const std::vector<RuntimeSymbol>& runtimeSymbols() {
+    static const std::vector<RuntimeSymbol> symbols = {
+        {"sql_pipeline_needed", reinterpret_cast<void*>(&sql_pipeline_needed)},
+        {"sql_run_pipeline", reinterpret_cast<void*>(&sql_run_pipeline)},
+    };
+    return symbols;
+}
+
+} // namespace sqlengine
+
+using sqlengine::PipelineExecutor;
+
+int32_t sql_pipeline_needed(void* executor, int64_t pipeline) {
+    auto* pipelines = static_cast<PipelineExecutor*>(executor);
+    if (pipelines->hasError()) {
+        return 0;
+    }
+    try {
+        return pipelines->pipelineNeeded(static_cast<size_t>(pipeline)) ? 1 : 0;
+    } catch (...) {
+        pipelines->setError(std::current_exception());
+        return 0;
+    }
+}
+
+void sql_run_pipeline(void* executor, int64_t pipeline) {
+    auto* pipelines = static_cast<PipelineExecutor*>(executor);
+    try {
+        pipelines->runPipeline(static_cast<size_t>(pipeline));
+    } catch (...) {
+        pipelines->setError(std::current_exception());
+    }
+}
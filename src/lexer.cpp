@@ -30,6 +30,11 @@ std::unordered_map<std::string, TokenType> Lexer::keywords_ = {
     {"ASC", TokenType::ASC},
     {"DESC", TokenType::DESC},
     {"LIMIT", TokenType::LIMIT},
+    {"JOIN", TokenType::JOIN},
+    {"INNER", TokenType::INNER},
+    {"ON", TokenType::ON},
+    {"GROUP", TokenType::GROUP},
+    {"HAVING", TokenType::HAVING},
     {"INTEGER", TokenType::INTEGER_TYPE},
     {"REAL", TokenType::REAL_TYPE},
     {"TEXT", TokenType::TEXT_TYPE},
@@ -52,6 +57,12 @@ std::vector<Token> Lexer::tokenize() {
         }
     }
     
+    // The parser relies on a terminating EOF token, also when the input
+    // does not end in whitespace
+    if (tokens.empty() || tokens.back().type != TokenType::EOF_TOKEN) {
+        tokens.push_back(makeToken(TokenType::EOF_TOKEN, ""));
+    }
+    
     return tokens;
 }
 
@@ -226,6 +237,23 @@ Token Lexer::readNumber() {
         value += advance();
     }
     
+    // An exponent (1e-05, 2E10) makes the literal REAL
+    if (hasNext() && (peek() == 'e' || peek() == 'E')) {
+        size_t digits = position_ + 1;
+        if (digits < input_.length() && (input_[digits] == '+' || input_[digits] == '-')) {
+            ++digits;
+        }
+        if (digits < input_.length() && isDigit(input_[digits])) {
+            hasDecimal = true;
+            while (position_ < digits) {
+                value += advance();
+            }
+            while (hasNext() && isDigit(peek())) {
+                value += advance();
+            }
+        }
+    }
+    
     TokenType type = hasDecimal ? TokenType::REAL_LITERAL : TokenType::INTEGER_LITERAL;
     return makeToken(type, value);
 }
@@ -249,4 +277,39 @@ Token Lexer::readIdentifier() {
     return makeToken(TokenType::IDENTIFIER, value);
 }
 
-} // namespace sqlengine
\ No newline at end of file
+std::string normalizeQuery(const std::vector<Token>& tokens) {
+    std::string normalized;
+    bool space_before = false;
+    
+    for (const auto& token : tokens) {
+        std::string text;
+        switch (token.type) {
+            case TokenType::EOF_TOKEN:
+                continue;
+            case TokenType::INTEGER_LITERAL:
+            case TokenType::REAL_LITERAL:
+            case TokenType::STRING_LITERAL:
+                text = "?";
+                break;
+            case TokenType::IDENTIFIER:
+                text = token.value;
+                break;
+            default:
+                text = token.value;
+                std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+                break;
+        }
+        
+        bool attach_left = token.type == TokenType::COMMA || token.type == TokenType::RIGHT_PAREN ||
+                           token.type == TokenType::DOT || token.type == TokenType::SEMICOLON;
+        if (space_before && !attach_left) {
+            normalized += ' ';
+        }
+        normalized += text;
+        space_before = token.type != TokenType::LEFT_PAREN && token.type != TokenType::DOT;
+    }
+    
+    return normalized;
+}
+
+} // namespace sqlengine
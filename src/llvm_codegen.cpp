@@ -1,154 +1,354 @@
 #include "llvm_codegen.h"
+#include "sort.h"
+#include "expression_eval.h"
+#include "query_runtime.h"
+#include "csv_import.h"
+#include "columnar_file.h"
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Support/TargetSelect.h>
-#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Config/llvm-config.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
 #include <iostream>
+#include <mutex>
 
 namespace sqlengine {
 
-LLVMCodeGenerator::LLVMCodeGenerator() {
+LLVMCodeGenerator::LLVMCodeGenerator()
+    : spill_directory_(std::filesystem::temp_directory_path().string()) {
     // Initialize LLVM
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
     llvm::InitializeNativeTargetAsmParser();
     
+    // Compilation goes through the process-wide JIT
+    try {
+        jit_ = JITCompiler::get();
+    } catch (const std::exception&) {
+        jit_.reset();
+    }
+}
+
+LLVMCodeGenerator::~LLVMCodeGenerator() = default;
+
+void LLVMCodeGenerator::setObjectCacheDirectory(const std::string& directory) {
+    jit_ = JITCompiler::get(directory);
+}
+
+void LLVMCodeGenerator::resetModule() {
+    // Every statement is generated into a fresh context and module; the
+    // previous ones are either owned by the JIT or discarded here
+    builder_.reset();
+    runtime_module_.reset();
+    pipeline_modules_.clear();
+    module_.reset();
     context_ = std::make_unique<llvm::LLVMContext>();
-    module_ = std::make_unique<llvm::Module>("sql_query", *context_);
+    module_ = std::make_unique<llvm::Module>("sql_query_" + std::to_string(++module_counter_), *context_);
     builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);
-    
-    // Initialize JIT
-    auto jit_or_err = llvm::orc::LLJITBuilder().create();
-    if (jit_or_err) {
-        jit_ = std::move(*jit_or_err);
-    }
+    entry_function_.clear();
     
     initializeTypes();
-    createRuntimeFunctions();
 }
 
-LLVMCodeGenerator::~LLVMCodeGenerator() = default;
-
 void LLVMCodeGenerator::initializeTypes() {
     int64_type_ = llvm::Type::getInt64Ty(*context_);
     double_type_ = llvm::Type::getDoubleTy(*context_);
     bool_type_ = llvm::Type::getInt1Ty(*context_);
-    ptr_type_ = llvm::PointerType::get(*context_, 0);
-    
-    // Create Value struct type (simplified)
-    std::vector<llvm::Type*> value_fields = {
-        llvm::Type::getInt32Ty(*context_), // type tag
-        llvm::Type::getInt64Ty(*context_)  // data (union simplified as int64)
-    };
-    value_type_ = llvm::StructType::create(*context_, value_fields, "Value");
-    
-    // Create Row type (simplified as array of values)
-    row_type_ = llvm::StructType::create(*context_, {
-        llvm::ArrayType::get(value_type_, 16) // max 16 columns
-    }, "Row");
+    ptr_type_ = llvm::Type::getInt8PtrTy(*context_);
 }
 
-void LLVMCodeGenerator::createRuntimeFunctions() {
-    // Create function prototypes for runtime support
-    auto int_arg = std::vector<llvm::Type*>{int64_type_};
-    auto double_arg = std::vector<llvm::Type*>{double_type_};
-    auto string_arg = std::vector<llvm::Type*>{ptr_type_};
-    auto compare_args = std::vector<llvm::Type*>{llvm::PointerType::get(value_type_, 0), llvm::PointerType::get(value_type_, 0)};
-    
-    auto void_type = llvm::Type::getVoidTy(*context_);
-    
-    print_int_func_ = llvm::Function::Create(
-        llvm::FunctionType::get(void_type, int_arg, false),
-        llvm::Function::ExternalLinkage, "print_int", module_.get());
-    
-    print_double_func_ = llvm::Function::Create(
-        llvm::FunctionType::get(void_type, double_arg, false),
-        llvm::Function::ExternalLinkage, "print_double", module_.get());
-    
-    print_string_func_ = llvm::Function::Create(
-        llvm::FunctionType::get(void_type, string_arg, false),
-        llvm::Function::ExternalLinkage, "print_string", module_.get());
-    
-    compare_values_func_ = llvm::Function::Create(
-        llvm::FunctionType::get(llvm::Type::getInt32Ty(*context_), compare_args, false),
-        llvm::Function::ExternalLinkage, "compare_values", module_.get());
+llvm::Module& LLVMCodeGenerator::pipelineModule(size_t pipeline) {
+    if (pipeline_modules_.size() <= pipeline) {
+        pipeline_modules_.resize(pipeline + 1);
+    }
+    auto& module = pipeline_modules_[pipeline];
+    if (!module) {
+        module = std::make_unique<llvm::Module>(
+            "sql_pipeline_" + std::to_string(module_counter_) + "_" + std::to_string(pipeline), *context_);
+    }
+    return *module;
+}
+
+llvm::FunctionCallee LLVMCodeGenerator::runtimeFunction(llvm::Module& module, const std::string& name) {
+    if (!runtime_module_) {
+        runtime_module_ = loadQueryRuntime(*context_);
+    }
+    return declareRuntimeFunction(module, *runtime_module_, name);
 }
 
-void LLVMCodeGenerator::generateCode(Statement& statement, Database& database) {
+void LLVMCodeGenerator::generateCode(Statement& statement, Database& database, QueryMemoryContext* memory,
+                                     const QueryControl* control) {
     current_database_ = &database;
+    memory_ = memory;
+    control_ = control;
+    rows_since_check_ = 0;
     results_.clear();
+    rows_scanned_ = 0;
+    rows_inserted_ = 0;
+    last_compile_micros_ = 0;
+    releaseStatement();
+    resetModule();
     
-    // Generate LLVM IR for the statement
-    statement.accept(*this);
-    
-    // Verify the module
-    std::string error_str;
-    if (llvm::verifyModule(*module_, &llvm::errs())) {
-        throw std::runtime_error("LLVM module verification failed");
+    try {
+        // Generate LLVM IR for the statement
+        statement.accept(*this);
+        
+        // Pull in the bodies of the runtime helpers the statement calls
+        if (runtime_module_) {
+            linkQueryRuntime(*module_);
+            for (auto& module : pipeline_modules_) {
+                if (module) {
+                    linkQueryRuntime(*module);
+                }
+            }
+        }
+        
+        // Verify the modules
+        bool broken = llvm::verifyModule(*module_, &llvm::errs());
+        for (auto& module : pipeline_modules_) {
+            broken = broken || (module && llvm::verifyModule(*module, &llvm::errs()));
+        }
+        if (broken) {
+            throw std::runtime_error("LLVM module verification failed");
+        }
+    } catch (...) {
+        releaseStatement();
+        throw;
     }
 }
 
 void LLVMCodeGenerator::execute() {
-    compileAndExecute();
+    try {
+        compileAndExecute();
+    } catch (...) {
+        releaseStatement();
+        throw;
+    }
+    releaseStatement();
+}
+
+void LLVMCodeGenerator::releaseStatement() {
+    pipelines_.clear();
+    select_.reset();
+}
+
+// Expression visitors emit the body of a kernel for one row (kernel_row_).
+// Expressions are type-checked by kernelType first, so operand types here
+// are always valid; the SQL type of each result is kept in current_type_
+// and its NULL flag in current_null_ (nullptr if it can never be NULL, so
+// expressions over NOT NULL columns carry no NULL handling at all).
+
+llvm::Type* LLVMCodeGenerator::laneType(llvm::Type* type) const {
+    return kernel_width_ > 1 ? llvm::FixedVectorType::get(type, kernel_width_) : type;
 }
 
 void LLVMCodeGenerator::visit(LiteralExpression& node) {
     current_value_ = createValue(node.value);
+    if (kernel_width_ > 1) {
+        current_value_ = builder_->CreateVectorSplat(kernel_width_, current_value_);
+    }
+    current_type_ = node.value.getType();
+    current_null_ = nullptr;
 }
 
 void LLVMCodeGenerator::visit(ColumnExpression& node) {
-    // This will be implemented when we have a row context
-    // For now, create a placeholder
-    current_value_ = llvm::ConstantInt::get(int64_type_, 0);
+    const auto& [slot, type] = kernel_slots_.at(&node);
+    auto address = builder_->CreateGEP(int64_type_, kernel_columns_[slot], kernel_row_);
+    llvm::Value* value = nullptr;
+    if (kernel_width_ > 1) {
+        // Lanes past the end of the batch are not read
+        auto vector_type = laneType(int64_type_);
+        value = builder_->CreateMaskedLoad(vector_type,
+                                           builder_->CreateBitCast(address, llvm::PointerType::get(vector_type, 0)),
+                                           llvm::Align(8), kernel_active_, llvm::Constant::getNullValue(vector_type),
+                                           node.column_name);
+    } else {
+        value = builder_->CreateLoad(int64_type_, address, node.column_name);
+    }
+    switch (type) {
+        case DataType::REAL:
+            current_value_ = builder_->CreateBitCast(value, laneType(double_type_));
+            break;
+        case DataType::BOOLEAN:
+            current_value_ = builder_->CreateICmpNE(value, llvm::Constant::getNullValue(value->getType()));
+            break;
+        default:
+            current_value_ = value;
+            break;
+    }
+    current_type_ = type;
+    current_null_ = nullptr;
+    if (kernel_nulls_[slot] && kernel_width_ > 1) {
+        // A chunk starts on a byte boundary, so its flags are one bitmap byte
+        auto byte_type = llvm::Type::getInt8Ty(*context_);
+        auto byte = builder_->CreateLoad(byte_type, builder_->CreateGEP(byte_type, kernel_nulls_[slot],
+                                                                        builder_->CreateLShr(kernel_row_, 3)));
+        current_null_ = builder_->CreateBitCast(byte, laneType(bool_type_), node.column_name + "_null");
+    } else if (kernel_nulls_[slot]) {
+        current_null_ = builder_->CreateCall(runtimeFunction(*current_function_->getParent(), "sql_is_null"),
+                                             {kernel_nulls_[slot], kernel_row_}, node.column_name + "_null");
+    }
+}
+
+llvm::Value* LLVMCodeGenerator::propagateNull(llvm::Value* left_null, llvm::Value* right_null) {
+    if (!left_null) {
+        return right_null;
+    }
+    if (!right_null) {
+        return left_null;
+    }
+    return builder_->CreateOr(left_null, right_null);
+}
+
+llvm::Value* LLVMCodeGenerator::checkedArithmetic(BinaryExpression::Operator op, llvm::Value* left,
+                                                  llvm::Value* right, llvm::Value* null) {
+    // The error flag is ORed into the row's flag; the kernel tests it once
+    // per batch instead of branching per row. NULL rows and masked-off
+    // lanes compute on placeholder values and never raise an error.
+    using Op = BinaryExpression::Operator;
+    llvm::Value* value = nullptr;
+    llvm::Value* error = nullptr;
+    if (kernel_width_ == 1) {
+        const char* helper = op == Op::ADD ? "sql_add_checked"
+                           : op == Op::SUBTRACT ? "sql_sub_checked"
+                           : op == Op::MULTIPLY ? "sql_mul_checked"
+                           : "sql_div_checked";
+        auto result = builder_->CreateCall(runtimeFunction(*current_function_->getParent(), helper), {left, right});
+        value = builder_->CreateExtractValue(result, 0);
+        error = builder_->CreateExtractValue(result, 1);
+    } else if (op == Op::DIVIDE) {
+        // Same rules as sql_div_checked, lane-wise
+        auto type = left->getType();
+        error = builder_->CreateOr(
+            builder_->CreateICmpEQ(right, llvm::Constant::getNullValue(type)),
+            builder_->CreateAnd(builder_->CreateICmpEQ(left, llvm::ConstantInt::get(type, INT64_MIN)),
+                                builder_->CreateICmpEQ(right, llvm::ConstantInt::get(type, -1))));
+        auto divisor = builder_->CreateSelect(error, llvm::ConstantInt::get(type, 1), right);
+        value = builder_->CreateSDiv(left, divisor, "div_tmp");
+    } else {
+        auto intrinsic = op == Op::ADD ? llvm::Intrinsic::sadd_with_overflow
+                       : op == Op::SUBTRACT ? llvm::Intrinsic::ssub_with_overflow
+                       : llvm::Intrinsic::smul_with_overflow;
+        auto function = llvm::Intrinsic::getDeclaration(current_function_->getParent(), intrinsic, {left->getType()});
+        auto result = builder_->CreateCall(function, {left, right});
+        value = builder_->CreateExtractValue(result, 0);
+        error = builder_->CreateExtractValue(result, 1);
+    }
+    if (null) {
+        error = builder_->CreateAnd(error, builder_->CreateNot(null));
+    }
+    if (kernel_active_) {
+        error = builder_->CreateAnd(error, kernel_active_);
+    }
+    kernel_error_ = builder_->CreateOr(kernel_error_, error);
+    return value;
 }
 
 void LLVMCodeGenerator::visit(BinaryExpression& node) {
     // Visit left operand
     node.left->accept(*this);
     llvm::Value* left = current_value_;
+    llvm::Value* left_null = current_null_;
+    DataType left_type = current_type_;
     
     // Visit right operand
     node.right->accept(*this);
     llvm::Value* right = current_value_;
+    llvm::Value* right_null = current_null_;
+    DataType right_type = current_type_;
+    
+    using Op = BinaryExpression::Operator;
+    current_null_ = propagateNull(left_null, right_null);
+    if (node.op == Op::AND || node.op == Op::OR) {
+        // Three-valued logic: FALSE AND NULL is FALSE and TRUE OR NULL is
+        // TRUE, so a known operand decides the result; otherwise a NULL
+        // operand makes it NULL
+        bool is_and = node.op == Op::AND;
+        auto known = [&](llvm::Value* value, llvm::Value* null) {
+            llvm::Value* decides = is_and ? builder_->CreateNot(value) : value;
+            return null ? builder_->CreateAnd(decides, builder_->CreateNot(null)) : decides;
+        };
+        if (current_null_) {
+            llvm::Value* decided = builder_->CreateOr(known(left, left_null), known(right, right_null));
+            current_null_ = builder_->CreateAnd(current_null_, builder_->CreateNot(decided));
+            current_value_ = is_and ? builder_->CreateNot(decided, "and_tmp") : decided;
+        } else {
+            current_value_ = is_and ? builder_->CreateAnd(left, right, "and_tmp")
+                                    : builder_->CreateOr(left, right, "or_tmp");
+        }
+        current_type_ = DataType::BOOLEAN;
+        return;
+    }
+    
+    // Mixed INTEGER/REAL operands are computed in floating point
+    DataType type = left_type;
+    if (left_type != right_type) {
+        type = DataType::REAL;
+        if (left_type == DataType::INTEGER) {
+            left = builder_->CreateSIToFP(left, laneType(double_type_));
+        }
+        if (right_type == DataType::INTEGER) {
+            right = builder_->CreateSIToFP(right, laneType(double_type_));
+        }
+    }
     
     // Generate operation based on operator
     switch (node.op) {
-        case BinaryExpression::Operator::ADD:
-            current_value_ = builder_->CreateAdd(left, right, "add_tmp");
-            break;
-        case BinaryExpression::Operator::SUBTRACT:
-            current_value_ = builder_->CreateSub(left, right, "sub_tmp");
-            break;
-        case BinaryExpression::Operator::MULTIPLY:
-            current_value_ = builder_->CreateMul(left, right, "mul_tmp");
-            break;
-        case BinaryExpression::Operator::DIVIDE:
-            current_value_ = builder_->CreateSDiv(left, right, "div_tmp");
-            break;
-        case BinaryExpression::Operator::EQUAL:
-            current_value_ = builder_->CreateICmpEQ(left, right, "eq_tmp");
-            break;
-        case BinaryExpression::Operator::NOT_EQUAL:
-            current_value_ = builder_->CreateICmpNE(left, right, "ne_tmp");
+        case Op::ADD:
+        case Op::SUBTRACT:
+        case Op::MULTIPLY:
+        case Op::DIVIDE:
+            if (type == DataType::INTEGER) {
+                current_value_ = checkedArithmetic(node.op, left, right, current_null_);
+            } else if (node.op == Op::ADD) {
+                current_value_ = builder_->CreateFAdd(left, right, "add_tmp");
+            } else if (node.op == Op::SUBTRACT) {
+                current_value_ = builder_->CreateFSub(left, right, "sub_tmp");
+            } else if (node.op == Op::MULTIPLY) {
+                current_value_ = builder_->CreateFMul(left, right, "mul_tmp");
+            } else {
+                current_value_ = builder_->CreateFDiv(left, right, "div_tmp");
+            }
+            current_type_ = type;
+            return;
+        default:
             break;
-        case BinaryExpression::Operator::LESS_THAN:
-            current_value_ = builder_->CreateICmpSLT(left, right, "lt_tmp");
+    }
+    
+    // Comparisons match Value's operators: REAL >, >= and != are true for
+    // NaN operands, INTEGER compares signed and BOOLEAN as false < true
+    llvm::CmpInst::Predicate predicate;
+    bool real = type == DataType::REAL;
+    bool integer = type == DataType::INTEGER;
+    switch (node.op) {
+        case Op::EQUAL:
+            predicate = real ? llvm::CmpInst::FCMP_OEQ : llvm::CmpInst::ICMP_EQ;
             break;
-        case BinaryExpression::Operator::LESS_EQUAL:
-            current_value_ = builder_->CreateICmpSLE(left, right, "le_tmp");
+        case Op::NOT_EQUAL:
+            predicate = real ? llvm::CmpInst::FCMP_UNE : llvm::CmpInst::ICMP_NE;
             break;
-        case BinaryExpression::Operator::GREATER_THAN:
-            current_value_ = builder_->CreateICmpSGT(left, right, "gt_tmp");
+        case Op::LESS_THAN:
+            predicate = real ? llvm::CmpInst::FCMP_OLT : integer ? llvm::CmpInst::ICMP_SLT : llvm::CmpInst::ICMP_ULT;
             break;
-        case BinaryExpression::Operator::GREATER_EQUAL:
-            current_value_ = builder_->CreateICmpSGE(left, right, "ge_tmp");
+        case Op::LESS_EQUAL:
+            predicate = real ? llvm::CmpInst::FCMP_OLE : integer ? llvm::CmpInst::ICMP_SLE : llvm::CmpInst::ICMP_ULE;
             break;
-        case BinaryExpression::Operator::AND:
-            current_value_ = builder_->CreateAnd(left, right, "and_tmp");
+        case Op::GREATER_THAN:
+            predicate = real ? llvm::CmpInst::FCMP_UGT : integer ? llvm::CmpInst::ICMP_SGT : llvm::CmpInst::ICMP_UGT;
             break;
-        case BinaryExpression::Operator::OR:
-            current_value_ = builder_->CreateOr(left, right, "or_tmp");
+        default:
+            predicate = real ? llvm::CmpInst::FCMP_UGE : integer ? llvm::CmpInst::ICMP_SGE : llvm::CmpInst::ICMP_UGE;
             break;
     }
+    current_value_ = real ? builder_->CreateFCmp(predicate, left, right, "cmp_tmp")
+                          : builder_->CreateICmp(predicate, left, right, "cmp_tmp");
+    current_type_ = DataType::BOOLEAN;
 }
 
 void LLVMCodeGenerator::visit(UnaryExpression& node) {
@@ -160,72 +360,783 @@ void LLVMCodeGenerator::visit(UnaryExpression& node) {
             current_value_ = builder_->CreateNot(operand, "not_tmp");
             break;
         case UnaryExpression::Operator::MINUS:
-            current_value_ = builder_->CreateNeg(operand, "neg_tmp");
+            if (current_type_ == DataType::INTEGER) {
+                current_value_ = checkedArithmetic(BinaryExpression::Operator::SUBTRACT,
+                                                   llvm::Constant::getNullValue(operand->getType()), operand,
+                                                   current_null_);
+            } else {
+                current_value_ = builder_->CreateFNeg(operand, "neg_tmp");
+            }
             break;
     }
 }
 
-void LLVMCodeGenerator::visit(SelectStatement& node) {
-    // Get the table
-    current_table_ = current_database_->getTable(node.from_table);
-    if (!current_table_) {
-        throw std::runtime_error("Table not found: " + node.from_table);
+void LLVMCodeGenerator::visit(AggregateExpression& node) {
+    // Aggregates are computed by the hash aggregation operator
+    current_value_ = llvm::ConstantInt::get(int64_type_, 0);
+    current_type_ = DataType::INTEGER;
+    current_null_ = nullptr;
+}
+
+std::optional<DataType> LLVMCodeGenerator::kernelType(Expression& expr, SelectState& state) {
+    auto numeric = [](DataType type) { return type == DataType::INTEGER || type == DataType::REAL; };
+    
+    if (auto literal = dynamic_cast<LiteralExpression*>(&expr)) {
+        DataType type = literal->value.getType();
+        if (type == DataType::TEXT || type == DataType::NULL_TYPE) {
+            return std::nullopt;
+        }
+        return type;
     }
     
-    // Create a function for the SELECT query
-    auto void_type = llvm::Type::getVoidTy(*context_);
-    auto select_func_type = llvm::FunctionType::get(void_type, {}, false);
-    current_function_ = createFunction("select_query", select_func_type);
+    if (auto column = dynamic_cast<ColumnExpression*>(&expr)) {
+        auto index = findColumn(row_layout_, column->table_name, column->column_name);
+        if (!index) {
+            return std::nullopt;
+        }
+        DataType type = state.table->getSchema().getColumn(*index).type;
+        if (type == DataType::TEXT) {
+            return std::nullopt;
+        }
+        auto slot = std::find(state.kernel_columns.begin(), state.kernel_columns.end(), *index);
+        if (slot == state.kernel_columns.end()) {
+            slot = state.kernel_columns.insert(slot, *index);
+        }
+        kernel_slots_[&expr] = {static_cast<size_t>(slot - state.kernel_columns.begin()), type};
+        return type;
+    }
+    
+    if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        auto type = kernelType(*unary->operand, state);
+        if (!type) {
+            return std::nullopt;
+        }
+        if (unary->op == UnaryExpression::Operator::NOT) {
+            return *type == DataType::BOOLEAN ? type : std::nullopt;
+        }
+        return numeric(*type) ? type : std::nullopt;
+    }
+    
+    if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        auto left = kernelType(*binary->left, state);
+        auto right = kernelType(*binary->right, state);
+        if (!left || !right) {
+            return std::nullopt;
+        }
+        switch (binary->op) {
+            case BinaryExpression::Operator::ADD:
+            case BinaryExpression::Operator::SUBTRACT:
+            case BinaryExpression::Operator::MULTIPLY:
+            case BinaryExpression::Operator::DIVIDE:
+                if (!numeric(*left) || !numeric(*right)) {
+                    return std::nullopt;
+                }
+                return *left == *right ? *left : DataType::REAL;
+            case BinaryExpression::Operator::AND:
+            case BinaryExpression::Operator::OR:
+                if (*left != DataType::BOOLEAN || *right != DataType::BOOLEAN) {
+                    return std::nullopt;
+                }
+                return DataType::BOOLEAN;
+            default:
+                if (*left != *right && !(numeric(*left) && numeric(*right))) {
+                    return std::nullopt;
+                }
+                return DataType::BOOLEAN;
+        }
+    }
+    
+    // Aggregates and anything else stay in the interpreter, which also
+    // reports type errors
+    return std::nullopt;
+}
+
+bool LLVMCodeGenerator::createFilterKernel(SelectState& state) {
+    // where_filter(columns, nulls, rows, selection) evaluates WHERE for a
+    // batch of rows and writes the indexes of the matching ones (TRUE, not
+    // NULL) to selection. Each row ORs the error flags of its checked
+    // arithmetic into one flag that is tested once after the loop: the
+    // kernel returns the match count, or -1 if any row failed, and the
+    // interpreter then re-evaluates the batch to report the error. Only the
+    // cold exit depends on the flag, so the loop body stays branch-free.
+    //
+    // In VECTOR mode each iteration handles kVectorWidth rows: values are
+    // <kVectorWidth x T> vectors, a chunk's NULL flags are one bitmap byte,
+    // and the rows past the end of the batch are masked off.
+    SelectStatement& node = *state.node;
+    kernel_slots_.clear();
+    state.kernel_columns.clear();
+    std::optional<DataType> type;
+    try {
+        type = kernelType(*node.where_clause, state);
+    } catch (const std::exception&) {
+        // e.g. an ambiguous column; the interpreter reports it
+        type.reset();
+    }
+    if (type != DataType::BOOLEAN) {
+        kernel_slots_.clear();
+        state.kernel_columns.clear();
+        return false;
+    }
+    
+    kernel_width_ = kernel_mode_ == KernelMode::VECTOR ? kVectorWidth : 1;
+    auto int32_type = llvm::Type::getInt32Ty(*context_);
+    auto int64_ptr_type = llvm::PointerType::get(int64_type_, 0);
+    auto kernel_type = llvm::FunctionType::get(int64_type_,
+                                               {llvm::PointerType::get(int64_ptr_type, 0),
+                                                llvm::PointerType::get(ptr_type_, 0), int64_type_,
+                                                llvm::PointerType::get(int32_type, 0)},
+                                               false);
+    state.where_kernel_name = "where_filter";
+    current_function_ = llvm::Function::Create(kernel_type, llvm::Function::ExternalLinkage, state.where_kernel_name,
+                                               &pipelineModule(state.scan_pipeline));
+    llvm::Value* columns = current_function_->getArg(0);
+    llvm::Value* nulls = current_function_->getArg(1);
+    llvm::Value* rows = current_function_->getArg(2);
+    llvm::Value* selection = current_function_->getArg(3);
+    current_function_->addParamAttr(0, llvm::Attribute::NoAlias);
+    current_function_->addParamAttr(1, llvm::Attribute::NoAlias);
+    current_function_->addParamAttr(3, llvm::Attribute::NoAlias);
+    
+    auto entry = llvm::BasicBlock::Create(*context_, "entry", current_function_);
+    auto check = llvm::BasicBlock::Create(*context_, "check", current_function_);
+    auto body = llvm::BasicBlock::Create(*context_, "body", current_function_);
+    auto done = llvm::BasicBlock::Create(*context_, "done", current_function_);
+    auto failed = llvm::BasicBlock::Create(*context_, "failed", current_function_);
+    auto finished = llvm::BasicBlock::Create(*context_, "finished", current_function_);
     
-    llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context_, "entry", current_function_);
     builder_->SetInsertPoint(entry);
+    kernel_columns_.clear();
+    kernel_nulls_.clear();
+    const Schema& schema = state.table->getSchema();
+    for (size_t slot = 0; slot < state.kernel_columns.size(); ++slot) {
+        auto index = llvm::ConstantInt::get(int64_type_, slot);
+        kernel_columns_.push_back(builder_->CreateLoad(int64_ptr_type, builder_->CreateGEP(int64_ptr_type, columns, index)));
+        // NOT NULL columns have no bitmap
+        kernel_nulls_.push_back(schema.getColumn(state.kernel_columns[slot]).nullable
+                                    ? builder_->CreateLoad(ptr_type_, builder_->CreateGEP(ptr_type_, nulls, index))
+                                    : nullptr);
+    }
+    builder_->CreateBr(check);
+    
+    // The error flag is accumulated per lane and reduced after the loop
+    builder_->SetInsertPoint(check);
+    auto row = builder_->CreatePHI(int64_type_, 2, "row");
+    auto count = builder_->CreatePHI(int64_type_, 2, "count");
+    auto error = builder_->CreatePHI(laneType(bool_type_), 2, "error");
+    row->addIncoming(llvm::ConstantInt::get(int64_type_, 0), entry);
+    count->addIncoming(llvm::ConstantInt::get(int64_type_, 0), entry);
+    error->addIncoming(llvm::ConstantInt::getFalse(laneType(bool_type_)), entry);
+    builder_->CreateCondBr(builder_->CreateICmpSLT(row, rows), body, done);
+    
+    builder_->SetInsertPoint(body);
+    kernel_row_ = row;
+    kernel_active_ = nullptr;
+    if (kernel_width_ > 1) {
+        std::vector<llvm::Constant*> offsets;
+        for (unsigned lane = 0; lane < kernel_width_; ++lane) {
+            offsets.push_back(llvm::ConstantInt::get(int64_type_, lane));
+        }
+        auto lanes = builder_->CreateAdd(builder_->CreateVectorSplat(kernel_width_, row),
+                                         llvm::ConstantVector::get(offsets));
+        kernel_active_ = builder_->CreateICmpSLT(lanes, builder_->CreateVectorSplat(kernel_width_, rows), "active");
+    }
+    kernel_error_ = llvm::ConstantInt::getFalse(laneType(bool_type_));
+    node.where_clause->accept(*this);
+    llvm::Value* match = current_value_;
+    if (current_null_) {
+        match = builder_->CreateAnd(match, builder_->CreateNot(current_null_));
+    }
+    if (kernel_active_) {
+        match = builder_->CreateAnd(match, kernel_active_);
+    }
+    
+    // Each row's index is stored unconditionally and only kept if it matched
+    llvm::Value* next_count = count;
+    for (unsigned lane = 0; lane < kernel_width_; ++lane) {
+        llvm::Value* lane_row = builder_->CreateAdd(row, llvm::ConstantInt::get(int64_type_, lane));
+        llvm::Value* lane_match = kernel_width_ > 1 ? builder_->CreateExtractElement(match, lane) : match;
+        builder_->CreateStore(builder_->CreateTrunc(lane_row, int32_type),
+                              builder_->CreateGEP(int32_type, selection, next_count));
+        next_count = builder_->CreateAdd(next_count, builder_->CreateZExt(lane_match, int64_type_));
+    }
+    auto next_error = builder_->CreateOr(error, kernel_error_);
+    auto next_row = builder_->CreateAdd(row, llvm::ConstantInt::get(int64_type_, kernel_width_));
+    row->addIncoming(next_row, builder_->GetInsertBlock());
+    count->addIncoming(next_count, builder_->GetInsertBlock());
+    error->addIncoming(next_error, builder_->GetInsertBlock());
+    builder_->CreateBr(check);
+    
+    builder_->SetInsertPoint(done);
+    llvm::Value* any_error = error;
+    if (kernel_width_ > 1) {
+        any_error = builder_->CreateOrReduce(error);
+    }
+    llvm::MDBuilder weights(*context_);
+    builder_->CreateCondBr(any_error, failed, finished, weights.createBranchWeights(1, 1 << 20));
+    builder_->SetInsertPoint(failed);
+    builder_->CreateRet(llvm::ConstantInt::get(int64_type_, -1));
+    builder_->SetInsertPoint(finished);
+    builder_->CreateRet(count);
+    
+    kernel_row_ = nullptr;
+    kernel_active_ = nullptr;
+    kernel_error_ = nullptr;
+    kernel_width_ = 1;
+    kernel_columns_.clear();
+    kernel_nulls_.clear();
+    return true;
+}
+
+namespace {
+
+// Splits an AND chain into its conjuncts
+void collectConjuncts(Expression& expr, std::vector<Expression*>& conjuncts) {
+    auto binary = dynamic_cast<BinaryExpression*>(&expr);
+    if (binary && binary->op == BinaryExpression::Operator::AND) {
+        collectConjuncts(*binary->left, conjuncts);
+        collectConjuncts(*binary->right, conjuncts);
+    } else {
+        conjuncts.push_back(&expr);
+    }
+}
+
+void collectColumns(Expression& expr, std::vector<ColumnExpression*>& columns) {
+    if (auto column = dynamic_cast<ColumnExpression*>(&expr)) {
+        columns.push_back(column);
+    } else if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        collectColumns(*binary->left, columns);
+        collectColumns(*binary->right, columns);
+    } else if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        collectColumns(*unary->operand, columns);
+    } else if (auto aggregate = dynamic_cast<AggregateExpression*>(&expr)) {
+        if (aggregate->argument) {
+            collectColumns(*aggregate->argument, columns);
+        }
+    }
+}
+
+// Literal operand of a pushed-down comparison (a negated number counts)
+std::optional<Value> comparisonLiteral(Expression& expr) {
+    if (auto literal = dynamic_cast<LiteralExpression*>(&expr)) {
+        if (literal->value.isNull()) return std::nullopt;
+        return literal->value;
+    }
+    auto unary = dynamic_cast<UnaryExpression*>(&expr);
+    auto literal = unary && unary->op == UnaryExpression::Operator::MINUS
+        ? dynamic_cast<LiteralExpression*>(unary->operand.get()) : nullptr;
+    if (literal && literal->value.holds<int64_t>()) {
+        return Value(-literal->value.get<int64_t>());
+    }
+    if (literal && literal->value.holds<double>()) {
+        return Value(-literal->value.get<double>());
+    }
+    return std::nullopt;
+}
+
+std::optional<ScanFilter::Op> filterOp(BinaryExpression::Operator op, bool flipped) {
+    using Op = ScanFilter::Op;
+    switch (op) {
+        case BinaryExpression::Operator::EQUAL: return Op::EQUAL;
+        case BinaryExpression::Operator::NOT_EQUAL: return Op::NOT_EQUAL;
+        case BinaryExpression::Operator::LESS_THAN: return flipped ? Op::GREATER_THAN : Op::LESS_THAN;
+        case BinaryExpression::Operator::LESS_EQUAL: return flipped ? Op::GREATER_EQUAL : Op::LESS_EQUAL;
+        case BinaryExpression::Operator::GREATER_THAN: return flipped ? Op::LESS_THAN : Op::GREATER_THAN;
+        case BinaryExpression::Operator::GREATER_EQUAL: return flipped ? Op::LESS_EQUAL : Op::GREATER_EQUAL;
+        default: return std::nullopt;
+    }
+}
+
+} // namespace
+
+void LLVMCodeGenerator::visit(SelectStatement& node) {
+    select_ = std::make_unique<SelectState>();
+    SelectState& state = *select_;
+    state.node = &node;
+    
+    // Resolve the FROM table; system tables are snapshotted for the duration of the scan
+    state.table = resolveTable(node.from_table, node.from_alias, state.snapshots);
+    row_layout_.clear();
+    const std::string& from_name = node.from_alias.empty() ? node.from_table : node.from_alias;
+    for (const auto& column : state.table->getSchema().getColumns()) {
+        row_layout_.push_back({from_name, column.name, column.type});
+    }
+    
+    state.select_all = node.select_list.size() == 1;
+    if (state.select_all) {
+        auto column = dynamic_cast<ColumnExpression*>(node.select_list[0].get());
+        state.select_all = column && column->column_name == "*";
+    }
+    
+    // Joins are executed as a pipeline of hash joins; each build side is
+    // loaded up front and spills to disk if it exceeds the memory budget
+    state.joins.resize(node.joins.size());
+    for (size_t i = 0; i < node.joins.size(); ++i) {
+        planJoin(node.joins[i], state.joins[i], state.snapshots);
+    }
+    
+    // GROUP BY and aggregates go through the spilling hash aggregator;
+    // grouped rows hold the GROUP BY keys followed by the aggregate results
+    for (auto& expr : node.select_list) {
+        collectAggregates(*expr, state.aggregates);
+    }
+    if (node.having) {
+        collectAggregates(*node.having, state.aggregates);
+    }
+    
+    group_slots_.clear();
+    if (!node.group_by.empty() || !state.aggregates.empty() || node.having) {
+        if (state.select_all) {
+            throw std::runtime_error("SELECT * cannot be used with GROUP BY or aggregates");
+        }
+        
+        std::vector<AggregateKind> kinds;
+        for (size_t i = 0; i < state.aggregates.size(); ++i) {
+            kinds.push_back(aggregateKind(*state.aggregates[i]));
+            group_slots_[state.aggregates[i]] = node.group_by.size() + i;
+        }
+        std::vector<std::string> keys;
+        for (auto& key : node.group_by) {
+            keys.push_back(expressionToString(*key));
+        }
+        for (auto& expr : node.select_list) {
+            bindGroupExpression(*expr, keys);
+        }
+        if (node.having) {
+            bindGroupExpression(*node.having, keys);
+        }
+        
+        state.aggregator = std::make_unique<HashAggregator>(node.group_by.size(), std::move(kinds),
+                                                            memory_, spill_directory_);
+    }
+    
+    // Expressions are compiled once per statement, against the layout of
+    // the rows coming out of the joins
+    if (node.where_clause) {
+        state.where = compileRowExpression(*node.where_clause, row_layout_);
+    }
+    if (state.aggregator) {
+        for (auto& key : node.group_by) {
+            state.aggregate_inputs.push_back(compileRowExpression(*key, row_layout_));
+        }
+        for (auto* aggregate : state.aggregates) {
+            state.aggregate_inputs.push_back(aggregate->argument
+                                                 ? compileRowExpression(*aggregate->argument, row_layout_)
+                                                 : ExpressionProgram());
+        }
+        for (auto& expr : node.select_list) {
+            state.projection.push_back(compileGroupExpression(*expr));
+        }
+        if (node.having) {
+            state.having = compileGroupExpression(*node.having);
+        }
+    } else if (!state.select_all) {
+        for (auto& expr : node.select_list) {
+            auto column = dynamic_cast<ColumnExpression*>(expr.get());
+            if (column && column->column_name == "*") {
+                state.projection.push_back(std::nullopt);
+            } else {
+                state.projection.push_back(compileRowExpression(*expr, row_layout_));
+            }
+        }
+    }
+    
+    // ORDER BY goes through the external sorter, which spills sorted runs
+    // to disk when the input exceeds the query memory budget. Grouped
+    // queries are sorted on their GROUP BY columns after aggregation.
+    if (!node.order_by.empty()) {
+        std::vector<SortColumn> sort_columns;
+        for (const auto& item : node.order_by) {
+            size_t index = 0;
+            if (state.aggregator) {
+                auto key = std::find_if(node.group_by.begin(), node.group_by.end(), [&](const auto& expr) {
+                    auto column = dynamic_cast<ColumnExpression*>(expr.get());
+                    return column && column->column_name == item.column &&
+                           (item.table.empty() || column->table_name.empty() || column->table_name == item.table);
+                });
+                if (key == node.group_by.end()) {
+                    throw std::runtime_error("ORDER BY column must appear in GROUP BY: " + item.column);
+                }
+                index = static_cast<size_t>(key - node.group_by.begin());
+            } else {
+                index = resolveColumn(row_layout_, item.table, item.column);
+            }
+            sort_columns.push_back({index, item.descending, item.nulls_first});
+        }
+        state.sorter = std::make_unique<ExternalSorter>(std::move(sort_columns), memory_, spill_directory_);
+    }
+    
+    state.limit = node.limit >= 0 ? static_cast<size_t>(node.limit) : SIZE_MAX;
+    
+    // Rows that passed the WHERE clause
+    state.accept = [this, &state](const Row& row) {
+        if (state.aggregator) {
+            Row input;
+            input.reserve(state.aggregate_inputs.size());
+            for (const auto& program : state.aggregate_inputs) {
+                input.push_back(program.evaluate(row));
+            }
+            state.aggregator->add(input);
+        } else if (state.sorter) {
+            state.sorter->add(row);
+        } else if (results_.size() < state.limit) {
+            emitResultRow(state, row);
+        }
+    };
+    
+    // Rows that made it through the joins
+    auto consume = [this, &state](const Row& row) {
+        if (state.node->where_clause && !evaluateWhereClause(state.where, row)) {
+            return;
+        }
+        state.accept(row);
+    };
+    
+    auto& joins = state.joins;
+    state.stage_inputs.resize(joins.size() + 1);
+    state.stage_outputs.resize(joins.size());
+    state.stage_inputs[joins.size()] = consume;
+    for (size_t i = joins.size(); i-- > 0;) {
+        JoinStage& stage = joins[i];
+        auto& next_stage = state.stage_inputs[i + 1];
+        state.stage_outputs[i] = [this, &stage, &next_stage](const Row& probe_row, const Row& build_row) {
+            Row joined = probe_row;
+            joined.insert(joined.end(), build_row.begin(), build_row.end());
+            for (const auto& condition : stage.residual) {
+                Value result = condition.evaluate(joined);
+                if (result.isNull() || result.getType() != DataType::BOOLEAN || !result.get<bool>()) {
+                    return;
+                }
+            }
+            pollInterrupt();
+            next_stage(joined);
+        };
+        auto& output = state.stage_outputs[i];
+        state.stage_inputs[i] = [this, &stage, &output](const Row& row) {
+            Row key;
+            for (const auto& program : stage.probe_keys) {
+                key.push_back(program.evaluate(row));
+            }
+            stage.join->probe(key, row, output);
+        };
+    }
+    
+    // Once a build side is empty no row can come out of the joins, so the
+    // later builds and the scan are skipped; aggregation still runs so that
+    // e.g. COUNT(*) reports zero
+    for (auto& stage : joins) {
+        pipelines_.push_back({[&state] { return !state.empty_join; },
+                              [this, &state, &stage] { state.empty_join = !loadJoin(stage); }});
+    }
+    state.scan_pipeline = pipelines_.size();
+    pipelines_.push_back({[&state] { return !state.empty_join && state.limit > 0; },
+                          [this, &state] { scanTable(state); }});
+    if (state.aggregator) {
+        pipelines_.push_back({nullptr, [this, &state] { emitGroups(state); }});
+    }
+    if (state.sorter) {
+        pipelines_.push_back({[this, &state] { return results_.size() < state.limit; },
+                              [this, &state] { emitSorted(state); }});
+    }
+    
+    // A single-table WHERE is compiled to a batch kernel in the scan's
+    // module when possible; the scan falls back to the interpreter for
+    // small tables
+    if (node.where_clause && joins.empty() && jit_) {
+        createFilterKernel(state);
+    }
+    
+    createPipelineFunctions();
+}
+
+void LLVMCodeGenerator::scanTable(SelectState& state) {
+    if (!state.where_kernel_name.empty() && state.compiled.module && state.table->getRows().size() >= kBatchSize) {
+        scanBatches(state);
+        return;
+    }
+    
+    // Without joins, sorting or grouping the scan stops once LIMIT rows are produced
+    bool streaming = state.joins.empty() && !state.sorter && !state.aggregator;
+    for (const auto& row : state.table->getRows()) {
+        if (streaming && results_.size() >= state.limit) {
+            break;
+        }
+        ++rows_scanned_;
+        pollInterrupt();
+        state.stage_inputs[0](row);
+    }
+    
+    // Joins that spilled produce the rest of their matches partition by partition
+    for (size_t i = 0; i < state.joins.size(); ++i) {
+        state.joins[i].join->finish(state.stage_outputs[i]);
+        state.joins[i].join.reset();
+    }
+}
+
+void LLVMCodeGenerator::scanBatches(SelectState& state) {
+    // The scan proceeds in morsels of kBatchSize rows. The kernel's module
+    // is only compiled when the kernel is looked up, so the lookup compiles
+    // it on the JIT's compile threads while the first morsels are
+    // interpreted; every morsel after it is ready goes through the kernel.
+    // The scan never waits for the compile, even when it ends first.
+    //
+    // The kernel reads each column as an array of 64-bit words: INTEGER as
+    // is, REAL as its bit pattern and BOOLEAN as 0/1. Nullable columns also
+    // get a NULL bitmap (one bit per row, set = NULL) and hold 0 for NULLs;
+    // NOT NULL columns get none and the kernel never tests them.
+    const auto& rows = state.table->getRows();
+    const Schema& schema = state.table->getSchema();
+    size_t slots = state.kernel_columns.size();
+    std::vector<std::vector<int64_t>> column_data(slots, std::vector<int64_t>(kBatchSize));
+    std::vector<std::vector<uint8_t>> null_data(slots);
+    std::vector<int64_t*> columns;
+    std::vector<uint8_t*> nulls;
+    for (size_t slot = 0; slot < slots; ++slot) {
+        columns.push_back(column_data[slot].data());
+        if (schema.getColumn(state.kernel_columns[slot]).nullable) {
+            null_data[slot].resize(kBatchSize / 8);
+        }
+        nulls.push_back(null_data[slot].empty() ? nullptr : null_data[slot].data());
+    }
+    std::vector<int32_t> selection(kBatchSize);
+    bool streaming = !state.sorter && !state.aggregator;
+    
+    // Filled in by the lookup, which may finish after the scan has ended
+    struct KernelLookup {
+        std::mutex mutex;
+        bool done = false;
+        FilterKernel kernel = nullptr;
+    };
+    auto lookup = std::make_shared<KernelLookup>();
+    jit_->lookupFunction(state.compiled, state.where_kernel_name, [lookup](void* address, const std::string&) {
+        std::lock_guard<std::mutex> lock(lookup->mutex);
+        lookup->kernel = reinterpret_cast<FilterKernel>(address);
+        lookup->done = true;
+    });
+    FilterKernel kernel = nullptr;
+    bool lookup_pending = true;
     
-    // For simplicity, just iterate through rows and apply WHERE clause
-    // In a real implementation, this would be more sophisticated
+    // Returns false once LIMIT is reached
+    auto interpret = [&](size_t start, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (streaming && results_.size() >= state.limit) {
+                return false;
+            }
+            ++rows_scanned_;
+            pollInterrupt();
+            const Row& row = rows[start + i];
+            if (evaluateWhereClause(state.where, row)) {
+                state.accept(row);
+            }
+        }
+        return true;
+    };
     
-    // Simple interpretation for demonstration
-    const auto& rows = current_table_->getRows();
-    for (const auto& row : rows) {
-        bool include_row = true;
+    for (size_t start = 0; start < rows.size(); start += kBatchSize) {
+        if (streaming && results_.size() >= state.limit) {
+            break;
+        }
+        size_t count = std::min(kBatchSize, rows.size() - start);
+        if (lookup_pending) {
+            std::lock_guard<std::mutex> lock(lookup->mutex);
+            if (lookup->done) {
+                // A kernel that failed to compile leaves the scan interpreted
+                lookup_pending = false;
+                kernel = lookup->kernel;
+                if (!kernel) {
+                    jit_stats_.kernel_compile_errors.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+        if (!kernel) {
+            jit_stats_.morsels_interpreted.fetch_add(1, std::memory_order_relaxed);
+            if (!interpret(start, count)) {
+                return;
+            }
+            continue;
+        }
+        jit_stats_.morsels_compiled.fetch_add(1, std::memory_order_relaxed);
+        
+        for (size_t slot = 0; slot < slots; ++slot) {
+            size_t index = state.kernel_columns[slot];
+            DataType type = schema.getColumn(index).type;
+            int64_t* data = columns[slot];
+            if (nulls[slot]) {
+                std::fill(null_data[slot].begin(), null_data[slot].end(), 0);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                const Value& value = rows[start + i][index];
+                if (value.isNull()) {
+                    nulls[slot][i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+                    data[i] = 0;
+                } else if (type == DataType::REAL) {
+                    double real = value.get<double>();
+                    std::memcpy(&data[i], &real, sizeof(real));
+                } else if (type == DataType::BOOLEAN) {
+                    data[i] = value.get<bool>() ? 1 : 0;
+                } else {
+                    data[i] = value.get<int64_t>();
+                }
+            }
+        }
         
-        // Apply WHERE clause if present
-        if (node.where_clause) {
-            // For simplicity, we'll evaluate this in C++ rather than LLVM
-            // In a full implementation, this would be JIT compiled
-            include_row = evaluateWhereClause(*node.where_clause, row);
+        int64_t matches = kernel(columns.data(), nulls.data(), static_cast<int64_t>(count), selection.data());
+        if (matches < 0) {
+            // A row failed: the interpreter evaluates the morsel and throws
+            // the row's error
+            if (!interpret(start, count)) {
+                return;
+            }
+            continue;
         }
         
-        if (include_row) {
-            results_.push_back(row);
+        // A batch is large enough to check for cancellation every time
+        rows_scanned_ += count;
+        if (control_) {
+            control_->checkInterrupt();
+        }
+        for (int64_t i = 0; i < matches; ++i) {
+            if (streaming && results_.size() >= state.limit) {
+                return;
+            }
+            state.accept(rows[start + static_cast<size_t>(selection[i])]);
+        }
+    }
+}
+
+void LLVMCodeGenerator::emitGroups(SelectState& state) {
+    state.aggregator->finish();
+    Row group_row;
+    while (state.aggregator->next(group_row)) {
+        pollInterrupt();
+        if (state.node->having) {
+            Value result = state.having.evaluate(group_row);
+            if (result.isNull()) {
+                continue;
+            }
+            if (result.getType() != DataType::BOOLEAN) {
+                throw std::runtime_error("HAVING clause must evaluate to a boolean");
+            }
+            if (!result.get<bool>()) {
+                continue;
+            }
+        }
+        if (state.sorter) {
+            state.sorter->add(std::move(group_row));
+        } else if (results_.size() < state.limit) {
+            emitGroupRow(state, group_row);
+        }
+    }
+}
+
+void LLVMCodeGenerator::emitSorted(SelectState& state) {
+    state.sorter->finish();
+    Row row;
+    while (results_.size() < state.limit && state.sorter->next(row)) {
+        pollInterrupt();
+        if (state.aggregator) {
+            emitGroupRow(state, row);
+        } else {
+            emitResultRow(state, row);
         }
     }
+}
+
+void LLVMCodeGenerator::createPipelineFunctions() {
+    // select_query(executor) asks the runtime whether each pipeline is
+    // still needed and, if so, runs it
+    auto void_type = llvm::Type::getVoidTy(*context_);
+    auto int32_type = llvm::Type::getInt32Ty(*context_);
+    auto pipeline_type = llvm::FunctionType::get(void_type, {ptr_type_}, false);
+    auto needed_type = llvm::FunctionType::get(int32_type, {ptr_type_, int64_type_}, false);
+    auto run_type = llvm::FunctionType::get(void_type, {ptr_type_, int64_type_}, false);
     
+    entry_function_ = "select_query";
+    current_function_ = createFunction(entry_function_, pipeline_type);
+    llvm::Value* executor = current_function_->getArg(0);
+    auto needed_func = module_->getOrInsertFunction("sql_pipeline_needed", needed_type);
+    auto run_func = module_->getOrInsertFunction("sql_run_pipeline", run_type);
+    
+    builder_->SetInsertPoint(llvm::BasicBlock::Create(*context_, "entry", current_function_));
+    for (size_t i = 0; i < pipelines_.size(); ++i) {
+        std::string name = "pipeline_" + std::to_string(i);
+        auto index = llvm::ConstantInt::get(int64_type_, i);
+        
+        auto run_block = llvm::BasicBlock::Create(*context_, "run_" + name, current_function_);
+        auto next_block = llvm::BasicBlock::Create(*context_, "after_" + name, current_function_);
+        auto needed = builder_->CreateCall(needed_func, {executor, index});
+        builder_->CreateCondBr(builder_->CreateICmpNE(needed, llvm::ConstantInt::get(int32_type, 0)),
+                               run_block, next_block);
+        builder_->SetInsertPoint(run_block);
+        builder_->CreateCall(run_func, {executor, index});
+        builder_->CreateBr(next_block);
+        builder_->SetInsertPoint(next_block);
+    }
     builder_->CreateRetVoid();
 }
 
+bool LLVMCodeGenerator::pipelineNeeded(size_t pipeline) {
+    const auto& needed = pipelines_.at(pipeline).needed;
+    return !needed || needed();
+}
+
+void LLVMCodeGenerator::runPipeline(size_t pipeline) {
+    pipelines_.at(pipeline).run();
+}
+
 void LLVMCodeGenerator::visit(InsertStatement& node) {
     // Get the table
     current_table_ = current_database_->getTable(node.table_name);
     if (!current_table_) {
+        if (current_database_->hasVirtualTable(node.table_name)) {
+            throw std::runtime_error("Cannot insert into system table: " + node.table_name);
+        }
         throw std::runtime_error("Table not found: " + node.table_name);
     }
     
-    // For simplicity, execute the insert directly
+    // For simplicity, execute the insert directly; the rows are stored
+    // together once all of them are built. Literals are stored as they
+    // are, other values (e.g. -1, 2 * 3) go through an expression program.
+    auto no_columns = [](const Expression& expr) -> std::optional<ExpressionProgram::Slot> {
+        if (dynamic_cast<const ColumnExpression*>(&expr)) {
+            throw std::runtime_error("Column references are not allowed in INSERT values");
+        }
+        if (dynamic_cast<const AggregateExpression*>(&expr)) {
+            throw std::runtime_error("Aggregate functions are not allowed here");
+        }
+        return std::nullopt;
+    };
+    const Row no_row;
+    std::vector<Row> rows;
+    rows.reserve(node.values.size());
     for (const auto& value_list : node.values) {
+        pollInterrupt();
         Row row;
+        row.reserve(value_list.size());
         for (const auto& expr : value_list) {
-            // Evaluate expression to get value
             if (auto literal = dynamic_cast<LiteralExpression*>(expr.get())) {
                 row.push_back(literal->value);
             } else {
-                throw std::runtime_error("Complex expressions in INSERT not yet supported");
+                row.push_back(ExpressionProgram::compile(*expr, no_columns).evaluate(no_row));
             }
         }
-        current_table_->insertRow(std::move(row));
+        rows.push_back(std::move(row));
     }
+    size_t count = rows.size();
+    current_table_->insertRows(std::move(rows));
+    rows_inserted_ = count;
 }
 
 void LLVMCodeGenerator::visit(CreateTableStatement& node) {
+    if (!node.source_path.empty()) {
+        // The reader is shared by every scan of the external table
+        auto reader = std::make_shared<ColumnarFileReader>(node.source_path);
+        current_database_->registerExternalTable(
+            node.table_name, reader->getSchema(),
+            [reader](const ScanRequest& request) { return reader->scan(request); }, node.source_path);
+        return;
+    }
+    
     Schema schema;
     for (const auto& col : node.columns) {
         schema.addColumn(col);
@@ -234,9 +1145,302 @@ void LLVMCodeGenerator::visit(CreateTableStatement& node) {
 }
 
 void LLVMCodeGenerator::visit(DropTableStatement& node) {
+    if (materialized_views_) {
+        if (materialized_views_->get(node.table_name)) {
+            throw std::runtime_error(node.table_name + " is a materialized view; use DROP MATERIALIZED VIEW");
+        }
+        if (auto view = materialized_views_->findDependent(node.table_name)) {
+            throw std::runtime_error("Cannot drop table " + node.table_name + ": materialized view " +
+                                     view->getName() + " depends on it");
+        }
+    }
+    const VirtualTable* external = current_database_->getVirtualTable(node.table_name);
+    if (external && !external->getSourcePath().empty()) {
+        current_database_->dropVirtualTable(node.table_name);
+        return;
+    }
     current_database_->dropTable(node.table_name);
 }
 
+void LLVMCodeGenerator::visit(CreateMaterializedViewStatement& node) {
+    if (!materialized_views_) {
+        throw std::runtime_error("Materialized views are not available");
+    }
+    materialized_views_->create(node.view_name, node.column_names, std::move(node.query));
+}
+
+void LLVMCodeGenerator::visit(DropMaterializedViewStatement& node) {
+    if (!materialized_views_) {
+        throw std::runtime_error("Materialized view not found: " + node.view_name);
+    }
+    materialized_views_->drop(node.view_name);
+}
+
+void LLVMCodeGenerator::visit(CopyStatement& node) {
+    if (node.to_file) {
+        if (node.format != CopyStatement::Format::COLUMNAR) {
+            throw std::runtime_error("COPY TO supports only FORMAT COLUMNAR");
+        }
+        std::vector<std::unique_ptr<Table>> snapshots;
+        const Table* source = current_database_->getTable(node.table_name);
+        if (!source) {
+            const VirtualTable* virtual_table = current_database_->getVirtualTable(node.table_name);
+            if (!virtual_table) {
+                throw std::runtime_error("Table not found: " + node.table_name);
+            }
+            snapshots.push_back(virtual_table->materialize());
+            source = snapshots.back().get();
+        }
+        writeColumnarFile(node.path, source->getSchema(), source->getRows());
+        rows_inserted_ = source->getRows().size();
+        return;
+    }
+    
+    Table* table = current_database_->getTable(node.table_name);
+    if (!table) {
+        if (current_database_->hasVirtualTable(node.table_name)) {
+            throw std::runtime_error("Cannot copy into system table: " + node.table_name);
+        }
+        throw std::runtime_error("Table not found: " + node.table_name);
+    }
+    
+    if (node.format == CopyStatement::Format::COLUMNAR) {
+        ColumnarFileReader reader(node.path);
+        const Schema& file_schema = reader.getSchema();
+        const Schema& table_schema = table->getSchema();
+        if (file_schema.getColumnCount() != table_schema.getColumnCount()) {
+            throw std::runtime_error("File " + node.path + " has " + std::to_string(file_schema.getColumnCount()) +
+                                     " columns, table " + node.table_name + " has " +
+                                     std::to_string(table_schema.getColumnCount()));
+        }
+        for (size_t i = 0; i < file_schema.getColumnCount(); ++i) {
+            if (file_schema.getColumn(i).type != table_schema.getColumn(i).type) {
+                throw std::runtime_error("Column " + file_schema.getColumn(i).name + " of " + node.path +
+                                         " does not match the type of column " + table_schema.getColumn(i).name);
+            }
+        }
+        std::vector<Row> rows = reader.scan(ScanRequest{});
+        size_t count = rows.size();
+        table->insertRows(std::move(rows));
+        rows_inserted_ = count;
+        return;
+    }
+    
+    CsvOptions options;
+    options.delimiter = node.delimiter;
+    options.header = node.header;
+    rows_inserted_ = copyCsvIntoTable(*table, node.path, options, control_);
+}
+
+Table* LLVMCodeGenerator::resolveTable(const std::string& name, const std::string& alias,
+                                      std::vector<std::unique_ptr<Table>>& snapshots) {
+    if (Table* table = current_database_->getTable(name)) {
+        return table;
+    }
+    const VirtualTable* virtual_table = current_database_->getVirtualTable(name);
+    if (!virtual_table) {
+        throw std::runtime_error("Table not found: " + name);
+    }
+    if (virtual_table->getSourcePath().empty()) {
+        snapshots.push_back(virtual_table->materialize());
+    } else {
+        // External tables read only the columns the query uses and skip
+        // row groups its WHERE clause rules out
+        const std::string& scan_name = alias.empty() ? name : alias;
+        snapshots.push_back(virtual_table->materialize(buildScanRequest(scan_name, virtual_table->getSchema())));
+    }
+    return snapshots.back().get();
+}
+
+ScanRequest LLVMCodeGenerator::buildScanRequest(const std::string& name, const Schema& schema) const {
+    ScanRequest request;
+    const SelectStatement& node = *select_->node;
+    
+    // A column reference belongs to this table if it is qualified with its
+    // name or alias, or unqualified and the table has such a column
+    auto own_column = [&](const std::string& table, const std::string& column) -> std::optional<size_t> {
+        if ((!table.empty() && table != name) || !schema.getColumn(column)) {
+            return std::nullopt;
+        }
+        return schema.getColumnIndex(column);
+    };
+    
+    std::vector<ColumnExpression*> references;
+    for (const auto& expr : node.select_list) collectColumns(*expr, references);
+    for (const auto& join : node.joins) collectColumns(*join.condition, references);
+    if (node.where_clause) collectColumns(*node.where_clause, references);
+    for (const auto& expr : node.group_by) collectColumns(*expr, references);
+    if (node.having) collectColumns(*node.having, references);
+    
+    request.columns.assign(schema.getColumnCount(), false);
+    for (auto* reference : references) {
+        if (reference->column_name == "*") {
+            request.columns.assign(schema.getColumnCount(), true);
+            break;
+        }
+        if (auto index = own_column(reference->table_name, reference->column_name)) {
+            request.columns[*index] = true;
+        }
+    }
+    for (const auto& item : node.order_by) {
+        if (auto index = own_column(item.table, item.column)) {
+            request.columns[*index] = true;
+        }
+    }
+    
+    // WHERE conjuncts comparing one of the table's columns with a literal;
+    // with joins, only qualified references are certain to be this table's
+    if (node.where_clause) {
+        std::vector<Expression*> conjuncts;
+        collectConjuncts(*node.where_clause, conjuncts);
+        for (auto* conjunct : conjuncts) {
+            auto binary = dynamic_cast<BinaryExpression*>(conjunct);
+            if (!binary) continue;
+            auto column = dynamic_cast<ColumnExpression*>(binary->left.get());
+            auto literal = comparisonLiteral(*binary->right);
+            bool flipped = false;
+            if (!column || !literal) {
+                column = dynamic_cast<ColumnExpression*>(binary->right.get());
+                literal = comparisonLiteral(*binary->left);
+                flipped = true;
+            }
+            auto op = filterOp(binary->op, flipped);
+            if (!column || !literal || !op || (column->table_name.empty() && !node.joins.empty())) {
+                continue;
+            }
+            if (auto index = own_column(column->table_name, column->column_name)) {
+                request.filters.push_back({*index, *op, *literal});
+            }
+        }
+    }
+    return request;
+}
+
+std::optional<size_t> LLVMCodeGenerator::findColumn(const RowLayout& layout, const std::string& table,
+                                                    const std::string& column) const {
+    std::optional<size_t> found;
+    for (size_t i = 0; i < layout.size(); ++i) {
+        if (layout[i].column != column || (!table.empty() && layout[i].table != table)) {
+            continue;
+        }
+        if (found) {
+            throw std::runtime_error("Ambiguous column: " + column);
+        }
+        found = i;
+    }
+    return found;
+}
+
+size_t LLVMCodeGenerator::resolveColumn(const RowLayout& layout, const std::string& table,
+                                        const std::string& column) const {
+    auto index = findColumn(layout, table, column);
+    if (!index) {
+        throw std::runtime_error("Column not found: " + (table.empty() ? column : table + "." + column));
+    }
+    return *index;
+}
+
+bool LLVMCodeGenerator::referencesOnly(Expression& expr, const RowLayout& layout, bool& has_columns) const {
+    if (auto column = dynamic_cast<ColumnExpression*>(&expr)) {
+        has_columns = true;
+        return findColumn(layout, column->table_name, column->column_name).has_value();
+    }
+    if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        return referencesOnly(*unary->operand, layout, has_columns);
+    }
+    if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        return referencesOnly(*binary->left, layout, has_columns) &&
+               referencesOnly(*binary->right, layout, has_columns);
+    }
+    return dynamic_cast<LiteralExpression*>(&expr) != nullptr;
+}
+
+void LLVMCodeGenerator::planJoin(JoinClause& clause, JoinStage& stage,
+                                 std::vector<std::unique_ptr<Table>>& snapshots) {
+    stage.build_table = resolveTable(clause.table, clause.alias, snapshots);
+    RowLayout& build_layout = stage.build_layout;
+    const std::string& name = clause.alias.empty() ? clause.table : clause.alias;
+    for (const auto& column : stage.build_table->getSchema().getColumns()) {
+        build_layout.push_back({name, column.name, column.type});
+    }
+    
+    stage.probe_layout = row_layout_;
+    stage.output_layout = row_layout_;
+    stage.output_layout.insert(stage.output_layout.end(), build_layout.begin(), build_layout.end());
+    
+    // Equalities between the two sides become hash keys; every other
+    // conjunct is checked on the joined rows
+    std::vector<Expression*> conjuncts;
+    collectConjuncts(*clause.condition, conjuncts);
+    std::vector<ExpressionProgram>& build_keys = stage.build_keys;
+    for (auto* conjunct : conjuncts) {
+        auto binary = dynamic_cast<BinaryExpression*>(conjunct);
+        if (binary && binary->op == BinaryExpression::Operator::EQUAL) {
+            bool left_columns = false;
+            bool right_columns = false;
+            if (referencesOnly(*binary->left, stage.probe_layout, left_columns) &&
+                referencesOnly(*binary->right, build_layout, right_columns) && left_columns && right_columns) {
+                stage.probe_keys.push_back(compileRowExpression(*binary->left, stage.probe_layout));
+                build_keys.push_back(compileRowExpression(*binary->right, build_layout));
+                continue;
+            }
+            left_columns = right_columns = false;
+            if (referencesOnly(*binary->right, stage.probe_layout, left_columns) &&
+                referencesOnly(*binary->left, build_layout, right_columns) && left_columns && right_columns) {
+                stage.probe_keys.push_back(compileRowExpression(*binary->right, stage.probe_layout));
+                build_keys.push_back(compileRowExpression(*binary->left, build_layout));
+                continue;
+            }
+        }
+        stage.residual.push_back(compileRowExpression(*conjunct, stage.output_layout));
+    }
+    if (build_keys.empty()) {
+        throw std::runtime_error("JOIN requires an equality condition between " + name + " and the preceding tables");
+    }
+    
+    stage.join = std::make_unique<HashJoin>(build_keys.size(), memory_, spill_directory_);
+    row_layout_ = stage.output_layout;
+}
+
+bool LLVMCodeGenerator::loadJoin(JoinStage& stage) {
+    bool loaded = false;
+    for (const auto& row : stage.build_table->getRows()) {
+        ++rows_scanned_;
+        pollInterrupt();
+        Row key;
+        for (const auto& program : stage.build_keys) {
+            key.push_back(program.evaluate(row));
+        }
+        stage.join->addBuild(key, row);
+        loaded = true;
+    }
+    return loaded;
+}
+
+void LLVMCodeGenerator::bindGroupExpression(Expression& expr, const std::vector<std::string>& keys) {
+    if (group_slots_.count(&expr)) {
+        return; // aggregate
+    }
+    
+    std::string text = expressionToString(expr);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] == text) {
+            group_slots_[&expr] = i;
+            return;
+        }
+    }
+    
+    if (dynamic_cast<ColumnExpression*>(&expr)) {
+        throw std::runtime_error("Column " + text + " must appear in GROUP BY or be used in an aggregate function");
+    }
+    if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        bindGroupExpression(*unary->operand, keys);
+    } else if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        bindGroupExpression(*binary->left, keys);
+        bindGroupExpression(*binary->right, keys);
+    }
+}
+
 llvm::Function* LLVMCodeGenerator::createFunction(const std::string& name, llvm::FunctionType* type) {
     return llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, module_.get());
 }
@@ -259,52 +1463,121 @@ llvm::Value* LLVMCodeGenerator::createValue(const Value& value) {
 }
 
 void LLVMCodeGenerator::compileAndExecute() {
+    if (entry_function_.empty()) {
+        // Nothing to compile (DDL, INSERT)
+        return;
+    }
     if (!jit_) {
-        // Fallback to direct execution for demonstration
+        // Fallback to direct execution
+        for (size_t i = 0; i < pipelines_.size(); ++i) {
+            if (pipelineNeeded(i)) {
+                runPipeline(i);
+            }
+        }
         return;
     }
     
-    // Add the module to JIT
-    auto tsm = llvm::orc::ThreadSafeModule(std::move(module_), std::move(context_));
-    auto err = jit_->addIRModule(std::move(tsm));
-    if (err) {
-        throw std::runtime_error("Failed to add module to JIT");
+    auto compile_start = std::chrono::steady_clock::now();
+    // All modules belong to the context handed to the JIT; pipelines
+    // without generated code have none
+    std::vector<std::unique_ptr<llvm::Module>> pipeline_modules;
+    for (auto& module : pipeline_modules_) {
+        if (module && !module->empty()) {
+            pipeline_modules.push_back(std::move(module));
+        }
+    }
+    pipeline_modules_.clear();
+    builder_.reset();
+    runtime_module_.reset();
+    auto compiled = jit_->compile(std::move(module_), std::move(pipeline_modules), std::move(context_),
+                                  entry_function_);
+    if (select_) {
+        select_->compiled = compiled;
     }
     
-    // Look up the function
-    auto symbol = jit_->lookup("select_query");
-    if (!symbol) {
-        // Function might not exist for non-SELECT statements
-        return;
+    auto compile_micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - compile_start).count();
+    last_compile_micros_ = static_cast<uint64_t>(compile_micros);
+    jit_stats_.compile_micros.fetch_add(last_compile_micros_, std::memory_order_relaxed);
+    if (compiled.source == JITCompiler::Source::COMPILED) {
+        jit_stats_.modules_compiled.fetch_add(1, std::memory_order_relaxed);
+        jit_stats_.cache_misses.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        jit_stats_.cache_hits.fetch_add(1, std::memory_order_relaxed);
+        if (compiled.source == JITCompiler::Source::OBJECT_CACHE) {
+            jit_stats_.object_cache_loads.fetch_add(1, std::memory_order_relaxed);
+        }
     }
     
-    // Execute the function
-    auto func = symbol->getValue();
-    auto func_ptr = reinterpret_cast<void(*)()>(func);
-    func_ptr();
+    // Execute the function; a kernel is compiled when the scan looks it up
+    compiled.entry(static_cast<PipelineExecutor*>(this));
+    rethrowError();
 }
 
-// Helper method for WHERE clause evaluation (simplified C++ version)
-bool LLVMCodeGenerator::evaluateWhereClause(Expression& expr, const Row& row) {
-    if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
-        bool left_val = evaluateWhereClause(*binary->left, row);
-        bool right_val = evaluateWhereClause(*binary->right, row);
-        
-        switch (binary->op) {
-            case BinaryExpression::Operator::AND:
-                return left_val && right_val;
-            case BinaryExpression::Operator::OR:
-                return left_val || right_val;
-            default:
-                return true; // Simplified
+ExpressionProgram LLVMCodeGenerator::compileRowExpression(Expression& expr, const RowLayout& layout) const {
+    return ExpressionProgram::compile(expr, [this, &layout](const Expression& node)
+                                                -> std::optional<ExpressionProgram::Slot> {
+        if (auto column = dynamic_cast<const ColumnExpression*>(&node)) {
+            size_t index = resolveColumn(layout, column->table_name, column->column_name);
+            return ExpressionProgram::Slot{index, layout[index].type};
+        }
+        if (dynamic_cast<const AggregateExpression*>(&node)) {
+            throw std::runtime_error("Aggregate functions are not allowed here");
         }
-    } else if (auto literal = dynamic_cast<LiteralExpression*>(&expr)) {
-        if (literal->value.getType() == DataType::BOOLEAN) {
-            return literal->value.get<bool>();
+        return std::nullopt;
+    });
+}
+
+ExpressionProgram LLVMCodeGenerator::compileGroupExpression(Expression& expr) const {
+    return ExpressionProgram::compile(expr, [this](const Expression& node) -> std::optional<ExpressionProgram::Slot> {
+        auto slot = group_slots_.find(&node);
+        if (slot == group_slots_.end()) {
+            return std::nullopt;
         }
+        return ExpressionProgram::Slot{slot->second, std::nullopt};
+    });
+}
+
+bool LLVMCodeGenerator::evaluateWhereClause(const ExpressionProgram& where, const Row& row) {
+    Value result = where.evaluate(row);
+    if (result.isNull()) {
+        return false;
     }
-    
-    return true; // Default to include row
+    if (result.getType() != DataType::BOOLEAN) {
+        throw std::runtime_error("WHERE clause must evaluate to a boolean");
+    }
+    return result.get<bool>();
+}
+
+void LLVMCodeGenerator::emitGroupRow(SelectState& state, const Row& group_row) {
+    Row result;
+    result.reserve(state.projection.size());
+    for (const auto& program : state.projection) {
+        result.push_back(program->evaluate(group_row));
+    }
+    if (memory_) {
+        memory_->reserve(estimateRowSize(result));
+    }
+    results_.push_back(std::move(result));
+}
+
+void LLVMCodeGenerator::emitResultRow(SelectState& state, const Row& row) {
+    Row result;
+    if (state.select_all) {
+        result = row;
+    } else {
+        for (const auto& program : state.projection) {
+            if (program) {
+                result.push_back(program->evaluate(row));
+            } else {
+                result.insert(result.end(), row.begin(), row.end());
+            }
+        }
+    }
+    if (memory_) {
+        memory_->reserve(estimateRowSize(result));
+    }
+    results_.push_back(std::move(result));
 }
 
-} // namespace sqlengine
\ No newline at end of file
+} // namespace sqlengine
@@ -0,0 +1,409 @@
+#include "materialized_view.h"
+#include "expression_eval.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace sqlengine {
+
+namespace {
+
+// Column name of a select item when the view has no column list
+std::string defaultColumnName(Expression& expr, size_t position) {
+    if (auto column = dynamic_cast<ColumnExpression*>(&expr)) {
+        return column->column_name;
+    }
+    if (auto aggregate = dynamic_cast<AggregateExpression*>(&expr)) {
+        std::string name = aggregateFunctionName(aggregate->function);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (auto argument = dynamic_cast<ColumnExpression*>(aggregate->argument.get())) {
+            name += "_" + argument->column_name;
+        } else if (aggregate->argument) {
+            name += "_" + std::to_string(position + 1);
+        }
+        return name;
+    }
+    return "column" + std::to_string(position + 1);
+}
+
+} // namespace
+
+MaterializedView::MaterializedView(std::string name, std::vector<std::string> column_names,
+                                   AstPtr<SelectStatement> definition, const Table& source)
+    : name_(std::move(name)), definition_(std::move(definition)), source_schema_(source.getSchema()) {
+    SelectStatement& query = *definition_;
+    if (!query.joins.empty()) {
+        throw std::runtime_error("Materialized views cannot contain joins");
+    }
+    if (!query.order_by.empty() || query.limit >= 0) {
+        throw std::runtime_error("Materialized views cannot contain ORDER BY or LIMIT");
+    }
+    for (auto& expr : query.select_list) {
+        auto column = dynamic_cast<ColumnExpression*>(expr.get());
+        if (column && column->column_name == "*") {
+            throw std::runtime_error("SELECT * cannot be used with GROUP BY or aggregates");
+        }
+        collectAggregates(*expr, aggregates_);
+    }
+    if (query.having) {
+        collectAggregates(*query.having, aggregates_);
+    }
+    if (query.group_by.empty() && aggregates_.empty()) {
+        throw std::runtime_error("Materialized views require GROUP BY or aggregates");
+    }
+
+    // Source-row expressions: WHERE, the GROUP BY keys and aggregate arguments
+    if (query.where_clause) {
+        bindColumns(*query.where_clause);
+    }
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < query.group_by.size(); ++i) {
+        bindColumns(*query.group_by[i]);
+        keys.push_back(expressionToString(*query.group_by[i]));
+        key_columns_.push_back({i});
+        group_types_.push_back(inferType(*query.group_by[i], false));
+    }
+    for (size_t i = 0; i < aggregates_.size(); ++i) {
+        AggregateExpression& aggregate = *aggregates_[i];
+        kinds_.push_back(aggregateKind(aggregate));
+        group_slots_[&aggregate] = query.group_by.size() + i;
+
+        DataType type = DataType::INTEGER;
+        if (aggregate.argument) {
+            bindColumns(*aggregate.argument);
+            type = inferType(*aggregate.argument, false);
+        }
+        switch (kinds_.back()) {
+            case AggregateKind::COUNT_STAR:
+            case AggregateKind::COUNT:
+                type = DataType::INTEGER;
+                break;
+            case AggregateKind::AVG:
+                type = DataType::REAL;
+                break;
+            case AggregateKind::SUM:
+                if (type != DataType::INTEGER && type != DataType::REAL) {
+                    throw std::runtime_error("SUM requires a numeric argument");
+                }
+                break;
+            default:
+                break;
+        }
+        group_types_.push_back(type);
+    }
+
+    // Group-row expressions: the select list and HAVING
+    for (auto& expr : query.select_list) {
+        bindGroupExpression(*expr, keys);
+    }
+    if (query.having) {
+        bindGroupExpression(*query.having, keys);
+    }
+
+    if (!column_names.empty() && column_names.size() != query.select_list.size()) {
+        throw std::runtime_error("Materialized view " + name_ + " has " + std::to_string(column_names.size()) +
+                                 " column names but the query returns " +
+                                 std::to_string(query.select_list.size()) + " columns");
+    }
+    std::unordered_set<std::string> seen;
+    for (size_t i = 0; i < query.select_list.size(); ++i) {
+        std::string column = column_names.empty() ? defaultColumnName(*query.select_list[i], i) : column_names[i];
+        if (!seen.insert(column).second) {
+            throw std::runtime_error("Duplicate column name in materialized view: " + column);
+        }
+        schema_.addColumn(Column(column, inferType(*query.select_list[i], true)));
+    }
+
+    if (query.where_clause) {
+        where_ = compileRowExpression(*query.where_clause);
+    }
+    for (auto& key : query.group_by) {
+        inputs_.push_back(compileRowExpression(*key));
+    }
+    for (auto* aggregate : aggregates_) {
+        inputs_.push_back(aggregate->argument ? compileRowExpression(*aggregate->argument) : ExpressionProgram());
+    }
+    if (query.having) {
+        having_ = compileGroupExpression(*query.having);
+    }
+    for (auto& expr : query.select_list) {
+        projection_.push_back(compileGroupExpression(*expr));
+    }
+}
+
+void MaterializedView::prepareInsert(const Row* rows, size_t count) {
+    pending_index_.clear();
+    pending_.clear();
+    pending_new_groups_ = 0;
+    
+    SelectStatement& query = *definition_;
+    Row input;
+    for (size_t r = 0; r < count; ++r) {
+        const Row& row = rows[r];
+        if (query.where_clause) {
+            Value result = where_.evaluate(row);
+            if (result.isNull()) {
+                continue;
+            }
+            if (result.getType() != DataType::BOOLEAN) {
+                throw std::runtime_error("WHERE clause must evaluate to a boolean");
+            }
+            if (!result.get<bool>()) {
+                continue;
+            }
+        }
+        
+        input.clear();
+        for (const auto& program : inputs_) {
+            input.push_back(program.evaluate(row));
+        }
+        
+        scratch_key_.clear();
+        encodeSortKey(input, key_columns_, scratch_key_);
+        auto pending = pending_index_.find(scratch_key_);
+        if (pending == pending_index_.end()) {
+            PendingGroup entry;
+            entry.key = scratch_key_;
+            auto it = group_index_.find(scratch_key_);
+            if (it != group_index_.end()) {
+                entry.group = it->second;
+                auto first = states_.begin() + static_cast<std::ptrdiff_t>(entry.group * aggregates_.size());
+                entry.states.assign(first, first + static_cast<std::ptrdiff_t>(aggregates_.size()));
+            } else {
+                entry.group = group_keys_.size() + pending_new_groups_++;
+                entry.keys.assign(input.begin(), input.begin() + static_cast<std::ptrdiff_t>(query.group_by.size()));
+                entry.states.resize(aggregates_.size());
+            }
+            pending = pending_index_.emplace(scratch_key_, pending_.size()).first;
+            pending_.push_back(std::move(entry));
+        }
+        
+        auto& states = pending_[pending->second].states;
+        for (size_t i = 0; i < aggregates_.size(); ++i) {
+            accumulateAggregate(kinds_[i], states[i], input[query.group_by.size() + i]);
+        }
+    }
+    
+    group_keys_.reserve(group_keys_.size() + pending_new_groups_);
+    states_.reserve(states_.size() + pending_new_groups_ * aggregates_.size());
+    group_index_.reserve(group_index_.size() + pending_new_groups_);
+}
+
+void MaterializedView::commitInsert() {
+    // New groups were numbered in the order they were first seen, which
+    // is the order they are appended in
+    for (auto& entry : pending_) {
+        if (entry.group >= group_keys_.size()) {
+            group_index_.emplace(std::move(entry.key), entry.group);
+            group_keys_.push_back(std::move(entry.keys));
+            states_.resize(states_.size() + aggregates_.size());
+        }
+        std::move(entry.states.begin(), entry.states.end(),
+                  states_.begin() + static_cast<std::ptrdiff_t>(entry.group * aggregates_.size()));
+    }
+    pending_index_.clear();
+    pending_.clear();
+    pending_new_groups_ = 0;
+}
+
+std::vector<Row> MaterializedView::getRows() const {
+    std::vector<Row> rows;
+    rows.reserve(group_keys_.size());
+    for (size_t group = 0; group < group_keys_.size(); ++group) {
+        emitGroup(group_keys_[group], &states_[group * aggregates_.size()], rows);
+    }
+
+    // An aggregate without GROUP BY returns one row even for an empty table
+    if (group_keys_.empty() && definition_->group_by.empty()) {
+        std::vector<AggregateState> empty(aggregates_.size());
+        emitGroup(Row(), empty.data(), rows);
+    }
+    return rows;
+}
+
+void MaterializedView::emitGroup(const Row& keys, const AggregateState* states, std::vector<Row>& rows) const {
+    const SelectStatement& query = *definition_;
+    Row group_row = keys;
+    for (size_t i = 0; i < aggregates_.size(); ++i) {
+        group_row.push_back(finalizeAggregate(kinds_[i], states[i]));
+    }
+
+    if (query.having) {
+        Value result = having_.evaluate(group_row);
+        if (result.isNull()) {
+            return;
+        }
+        if (result.getType() != DataType::BOOLEAN) {
+            throw std::runtime_error("HAVING clause must evaluate to a boolean");
+        }
+        if (!result.get<bool>()) {
+            return;
+        }
+    }
+
+    Row result;
+    result.reserve(projection_.size());
+    for (const auto& program : projection_) {
+        result.push_back(program.evaluate(group_row));
+    }
+    rows.push_back(std::move(result));
+}
+
+void MaterializedView::bindColumns(Expression& expr) {
+    if (auto column = dynamic_cast<ColumnExpression*>(&expr)) {
+        const SelectStatement& query = *definition_;
+        bool qualified_elsewhere = !column->table_name.empty() && column->table_name != query.from_table &&
+                                   column->table_name != query.from_alias;
+        if (qualified_elsewhere || !source_schema_.getColumn(column->column_name)) {
+            throw std::runtime_error("Column not found: " + expressionToString(expr));
+        }
+        column_slots_[&expr] = source_schema_.getColumnIndex(column->column_name);
+    } else if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        bindColumns(*unary->operand);
+    } else if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        bindColumns(*binary->left);
+        bindColumns(*binary->right);
+    } else if (dynamic_cast<AggregateExpression*>(&expr)) {
+        throw std::runtime_error("Aggregate functions are not allowed here");
+    }
+}
+
+void MaterializedView::bindGroupExpression(Expression& expr, const std::vector<std::string>& keys) {
+    if (group_slots_.count(&expr)) {
+        return; // aggregate
+    }
+
+    std::string text = expressionToString(expr);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] == text) {
+            group_slots_[&expr] = i;
+            return;
+        }
+    }
+
+    if (dynamic_cast<ColumnExpression*>(&expr)) {
+        throw std::runtime_error("Column " + text + " must appear in GROUP BY or be used in an aggregate function");
+    }
+    if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        bindGroupExpression(*unary->operand, keys);
+    } else if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        bindGroupExpression(*binary->left, keys);
+        bindGroupExpression(*binary->right, keys);
+    }
+}
+
+DataType MaterializedView::inferType(Expression& expr, bool grouped) const {
+    if (grouped) {
+        auto slot = group_slots_.find(&expr);
+        if (slot != group_slots_.end()) {
+            return group_types_[slot->second];
+        }
+    } else {
+        auto slot = column_slots_.find(&expr);
+        if (slot != column_slots_.end()) {
+            return source_schema_.getColumn(slot->second).type;
+        }
+    }
+
+    if (auto literal = dynamic_cast<LiteralExpression*>(&expr)) {
+        return literal->value.getType();
+    }
+    if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        return unary->op == UnaryExpression::Operator::NOT ? DataType::BOOLEAN : inferType(*unary->operand, grouped);
+    }
+    if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        switch (binary->op) {
+            case BinaryExpression::Operator::ADD:
+            case BinaryExpression::Operator::SUBTRACT:
+            case BinaryExpression::Operator::MULTIPLY:
+            case BinaryExpression::Operator::DIVIDE: {
+                DataType left = inferType(*binary->left, grouped);
+                DataType right = inferType(*binary->right, grouped);
+                return left == DataType::INTEGER && right == DataType::INTEGER ? DataType::INTEGER : DataType::REAL;
+            }
+            default:
+                return DataType::BOOLEAN;
+        }
+    }
+    throw std::runtime_error("Unsupported expression in materialized view");
+}
+
+ExpressionProgram MaterializedView::compileRowExpression(const Expression& expr) const {
+    return ExpressionProgram::compile(expr, [this](const Expression& node) -> std::optional<ExpressionProgram::Slot> {
+        auto slot = column_slots_.find(&node);
+        if (slot == column_slots_.end()) {
+            return std::nullopt;
+        }
+        return ExpressionProgram::Slot{slot->second, source_schema_.getColumn(slot->second).type};
+    });
+}
+
+ExpressionProgram MaterializedView::compileGroupExpression(const Expression& expr) const {
+    return ExpressionProgram::compile(expr, [this](const Expression& node) -> std::optional<ExpressionProgram::Slot> {
+        auto slot = group_slots_.find(&node);
+        if (slot == group_slots_.end()) {
+            return std::nullopt;
+        }
+        return ExpressionProgram::Slot{slot->second, group_types_[slot->second]};
+    });
+}
+
+// MaterializedViewCatalog implementation
+MaterializedViewCatalog::~MaterializedViewCatalog() {
+    for (const auto& entry : views_) {
+        if (Table* source = database_.getTable(entry.second->getSourceTable())) {
+            source->removeListener(entry.second.get());
+        }
+    }
+}
+
+void MaterializedViewCatalog::create(const std::string& name, std::vector<std::string> column_names,
+                                     AstPtr<SelectStatement> definition) {
+    if (database_.hasTable(name) || database_.hasVirtualTable(name)) {
+        throw std::runtime_error("Table already exists: " + name);
+    }
+    Table* source = database_.getTable(definition->from_table);
+    if (!source) {
+        if (database_.hasVirtualTable(definition->from_table)) {
+            throw std::runtime_error("Materialized views must read a base table: " + definition->from_table);
+        }
+        throw std::runtime_error("Table not found: " + definition->from_table);
+    }
+
+    auto view = std::make_shared<MaterializedView>(name, std::move(column_names), std::move(definition), *source);
+    view->prepareInsert(source->getRows().data(), source->getRows().size());
+    view->commitInsert();
+
+    database_.registerVirtualTable(name, view->getSchema(), [view]() { return view->getRows(); });
+    source->addListener(view);
+    views_.emplace(name, std::move(view));
+}
+
+void MaterializedViewCatalog::drop(const std::string& name) {
+    auto it = views_.find(name);
+    if (it == views_.end()) {
+        throw std::runtime_error("Materialized view not found: " + name);
+    }
+    if (Table* source = database_.getTable(it->second->getSourceTable())) {
+        source->removeListener(it->second.get());
+    }
+    database_.dropVirtualTable(name);
+    views_.erase(it);
+}
+
+const MaterializedView* MaterializedViewCatalog::get(const std::string& name) const {
+    auto it = views_.find(name);
+    return it != views_.end() ? it->second.get() : nullptr;
+}
+
+const MaterializedView* MaterializedViewCatalog::findDependent(const std::string& table) const {
+    for (const auto& entry : views_) {
+        if (entry.second->getSourceTable() == table) {
+            return entry.second.get();
+        }
+    }
+    return nullptr;
+}
+
+} // namespace sqlengine
@@ -0,0 +1,96 @@
+#include "memory_tracker.h"
+#include <cstdint>
+
+namespace sqlengine {
+
+// MemoryTracker implementation
+bool MemoryTracker::tryReserve(size_t bytes) {
+    size_t limit = getGlobalLimit();
+    size_t current = used_.load(std::memory_order_relaxed);
+    for (;;) {
+        if (limit != 0 && current + bytes > limit) {
+            return false;
+        }
+        if (used_.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    size_t now = current + bytes;
+    size_t peak = peak_.load(std::memory_order_relaxed);
+    while (now > peak && !peak_.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void MemoryTracker::release(size_t bytes) {
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+// QueryMemoryContext implementation
+QueryMemoryContext::QueryMemoryContext(MemoryTracker& global, size_t query_limit)
+    : global_(global), limit_(query_limit) {}
+
+QueryMemoryContext::~QueryMemoryContext() {
+    global_.release(granted_);
+}
+
+void QueryMemoryContext::reserve(size_t bytes) {
+    if (tryReserve(bytes)) {
+        return;
+    }
+
+    global_.recordLimitHit();
+    if (limit_ != 0 && used_ + bytes > limit_) {
+        throw MemoryLimitExceeded("Query memory limit exceeded (limit " +
+                                  std::to_string(limit_) + " bytes)");
+    }
+    throw MemoryLimitExceeded("Global query memory limit exceeded (limit " +
+                              std::to_string(global_.getGlobalLimit()) + " bytes)");
+}
+
+bool QueryMemoryContext::tryReserve(size_t bytes) {
+    if (limit_ != 0 && used_ + bytes > limit_) {
+        return false;
+    }
+
+    if (used_ + bytes > granted_) {
+        // Take a whole chunk from the global tracker when possible, falling
+        // back to the exact shortfall near the global limit
+        size_t shortfall = used_ + bytes - granted_;
+        size_t chunk = ((shortfall + kGrantChunk - 1) / kGrantChunk) * kGrantChunk;
+        if (global_.tryReserve(chunk)) {
+            granted_ += chunk;
+        } else if (global_.tryReserve(shortfall)) {
+            granted_ += shortfall;
+        } else {
+            return false;
+        }
+    }
+
+    used_ += bytes;
+    if (used_ > peak_) {
+        peak_ = used_;
+    }
+    return true;
+}
+
+void QueryMemoryContext::release(size_t bytes) {
+    used_ -= (bytes < used_) ? bytes : used_;
+
+    // Hand back grants we are unlikely to need again
+    if (granted_ - used_ > 2 * kGrantChunk) {
+        size_t excess = granted_ - used_ - kGrantChunk;
+        global_.release(excess);
+        granted_ -= excess;
+    }
+}
+
+size_t QueryMemoryContext::getRemaining() const {
+    if (limit_ == 0) {
+        return SIZE_MAX;
+    }
+    return (used_ < limit_) ? limit_ - used_ : 0;
+}
+
+} // namespace sqlengine
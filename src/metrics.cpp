@@ -0,0 +1,90 @@
+#include "metrics.h"
+
+namespace sqlengine {
+
+namespace {
+
+// Raise an atomic maximum without taking a lock
+void updateMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+size_t bucketFor(uint64_t micros) {
+    // Bucket 0 holds 0-1us, bucket i holds (2^(i-1), 2^i]
+    size_t bucket = 0;
+    uint64_t bound = 1;
+    while (micros > bound && bucket + 1 < LatencyHistogram::kBucketCount) {
+        bound <<= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+} // namespace
+
+// LatencyHistogram implementation
+void LatencyHistogram::record(uint64_t micros) {
+    buckets_[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_micros_.fetch_add(micros, std::memory_order_relaxed);
+    updateMax(max_micros_, micros);
+}
+
+uint64_t LatencyHistogram::getBucketCount(size_t bucket) const {
+    if (bucket >= kBucketCount) {
+        return 0;
+    }
+    return buckets_[bucket].load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(size_t bucket) {
+    return uint64_t(1) << bucket;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t total = getCount();
+    if (total == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += getBucketCount(i);
+        if (seen >= rank) {
+            return getBucketUpperBound(i);
+        }
+    }
+    return getBucketUpperBound(kBucketCount - 1);
+}
+
+const char* statementKindName(StatementKind kind) {
+    switch (kind) {
+        case StatementKind::SELECT: return "SELECT";
+        case StatementKind::INSERT: return "INSERT";
+        case StatementKind::CREATE_TABLE: return "CREATE TABLE";
+        case StatementKind::DROP_TABLE: return "DROP TABLE";
+        case StatementKind::CREATE_MATERIALIZED_VIEW: return "CREATE MATERIALIZED VIEW";
+        case StatementKind::DROP_MATERIALIZED_VIEW: return "DROP MATERIALIZED VIEW";
+        case StatementKind::COPY: return "COPY";
+        default: return "INVALID";
+    }
+}
+
+// EngineMetrics implementation
+void EngineMetrics::recordQuery(StatementKind kind, uint64_t micros, uint64_t rows, bool failed) {
+    auto& metrics = by_kind_[static_cast<size_t>(kind)];
+    metrics.executions.fetch_add(1, std::memory_order_relaxed);
+    if (failed) {
+        metrics.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    metrics.rows_returned.fetch_add(rows, std::memory_order_relaxed);
+    metrics.latency.record(micros);
+}
+
+} // namespace sqlengine
@@ -1,26 +1,71 @@
 #include "parser.h"
 #include <stdexcept>
 #include <algorithm>
+#include <unordered_map>
 
 namespace sqlengine {
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens_(tokens), current_(0) {}
+namespace {
 
-std::unique_ptr<Statement> Parser::parseStatement() {
+std::string upperCase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+    return text;
+}
+
+} // namespace
+
+Parser::Parser(const std::vector<Token>& tokens, AstArena* arena) : tokens_(tokens), current_(0), arena_(arena) {}
+
+AstPtr<Statement> Parser::parseStatement() {
     if (match(TokenType::SELECT)) {
         return parseSelectStatement();
     } else if (match(TokenType::INSERT)) {
         return parseInsertStatement();
     } else if (match(TokenType::CREATE)) {
+        if (matchKeyword("MATERIALIZED")) {
+            return parseCreateMaterializedViewStatement();
+        }
+        if (matchKeyword("EXTERNAL")) {
+            return parseCreateExternalTableStatement();
+        }
         return parseCreateTableStatement();
     } else if (match(TokenType::DROP)) {
+        if (matchKeyword("MATERIALIZED")) {
+            return parseDropMaterializedViewStatement();
+        }
         return parseDropTableStatement();
+    } else if (matchKeyword("COPY")) {
+        return parseCopyStatement();
     } else {
         error("Expected statement");
         return nullptr;
     }
 }
 
+std::vector<ParsedStatement> Parser::parseScript() {
+    // Token positions are end offsets, so a statement's text starts where
+    // the previous separator ends
+    std::vector<ParsedStatement> statements;
+    size_t source_begin = 0;
+    while (true) {
+        while (match(TokenType::SEMICOLON)) {
+            source_begin = previous().position;
+        }
+        if (isAtEnd()) {
+            break;
+        }
+        ParsedStatement parsed;
+        parsed.statement = parseStatement();
+        parsed.source_begin = source_begin;
+        parsed.source_end = previous().position;
+        statements.push_back(std::move(parsed));
+        if (!isAtEnd() && !check(TokenType::SEMICOLON)) {
+            error("Expected ';' after statement");
+        }
+    }
+    return statements;
+}
+
 const Token& Parser::peek() const {
     return tokens_[current_];
 }
@@ -43,6 +88,14 @@ bool Parser::check(TokenType type) const {
     return peek().type == type;
 }
 
+bool Parser::matchKeyword(const std::string& keyword) {
+    if (check(TokenType::IDENTIFIER) && upperCase(peek().value) == keyword) {
+        advance();
+        return true;
+    }
+    return false;
+}
+
 bool Parser::match(TokenType type) {
     if (check(type)) {
         advance();
@@ -69,14 +122,14 @@ void Parser::consume(TokenType type, const std::string& message) {
     error(message);
 }
 
-std::unique_ptr<Statement> Parser::parseSelectStatement() {
-    auto stmt = std::make_unique<SelectStatement>();
+AstPtr<Statement> Parser::parseSelectStatement() {
+    auto stmt = node<SelectStatement>();
     
     // Parse SELECT list
     do {
         if (match(TokenType::MULTIPLY)) {
             // SELECT * - add all columns (handled later)
-            stmt->select_list.push_back(std::make_unique<ColumnExpression>("*"));
+            stmt->select_list.push_back(node<ColumnExpression>("*"));
         } else {
             stmt->select_list.push_back(parseExpression());
         }
@@ -86,25 +139,72 @@ std::unique_ptr<Statement> Parser::parseSelectStatement() {
     consume(TokenType::FROM, "Expected 'FROM' after SELECT list");
     consume(TokenType::IDENTIFIER, "Expected table name after FROM");
     stmt->from_table = previous().value;
+    stmt->from_alias = parseTableAlias();
+    
+    // Parse optional [INNER] JOIN ... ON clauses
+    while (check(TokenType::JOIN) || check(TokenType::INNER)) {
+        if (match(TokenType::INNER)) {
+            consume(TokenType::JOIN, "Expected 'JOIN' after INNER");
+        } else {
+            advance();
+        }
+        JoinClause join;
+        consume(TokenType::IDENTIFIER, "Expected table name after JOIN");
+        join.table = previous().value;
+        join.alias = parseTableAlias();
+        consume(TokenType::ON, "Expected 'ON' after joined table");
+        join.condition = parseExpression();
+        stmt->joins.push_back(std::move(join));
+    }
     
     // Parse optional WHERE clause
     if (match(TokenType::WHERE)) {
         stmt->where_clause = parseExpression();
     }
     
+    // Parse optional GROUP BY and HAVING clauses
+    if (match(TokenType::GROUP)) {
+        consume(TokenType::BY, "Expected 'BY' after GROUP");
+        do {
+            stmt->group_by.push_back(parseExpression());
+        } while (match(TokenType::COMMA));
+    }
+    if (match(TokenType::HAVING)) {
+        stmt->having = parseExpression();
+    }
+    
     // Parse optional ORDER BY clause
     if (match(TokenType::ORDER)) {
         consume(TokenType::BY, "Expected 'BY' after ORDER");
         do {
             consume(TokenType::IDENTIFIER, "Expected column name in ORDER BY");
-            stmt->order_by.push_back(previous().value);
+            OrderByItem item;
+            item.column = previous().value;
+            if (match(TokenType::DOT)) {
+                consume(TokenType::IDENTIFIER, "Expected column name after '.'");
+                item.table = item.column;
+                item.column = previous().value;
+            }
+            
+            if (match(TokenType::DESC)) {
+                item.descending = true;
+            } else {
+                match(TokenType::ASC); // optional
+            }
+            item.nulls_first = item.descending;
+            
+            // NULLS FIRST / NULLS LAST (contextual keywords)
+            if (matchKeyword("NULLS")) {
+                consume(TokenType::IDENTIFIER, "Expected FIRST or LAST after NULLS");
+                std::string placement = upperCase(previous().value);
+                if (placement != "FIRST" && placement != "LAST") {
+                    error("Expected FIRST or LAST after NULLS");
+                }
+                item.nulls_first = (placement == "FIRST");
+            }
+            
+            stmt->order_by.push_back(item);
         } while (match(TokenType::COMMA));
-        
-        if (match(TokenType::DESC)) {
-            stmt->order_desc = true;
-        } else {
-            match(TokenType::ASC); // optional
-        }
     }
     
     // Parse optional LIMIT clause
@@ -116,8 +216,19 @@ std::unique_ptr<Statement> Parser::parseSelectStatement() {
     return std::move(stmt);
 }
 
-std::unique_ptr<Statement> Parser::parseInsertStatement() {
-    auto stmt = std::make_unique<InsertStatement>();
+std::string Parser::parseTableAlias() {
+    if (match(TokenType::AS)) {
+        consume(TokenType::IDENTIFIER, "Expected alias after AS");
+        return previous().value;
+    }
+    if (match(TokenType::IDENTIFIER)) {
+        return previous().value;
+    }
+    return "";
+}
+
+AstPtr<Statement> Parser::parseInsertStatement() {
+    auto stmt = node<InsertStatement>();
     
     consume(TokenType::INTO, "Expected 'INTO' after INSERT");
     consume(TokenType::IDENTIFIER, "Expected table name");
@@ -137,7 +248,7 @@ std::unique_ptr<Statement> Parser::parseInsertStatement() {
     // Parse value lists
     do {
         consume(TokenType::LEFT_PAREN, "Expected '(' before values");
-        std::vector<std::unique_ptr<Expression>> values;
+        std::vector<AstPtr<Expression>> values;
         do {
             values.push_back(parseExpression());
         } while (match(TokenType::COMMA));
@@ -148,8 +259,8 @@ std::unique_ptr<Statement> Parser::parseInsertStatement() {
     return std::move(stmt);
 }
 
-std::unique_ptr<Statement> Parser::parseCreateTableStatement() {
-    auto stmt = std::make_unique<CreateTableStatement>();
+AstPtr<Statement> Parser::parseCreateTableStatement() {
+    auto stmt = node<CreateTableStatement>();
     
     consume(TokenType::TABLE, "Expected 'TABLE' after CREATE");
     consume(TokenType::IDENTIFIER, "Expected table name");
@@ -189,41 +300,136 @@ std::unique_ptr<Statement> Parser::parseCreateTableStatement() {
     return std::move(stmt);
 }
 
-std::unique_ptr<Statement> Parser::parseDropTableStatement() {
+AstPtr<Statement> Parser::parseDropTableStatement() {
     consume(TokenType::TABLE, "Expected 'TABLE' after DROP");
     consume(TokenType::IDENTIFIER, "Expected table name");
-    return std::make_unique<DropTableStatement>(previous().value);
+    return node<DropTableStatement>(previous().value);
+}
+
+AstPtr<Statement> Parser::parseCreateExternalTableStatement() {
+    auto stmt = node<CreateTableStatement>();
+    
+    consume(TokenType::TABLE, "Expected 'TABLE' after EXTERNAL");
+    consume(TokenType::IDENTIFIER, "Expected table name");
+    stmt->table_name = previous().value;
+    consume(TokenType::FROM, "Expected 'FROM' after table name");
+    consume(TokenType::STRING_LITERAL, "Expected file name after FROM");
+    stmt->source_path = previous().value;
+    
+    return std::move(stmt);
+}
+
+AstPtr<Statement> Parser::parseCreateMaterializedViewStatement() {
+    auto stmt = node<CreateMaterializedViewStatement>();
+    
+    if (!matchKeyword("VIEW")) {
+        error("Expected 'VIEW' after MATERIALIZED");
+    }
+    consume(TokenType::IDENTIFIER, "Expected view name");
+    stmt->view_name = previous().value;
+    
+    if (match(TokenType::LEFT_PAREN)) {
+        do {
+            consume(TokenType::IDENTIFIER, "Expected column name");
+            stmt->column_names.push_back(previous().value);
+        } while (match(TokenType::COMMA));
+        consume(TokenType::RIGHT_PAREN, "Expected ')' after column names");
+    }
+    
+    consume(TokenType::AS, "Expected 'AS' after view name");
+    consume(TokenType::SELECT, "Expected SELECT after AS");
+    
+    // The view keeps its definition after the statement's arena is gone
+    AstArena* arena = arena_;
+    arena_ = nullptr;
+    auto query = parseSelectStatement();
+    arena_ = arena;
+    stmt->query.reset(static_cast<SelectStatement*>(query.release()));
+    
+    return std::move(stmt);
+}
+
+AstPtr<Statement> Parser::parseDropMaterializedViewStatement() {
+    if (!matchKeyword("VIEW")) {
+        error("Expected 'VIEW' after MATERIALIZED");
+    }
+    consume(TokenType::IDENTIFIER, "Expected view name");
+    return node<DropMaterializedViewStatement>(previous().value);
+}
+
+AstPtr<Statement> Parser::parseCopyStatement() {
+    auto stmt = node<CopyStatement>();
+    
+    consume(TokenType::IDENTIFIER, "Expected table name after COPY");
+    stmt->table_name = previous().value;
+    if (matchKeyword("TO")) {
+        stmt->to_file = true;
+    } else {
+        consume(TokenType::FROM, "Expected 'FROM' or 'TO' after table name");
+    }
+    consume(TokenType::STRING_LITERAL, "Expected file name");
+    stmt->path = previous().value;
+    
+    // Options, as in PostgreSQL: WITH (FORMAT CSV, HEADER [bool], DELIMITER 'c')
+    if (matchKeyword("WITH") || check(TokenType::LEFT_PAREN)) {
+        consume(TokenType::LEFT_PAREN, "Expected '(' after WITH");
+        do {
+            if (matchKeyword("FORMAT")) {
+                if (matchKeyword("COLUMNAR")) {
+                    stmt->format = CopyStatement::Format::COLUMNAR;
+                } else if (matchKeyword("CSV")) {
+                    stmt->format = CopyStatement::Format::CSV;
+                } else {
+                    error("Unsupported COPY format");
+                }
+            } else if (matchKeyword("HEADER")) {
+                stmt->header = !match(TokenType::FALSE);
+                match(TokenType::TRUE);
+            } else if (matchKeyword("DELIMITER")) {
+                consume(TokenType::STRING_LITERAL, "Expected delimiter string");
+                if (previous().value.size() != 1) {
+                    error("COPY delimiter must be a single character");
+                }
+                stmt->delimiter = previous().value[0];
+            } else {
+                error("Unknown COPY option");
+            }
+        } while (match(TokenType::COMMA));
+        consume(TokenType::RIGHT_PAREN, "Expected ')' after COPY options");
+    }
+    
+    return std::move(stmt);
 }
 
-std::unique_ptr<Expression> Parser::parseExpression() {
+AstPtr<Expression> Parser::parseExpression() {
     return parseOrExpression();
 }
 
-std::unique_ptr<Expression> Parser::parseOrExpression() {
+AstPtr<Expression> Parser::parseOrExpression() {
     auto expr = parseAndExpression();
     
     while (match(TokenType::OR)) {
         auto op = BinaryExpression::Operator::OR;
         auto right = parseAndExpression();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        expr = node<BinaryExpression>(std::move(expr), op, std::move(right));
     }
     
     return expr;
 }
 
-std::unique_ptr<Expression> Parser::parseAndExpression() {
+AstPtr<Expression> Parser::parseAndExpression() {
     auto expr = parseEqualityExpression();
     
     while (match(TokenType::AND)) {
         auto op = BinaryExpression::Operator::AND;
         auto right = parseEqualityExpression();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        expr = node<BinaryExpression>(std::move(expr), op, std::move(right));
     }
     
     return expr;
 }
 
-std::unique_ptr<Expression> Parser::parseEqualityExpression() {
+AstPtr<Expression> Parser::parseEqualityExpression() {
     auto expr = parseComparisonExpression();
     
     while (match({TokenType::NOT_EQUAL, TokenType::EQUAL})) {
@@ -231,13 +437,13 @@ std::unique_ptr<Expression> Parser::parseEqualityExpression() {
                   BinaryExpression::Operator::EQUAL : 
                   BinaryExpression::Operator::NOT_EQUAL;
         auto right = parseComparisonExpression();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        expr = node<BinaryExpression>(std::move(expr), op, std::move(right));
     }
     
     return expr;
 }
 
-std::unique_ptr<Expression> Parser::parseComparisonExpression() {
+AstPtr<Expression> Parser::parseComparisonExpression() {
     auto expr = parseTermExpression();
     
     while (match({TokenType::GREATER_THAN, TokenType::GREATER_EQUAL, 
@@ -251,13 +457,13 @@ std::unique_ptr<Expression> Parser::parseComparisonExpression() {
             default: op = BinaryExpression::Operator::EQUAL; break;
         }
         auto right = parseTermExpression();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        expr = node<BinaryExpression>(std::move(expr), op, std::move(right));
     }
     
     return expr;
 }
 
-std::unique_ptr<Expression> Parser::parseTermExpression() {
+AstPtr<Expression> Parser::parseTermExpression() {
     auto expr = parseFactorExpression();
     
     while (match({TokenType::MINUS, TokenType::PLUS})) {
@@ -265,13 +471,13 @@ std::unique_ptr<Expression> Parser::parseTermExpression() {
                   BinaryExpression::Operator::ADD : 
                   BinaryExpression::Operator::SUBTRACT;
         auto right = parseFactorExpression();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        expr = node<BinaryExpression>(std::move(expr), op, std::move(right));
     }
     
     return expr;
 }
 
-std::unique_ptr<Expression> Parser::parseFactorExpression() {
+AstPtr<Expression> Parser::parseFactorExpression() {
     auto expr = parseUnaryExpression();
     
     while (match({TokenType::DIVIDE, TokenType::MULTIPLY})) {
@@ -279,46 +485,49 @@ std::unique_ptr<Expression> Parser::parseFactorExpression() {
                   BinaryExpression::Operator::MULTIPLY : 
                   BinaryExpression::Operator::DIVIDE;
         auto right = parseUnaryExpression();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        expr = node<BinaryExpression>(std::move(expr), op, std::move(right));
     }
     
     return expr;
 }
 
-std::unique_ptr<Expression> Parser::parseUnaryExpression() {
+AstPtr<Expression> Parser::parseUnaryExpression() {
     if (match({TokenType::NOT, TokenType::MINUS})) {
         auto op = (previous().type == TokenType::NOT) ? 
                   UnaryExpression::Operator::NOT : 
                   UnaryExpression::Operator::MINUS;
         auto expr = parseUnaryExpression();
-        return std::make_unique<UnaryExpression>(op, std::move(expr));
+        return node<UnaryExpression>(op, std::move(expr));
     }
     
     return parsePrimaryExpression();
 }
 
-std::unique_ptr<Expression> Parser::parsePrimaryExpression() {
+AstPtr<Expression> Parser::parsePrimaryExpression() {
     if (match({TokenType::TRUE, TokenType::FALSE})) {
         bool value = (previous().type == TokenType::TRUE);
-        return std::make_unique<LiteralExpression>(Value(value));
+        return node<LiteralExpression>(Value(value));
     }
     
     if (match(TokenType::NULL_KW)) {
-        return std::make_unique<LiteralExpression>(Value(nullptr));
+        return node<LiteralExpression>(Value(nullptr));
     }
     
     if (match({TokenType::INTEGER_LITERAL, TokenType::REAL_LITERAL, TokenType::STRING_LITERAL})) {
         Value value = parseValue(previous());
-        return std::make_unique<LiteralExpression>(value);
+        return node<LiteralExpression>(value);
     }
     
     if (match(TokenType::IDENTIFIER)) {
         std::string name = previous().value;
+        if (check(TokenType::LEFT_PAREN)) {
+            return parseAggregateExpression(name);
+        }
         if (match(TokenType::DOT)) {
             consume(TokenType::IDENTIFIER, "Expected column name after '.'");
-            return std::make_unique<ColumnExpression>(name, previous().value);
+            return node<ColumnExpression>(name, previous().value);
         }
-        return std::make_unique<ColumnExpression>(name);
+        return node<ColumnExpression>(name);
     }
     
     if (match(TokenType::LEFT_PAREN)) {
@@ -331,6 +540,32 @@ std::unique_ptr<Expression> Parser::parsePrimaryExpression() {
     return nullptr;
 }
 
+AstPtr<Expression> Parser::parseAggregateExpression(const std::string& name) {
+    static const std::unordered_map<std::string, AggregateExpression::Function> functions = {
+        {"COUNT", AggregateExpression::Function::COUNT},
+        {"SUM", AggregateExpression::Function::SUM},
+        {"MIN", AggregateExpression::Function::MIN},
+        {"MAX", AggregateExpression::Function::MAX},
+        {"AVG", AggregateExpression::Function::AVG},
+    };
+    
+    auto it = functions.find(upperCase(name));
+    if (it == functions.end()) {
+        error("Unknown function: " + name);
+    }
+    
+    consume(TokenType::LEFT_PAREN, "Expected '(' after function name");
+    AstPtr<Expression> argument;
+    if (it->second == AggregateExpression::Function::COUNT && match(TokenType::MULTIPLY)) {
+        // COUNT(*) has no argument
+    } else {
+        argument = parseExpression();
+    }
+    consume(TokenType::RIGHT_PAREN, "Expected ')' after function argument");
+    
+    return node<AggregateExpression>(it->second, std::move(argument));
+}
+
 DataType Parser::parseDataType() {
     if (match(TokenType::INTEGER_TYPE)) {
         return DataType::INTEGER;
@@ -0,0 +1,1028 @@
+#include "pg_server.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <stdexcept>
+
+namespace sqlengine {
+
+namespace {
+
+constexpr int32_t kProtocolVersion = 3 << 16;
+constexpr int32_t kCancelRequest = 80877102;
+constexpr int32_t kSslRequest = 80877103;
+constexpr int32_t kGssRequest = 80877104;
+constexpr size_t kMaxStartupLength = 10000;
+constexpr size_t kMaxMessageLength = size_t(1) << 30;
+constexpr size_t kReadChunk = 64 * 1024;
+
+// Type OIDs of pg_type
+constexpr int32_t kUnknownOid = 0;
+constexpr int32_t kBoolOid = 16;
+constexpr int32_t kInt8Oid = 20;
+constexpr int32_t kInt2Oid = 21;
+constexpr int32_t kInt4Oid = 23;
+constexpr int32_t kTextOid = 25;
+constexpr int32_t kFloat4Oid = 700;
+constexpr int32_t kFloat8Oid = 701;
+constexpr int32_t kNumericOid = 1700;
+
+// A malformed message; the connection is closed after reporting it
+struct ProtocolError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// An error reported to the client with its SQLSTATE
+struct ClientError : std::runtime_error {
+    ClientError(const char* sql_state, const std::string& message)
+        : std::runtime_error(message), code(sql_state) {}
+    const char* code;
+};
+
+class MessageReader {
+public:
+    MessageReader(const char* data, size_t length) : data_(data), length_(length) {}
+
+    int16_t int16() {
+        uint16_t value;
+        read(&value, sizeof(value));
+        return static_cast<int16_t>(ntohs(value));
+    }
+
+    int32_t int32() {
+        uint32_t value;
+        read(&value, sizeof(value));
+        return static_cast<int32_t>(ntohl(value));
+    }
+
+    std::string string() {
+        auto end = static_cast<const char*>(std::memchr(data_ + position_, '\0', length_ - position_));
+        if (!end) {
+            throw ProtocolError("unterminated string in message");
+        }
+        std::string value(data_ + position_, end);
+        position_ += value.size() + 1;
+        return value;
+    }
+
+    std::string bytes(size_t count) {
+        need(count);
+        std::string value(data_ + position_, count);
+        position_ += count;
+        return value;
+    }
+
+    size_t remaining() const { return length_ - position_; }
+
+private:
+    const char* data_;
+    size_t length_;
+    size_t position_ = 0;
+
+    void need(size_t count) const {
+        if (length_ - position_ < count) {
+            throw ProtocolError("message is too short");
+        }
+    }
+
+    void read(void* out, size_t count) {
+        need(count);
+        std::memcpy(out, data_ + position_, count);
+        position_ += count;
+    }
+};
+
+// Appends a backend message to an output buffer; its length is filled in
+// when the writer goes out of scope
+class MessageWriter {
+public:
+    MessageWriter(std::string& out, char type) : out_(out), start_(out.size()) {
+        out_.push_back(type);
+        out_.append(4, '\0');
+    }
+
+    ~MessageWriter() {
+        uint32_t length = htonl(static_cast<uint32_t>(out_.size() - start_ - 1));
+        std::memcpy(&out_[start_ + 1], &length, sizeof(length));
+    }
+
+    MessageWriter& byte(char value) {
+        out_.push_back(value);
+        return *this;
+    }
+
+    MessageWriter& int16(int16_t value) {
+        uint16_t network = htons(static_cast<uint16_t>(value));
+        out_.append(reinterpret_cast<const char*>(&network), sizeof(network));
+        return *this;
+    }
+
+    MessageWriter& int32(int32_t value) {
+        uint32_t network = htonl(static_cast<uint32_t>(value));
+        out_.append(reinterpret_cast<const char*>(&network), sizeof(network));
+        return *this;
+    }
+
+    MessageWriter& string(const std::string& value) {
+        out_.append(value);
+        out_.push_back('\0');
+        return *this;
+    }
+
+    MessageWriter& bytes(const std::string& value) {
+        out_.append(value);
+        return *this;
+    }
+
+private:
+    std::string& out_;
+    size_t start_;
+};
+
+// Engine errors carry no SQLSTATE; the common ones are recognized by text
+const char* sqlState(const std::string& message) {
+    static const std::pair<const char*, const char*> states[] = {
+        {"Parse error", "42601"},
+        {"Table not found", "42P01"},
+        {"Materialized view not found", "42P01"},
+        {"Column not found", "42703"},
+        {"Ambiguous column", "42702"},
+        {"already exists", "42P07"},
+        {"Division by zero", "22012"},
+        {"Integer overflow", "22003"},
+        {"Type mismatch", "42804"},
+        {"Row validation failed", "22000"},
+        {"was cancelled", "57014"},
+        {"timed out", "57014"},
+        {"memory limit exceeded", "53200"},
+    };
+    for (const auto& [text, state] : states) {
+        if (message.find(text) != std::string::npos) {
+            return state;
+        }
+    }
+    return "XX000";
+}
+
+void sendError(std::string& out, const char* sql_state, const std::string& message) {
+    MessageWriter(out, 'E')
+        .byte('S').string("ERROR")
+        .byte('V').string("ERROR")
+        .byte('C').string(sql_state)
+        .byte('M').string(message)
+        .byte('\0');
+}
+
+void sendReady(std::string& out) {
+    MessageWriter(out, 'Z').byte('I');
+}
+
+void sendParameterStatus(std::string& out, const std::string& name, const std::string& value) {
+    MessageWriter(out, 'S').string(name).string(value);
+}
+
+int32_t typeOid(DataType type) {
+    switch (type) {
+        case DataType::INTEGER: return kInt8Oid;
+        case DataType::REAL: return kFloat8Oid;
+        case DataType::BOOLEAN: return kBoolOid;
+        default: return kTextOid;
+    }
+}
+
+int16_t typeLength(DataType type) {
+    switch (type) {
+        case DataType::INTEGER:
+        case DataType::REAL: return 8;
+        case DataType::BOOLEAN: return 1;
+        default: return -1;
+    }
+}
+
+// Result columns carry no table OID or attribute number and use the text format
+void sendRowDescription(std::string& out, const std::vector<QueryEngine::ResultColumn>& columns) {
+    MessageWriter message(out, 'T');
+    message.int16(static_cast<int16_t>(columns.size()));
+    for (const auto& column : columns) {
+        message.string(column.name).int32(0).int16(0).int32(typeOid(column.type))
+            .int16(typeLength(column.type)).int32(-1).int16(0);
+    }
+}
+
+// Shortest text that reads back as the same double, as PostgreSQL prints
+// float8; NaN and the infinities use PostgreSQL's spellings, which typed
+// drivers parse
+std::string formatReal(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "Infinity" : "-Infinity";
+    }
+    char buffer[32];
+    for (int precision = 15; precision <= 17; ++precision) {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        if (std::strtod(buffer, nullptr) == value) {
+            break;
+        }
+    }
+    return buffer;
+}
+
+// Text format of a non-NULL value
+std::string formatValue(const Value& value) {
+    switch (value.getType()) {
+        case DataType::REAL: return formatReal(value.get<double>());
+        case DataType::BOOLEAN: return value.get<bool>() ? "t" : "f";
+        default: return value.toString();
+    }
+}
+
+void sendRows(std::string& out, const std::vector<Row>& rows, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        MessageWriter message(out, 'D');
+        message.int16(static_cast<int16_t>(rows[i].size()));
+        for (const auto& value : rows[i]) {
+            if (value.isNull()) {
+                message.int32(-1);
+            } else {
+                std::string text = formatValue(value);
+                message.int32(static_cast<int32_t>(text.size())).bytes(text);
+            }
+        }
+    }
+}
+
+std::string commandTag(StatementKind kind, uint64_t rows) {
+    switch (kind) {
+        case StatementKind::SELECT: return "SELECT " + std::to_string(rows);
+        case StatementKind::INSERT: return "INSERT 0 " + std::to_string(rows);
+        case StatementKind::CREATE_TABLE: return "CREATE TABLE";
+        case StatementKind::DROP_TABLE: return "DROP TABLE";
+        case StatementKind::CREATE_MATERIALIZED_VIEW: return "CREATE MATERIALIZED VIEW";
+        case StatementKind::DROP_MATERIALIZED_VIEW: return "DROP MATERIALIZED VIEW";
+        case StatementKind::COPY: return "COPY " + std::to_string(rows);
+        default: return "";
+    }
+}
+
+// Calls visit(position, length, number) for every $<number> placeholder
+// outside string literals and comments
+template <typename Visitor>
+void forEachPlaceholder(const std::string& sql, Visitor visit) {
+    size_t i = 0;
+    while (i < sql.size()) {
+        char c = sql[i];
+        if (c == '\'' || c == '"') {
+            // Strings use backslash escapes, as in the lexer
+            for (++i; i < sql.size() && sql[i] != c; ++i) {
+                if (sql[i] == '\\') {
+                    ++i;
+                }
+            }
+            ++i;
+        } else if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+            i = sql.find('\n', i);
+            if (i == std::string::npos) {
+                return;
+            }
+        } else if (c == '$' && i + 1 < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i + 1]))) {
+            size_t end = i + 1;
+            while (end < sql.size() && std::isdigit(static_cast<unsigned char>(sql[end]))) {
+                ++end;
+            }
+            visit(i, end - i, std::strtoul(sql.c_str() + i + 1, nullptr, 10));
+            i = end;
+        } else {
+            ++i;
+        }
+    }
+}
+
+size_t parameterCount(const std::string& sql) {
+    size_t count = 0;
+    forEachPlaceholder(sql, [&](size_t, size_t, size_t number) { count = std::max(count, number); });
+    return count;
+}
+
+// A numeric parameter as SQL, or nullopt if text is not a number. A
+// negative value is parenthesized so that its minus cannot join an
+// operator before the placeholder (10-$1 with -5 would read as 10--5, a
+// comment), and NaN and the infinities, which have no literal, become
+// REAL divisions by zero.
+std::optional<std::string> numericLiteral(const std::string& text) {
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0])) ||
+        text.find_first_of("xX") != std::string::npos) {
+        return std::nullopt;
+    }
+    char* end = nullptr;
+    errno = 0;
+    double number = std::strtod(text.c_str(), &end);
+    if (end != text.c_str() + text.size() || errno == ERANGE) {
+        return std::nullopt;
+    }
+    if (std::isnan(number)) {
+        return "(0.0 / 0.0)";
+    }
+    if (std::isinf(number)) {
+        return number > 0 ? "(1.0 / 0.0)" : "(-1.0 / 0.0)";
+    }
+    
+    // The lexer reads unsigned numbers that start with a digit
+    bool negative = text[0] == '-';
+    std::string digits = text.substr(text[0] == '-' || text[0] == '+' ? 1 : 0);
+    if (digits[0] == '.') {
+        digits.insert(0, "0");
+    }
+    return negative ? "(-" + digits + ")" : digits;
+}
+
+// A parameter value as a SQL literal. Declared numeric and boolean types
+// are checked; text is quoted; a value of unspecified type is inserted as
+// a number if it looks like one and quoted otherwise.
+std::string parameterLiteral(const std::optional<std::string>& value, int32_t type) {
+    if (!value) {
+        return "NULL";
+    }
+    const std::string& text = *value;
+    switch (type) {
+        case kInt2Oid:
+        case kInt4Oid:
+        case kInt8Oid:
+        case kFloat4Oid:
+        case kFloat8Oid:
+        case kNumericOid:
+            if (auto number = numericLiteral(text)) {
+                return *number;
+            }
+            throw ClientError("22P02", "invalid input syntax for a numeric parameter: \"" + text + "\"");
+        case kBoolOid:
+            if (text == "t" || text == "true" || text == "1") {
+                return "TRUE";
+            }
+            if (text == "f" || text == "false" || text == "0") {
+                return "FALSE";
+            }
+            throw ClientError("22P02", "invalid input syntax for a boolean parameter: \"" + text + "\"");
+        case kUnknownOid:
+            // Words such as NaN stay text unless the type says otherwise
+            if (text.find_first_not_of("+-.0123456789eE") == std::string::npos) {
+                if (auto number = numericLiteral(text)) {
+                    return *number;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    std::string literal = "'";
+    for (char c : text) {
+        if (c == '\'' || c == '\\') {
+            literal.push_back('\\');
+        }
+        literal.push_back(c);
+    }
+    literal.push_back('\'');
+    return literal;
+}
+
+// The statement with its placeholders replaced by the parameter values
+std::string bindParameters(const std::string& sql, const std::vector<std::optional<std::string>>& values,
+                           const std::vector<int32_t>& types) {
+    std::string bound;
+    size_t copied = 0;
+    forEachPlaceholder(sql, [&](size_t position, size_t length, size_t number) {
+        if (number == 0 || number > values.size()) {
+            throw ClientError("42P02", "there is no parameter $" + std::to_string(number));
+        }
+        bound.append(sql, copied, position - copied);
+        bound += parameterLiteral(values[number - 1], number <= types.size() ? types[number - 1] : kUnknownOid);
+        copied = position + length;
+    });
+    bound.append(sql, copied, std::string::npos);
+    return bound;
+}
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+struct PgServer::Connection {
+    struct Statement {
+        std::string sql;
+        std::vector<int32_t> parameter_types; // as given by Parse; 0 = unspecified
+    };
+
+    // A bound statement; it runs on its first Execute and the rows are
+    // handed out over as many Executes as the row limits require
+    struct Portal {
+        std::string sql;
+        bool executed = false;
+        std::vector<Row> rows;
+        size_t position = 0;
+        StatementKind kind = StatementKind::INVALID;
+        uint64_t row_count = 0;
+    };
+
+    int fd;
+    bool started = false;  // startup packet received
+    bool skipping = false; // an extended query message failed; ignore input until Sync
+    bool closing = false;  // close once the output is sent
+    bool writable_wait = false;
+    std::string input;
+    std::string output;
+    std::unordered_map<std::string, Statement> statements;
+    std::unordered_map<std::string, Portal> portals;
+
+    explicit Connection(int socket) : fd(socket) {}
+};
+
+PgServer::PgServer(QueryEngine& engine) : engine_(engine) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        throw systemError("epoll_create1");
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        int error = errno;
+        ::close(epoll_fd_);
+        errno = error;
+        throw systemError("eventfd");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+}
+
+PgServer::~PgServer() {
+    for (auto& [fd, connection] : connections_) {
+        ::close(fd);
+    }
+    for (int fd : listeners_) {
+        ::close(fd);
+    }
+    for (const auto& path : unix_paths_) {
+        unlink(path.c_str());
+    }
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+}
+
+void PgServer::listenTcp(const std::string& host, uint16_t port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    std::string service = std::to_string(port);
+    int status = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &addresses);
+    if (status != 0) {
+        throw std::runtime_error("Cannot resolve " + host + ": " + gai_strerror(status));
+    }
+
+    std::string error = "no addresses";
+    for (addrinfo* address = addresses; address; address = address->ai_next) {
+        int fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            error = std::strerror(errno);
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (::bind(fd, address->ai_addr, address->ai_addrlen) < 0 || listen(fd, SOMAXCONN) < 0) {
+            error = std::strerror(errno);
+            ::close(fd);
+            continue;
+        }
+        addListener(fd);
+        freeaddrinfo(addresses);
+        return;
+    }
+    freeaddrinfo(addresses);
+    throw std::runtime_error("Cannot listen on " + host + ":" + service + ": " + error);
+}
+
+void PgServer::listenUnix(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Unix socket path is too long: " + path);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw systemError("socket");
+    }
+    unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        throw systemError("Cannot listen on " + path);
+    }
+    unix_paths_.push_back(path);
+    addListener(fd);
+}
+
+void PgServer::addListener(int fd) {
+    setNonBlocking(fd);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    listeners_.push_back(fd);
+}
+
+void PgServer::stop() {
+    stopping_.store(true);
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+void PgServer::run() {
+    std::vector<epoll_event> events(64);
+    while (!stopping_.load()) {
+        int count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw systemError("epoll_wait");
+        }
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wake_fd_) {
+                uint64_t wakeups;
+                ssize_t drained = read(wake_fd_, &wakeups, sizeof(wakeups));
+                (void)drained;
+                continue;
+            }
+            if (std::find(listeners_.begin(), listeners_.end(), fd) != listeners_.end()) {
+                acceptClients(fd);
+                continue;
+            }
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                readClient(connection);
+            } else if (events[i].events & EPOLLOUT) {
+                writeClient(connection);
+            }
+        }
+    }
+    stopping_.store(false);
+}
+
+void PgServer::acceptClients(int listener) {
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN once the backlog is drained; other errors (e.g. out of
+            // descriptors) leave the client waiting for the next attempt
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // fails harmlessly on Unix sockets
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+        connections_.emplace(fd, std::make_unique<Connection>(fd));
+    }
+}
+
+void PgServer::readClient(Connection& connection) {
+    char buffer[kReadChunk];
+    while (true) {
+        ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.input.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        // Orderly shutdown or a connection error
+        closeClient(connection.fd);
+        return;
+    }
+
+    if (!processInput(connection)) {
+        connection.closing = true;
+    }
+    writeClient(connection);
+}
+
+void PgServer::writeClient(Connection& connection) {
+    size_t sent = 0;
+    while (sent < connection.output.size()) {
+        ssize_t written = send(connection.fd, connection.output.data() + sent, connection.output.size() - sent,
+                               MSG_NOSIGNAL);
+        if (written > 0) {
+            sent += static_cast<size_t>(written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            closeClient(connection.fd);
+            return;
+        }
+    }
+    connection.output.erase(0, sent);
+
+    if (connection.output.empty() && connection.closing) {
+        closeClient(connection.fd);
+        return;
+    }
+
+    // Wait for the socket to drain before sending more; input is not read
+    // meanwhile, so a client that does not read its results is throttled
+    bool wait = !connection.output.empty();
+    if (wait != connection.writable_wait) {
+        epoll_event event{};
+        event.events = wait ? EPOLLOUT : EPOLLIN;
+        event.data.fd = connection.fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.writable_wait = wait;
+    }
+}
+
+void PgServer::closeClient(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.erase(fd);
+}
+
+bool PgServer::processInput(Connection& connection) {
+    size_t position = 0;
+    std::string& input = connection.input;
+    bool open = true;
+    try {
+        while (open && !connection.closing) {
+            // The startup packet has no type byte
+            size_t header = connection.started ? 5 : 4;
+            if (input.size() - position < header) {
+                break;
+            }
+            uint32_t length;
+            std::memcpy(&length, input.data() + position + header - 4, sizeof(length));
+            length = ntohl(length);
+            size_t limit = connection.started ? kMaxMessageLength : kMaxStartupLength;
+            if (length < 4 || length > limit) {
+                throw ProtocolError("invalid message length");
+            }
+            if (input.size() - position < header - 4 + length) {
+                break;
+            }
+            const char* body = input.data() + position + header;
+            size_t body_length = length - 4;
+            if (connection.started) {
+                char type = input[position];
+                if (type == 'X') {
+                    open = false;
+                } else {
+                    handleMessage(connection, type, body, body_length);
+                }
+            } else {
+                open = handleStartup(connection, body, body_length);
+            }
+            position += header - 4 + length;
+        }
+    } catch (const ProtocolError& error) {
+        sendError(connection.output, "08P01", error.what());
+        open = false;
+    }
+    input.erase(0, position);
+    return open;
+}
+
+bool PgServer::handleStartup(Connection& connection, const char* body, size_t length) {
+    MessageReader reader(body, length);
+    int32_t code = reader.int32();
+    if (code == kSslRequest || code == kGssRequest) {
+        // Declined; the client continues with a plain startup packet
+        connection.output.push_back('N');
+        return true;
+    }
+    if (code == kCancelRequest) {
+        // Statements run on the event loop thread, so by the time this is
+        // read the statement to cancel has finished; use query timeouts
+        return false;
+    }
+    if (code >> 16 != kProtocolVersion >> 16) {
+        sendError(connection.output, "0A000", "unsupported frontend protocol " + std::to_string(code >> 16) + "." +
+                                                  std::to_string(code & 0xffff));
+        return false;
+    }
+
+    // user, database and options are accepted as given
+    while (reader.remaining() > 1) {
+        reader.string();
+        reader.string();
+    }
+    connection.started = true;
+
+    std::string& out = connection.output;
+    MessageWriter(out, 'R').int32(0); // AuthenticationOk
+    sendParameterStatus(out, "server_version", "14.0");
+    sendParameterStatus(out, "server_encoding", "UTF8");
+    sendParameterStatus(out, "client_encoding", "UTF8");
+    sendParameterStatus(out, "DateStyle", "ISO, MDY");
+    sendParameterStatus(out, "TimeZone", "UTC");
+    sendParameterStatus(out, "integer_datetimes", "on");
+    // String literals take backslash escapes
+    sendParameterStatus(out, "standard_conforming_strings", "off");
+    static std::mt19937 random{std::random_device{}()};
+    MessageWriter(out, 'K').int32(next_process_id_++).int32(static_cast<int32_t>(random()));
+    sendReady(out);
+    return true;
+}
+
+void PgServer::handleMessage(Connection& connection, char type, const char* body, size_t length) {
+    if (connection.skipping && type != 'S') {
+        return;
+    }
+    std::string& out = connection.output;
+    try {
+        switch (type) {
+            case 'Q': {
+                MessageReader reader(body, length);
+                simpleQuery(connection, reader.string());
+                return;
+            }
+            case 'P':
+                parse(connection, body, length);
+                return;
+            case 'B':
+                bind(connection, body, length);
+                return;
+            case 'D':
+                describe(connection, body, length);
+                return;
+            case 'E':
+                executePortal(connection, body, length);
+                return;
+            case 'C':
+                close(connection, body, length);
+                return;
+            case 'S':
+                // The implicit transaction ends: its portals go with it
+                connection.skipping = false;
+                connection.portals.clear();
+                sendReady(out);
+                return;
+            case 'H':
+                return; // the output is sent after every read anyway
+            default:
+                throw ClientError("0A000", std::string("unsupported message type '") + type + "'");
+        }
+    } catch (const ClientError& error) {
+        sendError(out, error.code, error.what());
+        connection.skipping = true;
+    }
+}
+
+void PgServer::simpleQuery(Connection& connection, const std::string& sql) {
+    std::string& out = connection.output;
+
+    // The statements are split here so that each gets its own result
+    std::vector<std::string> texts;
+    try {
+        AstArena arena;
+        Lexer lexer(sql);
+        Parser parser(lexer.tokenize(), &arena);
+        for (const auto& parsed : parser.parseScript()) {
+            texts.push_back(sql.substr(parsed.source_begin, parsed.source_end - parsed.source_begin));
+        }
+    } catch (const std::exception& error) {
+        sendError(out, sqlState(error.what()), error.what());
+        sendReady(out);
+        return;
+    }
+    if (texts.empty()) {
+        MessageWriter(out, 'I'); // EmptyQueryResponse
+    }
+
+    for (const auto& text : texts) {
+        auto columns = engine_.describe(text);
+        if (!engine_.getLastError().empty()) {
+            sendError(out, sqlState(engine_.getLastError()), engine_.getLastError());
+            break;
+        }
+        auto rows = engine_.execute(text);
+        if (!engine_.getLastError().empty()) {
+            sendError(out, sqlState(engine_.getLastError()), engine_.getLastError());
+            break;
+        }
+        if (!columns.empty()) {
+            sendRowDescription(out, columns);
+        }
+        sendRows(out, rows, 0, rows.size());
+        MessageWriter(out, 'C').string(commandTag(engine_.getLastStatementKind(), engine_.getLastRowCount()));
+    }
+    sendReady(out);
+}
+
+void PgServer::parse(Connection& connection, const char* body, size_t length) {
+    MessageReader reader(body, length);
+    std::string name = reader.string();
+    Connection::Statement statement;
+    statement.sql = reader.string();
+    int16_t count = reader.int16();
+    for (int16_t i = 0; i < count; ++i) {
+        statement.parameter_types.push_back(reader.int32());
+    }
+    if (!name.empty() && connection.statements.count(name)) {
+        throw ClientError("42P05", "prepared statement \"" + name + "\" already exists");
+    }
+    connection.statements[name] = std::move(statement);
+    MessageWriter(connection.output, '1'); // ParseComplete
+}
+
+void PgServer::bind(Connection& connection, const char* body, size_t length) {
+    MessageReader reader(body, length);
+    std::string portal_name = reader.string();
+    std::string statement_name = reader.string();
+    auto statement = connection.statements.find(statement_name);
+    if (statement == connection.statements.end()) {
+        throw ClientError("26000", "prepared statement \"" + statement_name + "\" does not exist");
+    }
+
+    int16_t format_count = reader.int16();
+    for (int16_t i = 0; i < format_count; ++i) {
+        if (reader.int16() != 0) {
+            throw ClientError("0A000", "binary parameter format is not supported");
+        }
+    }
+    int16_t value_count = reader.int16();
+    std::vector<std::optional<std::string>> values;
+    for (int16_t i = 0; i < value_count; ++i) {
+        int32_t value_length = reader.int32();
+        if (value_length < 0) {
+            values.emplace_back();
+        } else {
+            values.emplace_back(reader.bytes(static_cast<size_t>(value_length)));
+        }
+    }
+    int16_t result_format_count = reader.int16();
+    for (int16_t i = 0; i < result_format_count; ++i) {
+        if (reader.int16() != 0) {
+            throw ClientError("0A000", "binary result format is not supported");
+        }
+    }
+
+    size_t required = parameterCount(statement->second.sql);
+    if (values.size() != required) {
+        throw ClientError("08P01", "bind message supplies " + std::to_string(values.size()) +
+                                       " parameters, but prepared statement \"" + statement_name + "\" requires " +
+                                       std::to_string(required));
+    }
+    if (!portal_name.empty() && connection.portals.count(portal_name)) {
+        throw ClientError("42P03", "portal \"" + portal_name + "\" already exists");
+    }
+    Connection::Portal portal;
+    portal.sql = bindParameters(statement->second.sql, values, statement->second.parameter_types);
+    connection.portals[portal_name] = std::move(portal);
+    MessageWriter(connection.output, '2'); // BindComplete
+}
+
+void PgServer::describe(Connection& connection, const char* body, size_t length) {
+    MessageReader reader(body, length);
+    char kind = static_cast<char>(reader.bytes(1)[0]);
+    std::string name = reader.string();
+    if (kind == 'S') {
+        auto statement = connection.statements.find(name);
+        if (statement == connection.statements.end()) {
+            throw ClientError("26000", "prepared statement \"" + name + "\" does not exist");
+        }
+        // Parameters are described as declared; unspecified ones as text.
+        // The statement is described with all parameters NULL.
+        const auto& declared = statement->second.parameter_types;
+        size_t count = parameterCount(statement->second.sql);
+        {
+            MessageWriter message(connection.output, 't');
+            message.int16(static_cast<int16_t>(count));
+            for (size_t i = 0; i < count; ++i) {
+                int32_t type = i < declared.size() ? declared[i] : kUnknownOid;
+                message.int32(type == kUnknownOid ? kTextOid : type);
+            }
+        }
+        std::vector<std::optional<std::string>> nulls(count);
+        std::string sql = bindParameters(statement->second.sql, nulls, declared);
+        if (!sendDescription(connection, sql)) {
+            connection.skipping = true;
+        }
+        return;
+    }
+    if (kind == 'P') {
+        auto portal = connection.portals.find(name);
+        if (portal == connection.portals.end()) {
+            throw ClientError("34000", "portal \"" + name + "\" does not exist");
+        }
+        if (!sendDescription(connection, portal->second.sql)) {
+            connection.skipping = true;
+        }
+        return;
+    }
+    throw ProtocolError("invalid Describe message");
+}
+
+bool PgServer::sendDescription(Connection& connection, const std::string& sql) {
+    auto columns = engine_.describe(sql);
+    if (!engine_.getLastError().empty()) {
+        sendError(connection.output, sqlState(engine_.getLastError()), engine_.getLastError());
+        return false;
+    }
+    if (columns.empty()) {
+        MessageWriter(connection.output, 'n'); // NoData
+        return true;
+    }
+    sendRowDescription(connection.output, columns);
+    return true;
+}
+
+void PgServer::executePortal(Connection& connection, const char* body, size_t length) {
+    MessageReader reader(body, length);
+    std::string name = reader.string();
+    int32_t max_rows = reader.int32();
+    auto it = connection.portals.find(name);
+    if (it == connection.portals.end()) {
+        throw ClientError("34000", "portal \"" + name + "\" does not exist");
+    }
+    Connection::Portal& portal = it->second;
+    std::string& out = connection.output;
+
+    if (!portal.executed) {
+        if (portal.sql.find_first_not_of(" \t\r\n;") == std::string::npos) {
+            MessageWriter(out, 'I'); // EmptyQueryResponse
+            return;
+        }
+        portal.rows = engine_.execute(portal.sql);
+        if (!engine_.getLastError().empty()) {
+            throw ClientError(sqlState(engine_.getLastError()), engine_.getLastError());
+        }
+        portal.executed = true;
+        portal.kind = engine_.getLastStatementKind();
+        portal.row_count = engine_.getLastRowCount();
+    }
+
+    size_t available = portal.rows.size() - portal.position;
+    size_t count = max_rows > 0 ? std::min(available, static_cast<size_t>(max_rows)) : available;
+    sendRows(out, portal.rows, portal.position, portal.position + count);
+    portal.position += count;
+    if (portal.position < portal.rows.size()) {
+        MessageWriter(out, 's'); // PortalSuspended
+        return;
+    }
+    uint64_t rows = portal.kind == StatementKind::SELECT ? count : portal.row_count;
+    MessageWriter(out, 'C').string(commandTag(portal.kind, rows));
+}
+
+void PgServer::close(Connection& connection, const char* body, size_t length) {
+    MessageReader reader(body, length);
+    char kind = static_cast<char>(reader.bytes(1)[0]);
+    std::string name = reader.string();
+    if (kind == 'S') {
+        connection.statements.erase(name);
+    } else if (kind == 'P') {
+        connection.portals.erase(name);
+    } else {
+        throw ProtocolError("invalid Close message");
+    }
+    MessageWriter(connection.output, '3'); // CloseComplete
+}
+
+} // namespace sqlengine
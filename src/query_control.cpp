@@ -0,0 +1,59 @@
+#include "query_control.h"
+
+namespace sqlengine {
+
+// QueryControl implementation
+QueryControl::QueryControl(uint64_t query_id, std::string sql, uint64_t timeout_ms)
+    : query_id_(query_id), sql_(std::move(sql)), timeout_ms_(timeout_ms),
+      start_(std::chrono::steady_clock::now()),
+      deadline_(start_ + std::chrono::milliseconds(timeout_ms)) {}
+
+uint64_t QueryControl::getElapsedMicros() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_).count());
+}
+
+void QueryControl::checkInterrupt() const {
+    if (isCancelled()) {
+        throw QueryInterrupted("Query " + std::to_string(query_id_) + " was cancelled");
+    }
+    if (timeout_ms_ != 0 && std::chrono::steady_clock::now() >= deadline_) {
+        throw QueryInterrupted("Query " + std::to_string(query_id_) + " timed out after " +
+                               std::to_string(timeout_ms_) + " ms");
+    }
+}
+
+// QueryRegistry implementation
+std::shared_ptr<QueryControl> QueryRegistry::start(const std::string& sql, uint64_t timeout_ms) {
+    uint64_t query_id = next_query_id_.fetch_add(1, std::memory_order_relaxed) + 1;
+    auto control = std::make_shared<QueryControl>(query_id, sql, timeout_ms);
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_[query_id] = control;
+    return control;
+}
+
+void QueryRegistry::finish(uint64_t query_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_.erase(query_id);
+}
+
+bool QueryRegistry::cancel(uint64_t query_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = running_.find(query_id);
+    if (it == running_.end()) {
+        return false;
+    }
+    it->second->cancel();
+    return true;
+}
+
+std::vector<std::shared_ptr<const QueryControl>> QueryRegistry::getRunning() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::shared_ptr<const QueryControl>> running;
+    for (const auto& entry : running_) {
+        running.push_back(entry.second);
+    }
+    return running;
+}
+
+} // namespace sqlengine
@@ -1,11 +1,181 @@
 #include "query_engine.h"
+#include "system_tables.h"
+#include "arrow_c_data.h"
+#include "arrow_ipc.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 
 namespace sqlengine {
 
+namespace {
+
+uint64_t elapsedMicros(std::chrono::steady_clock::time_point& since) {
+    auto now = std::chrono::steady_clock::now();
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now - since).count();
+    since = now;
+    return static_cast<uint64_t>(micros);
+}
+
+StatementKind classifyStatement(Statement& statement) {
+    if (dynamic_cast<SelectStatement*>(&statement)) return StatementKind::SELECT;
+    if (dynamic_cast<InsertStatement*>(&statement)) return StatementKind::INSERT;
+    if (dynamic_cast<CreateTableStatement*>(&statement)) return StatementKind::CREATE_TABLE;
+    if (dynamic_cast<DropTableStatement*>(&statement)) return StatementKind::DROP_TABLE;
+    if (dynamic_cast<CreateMaterializedViewStatement*>(&statement)) return StatementKind::CREATE_MATERIALIZED_VIEW;
+    if (dynamic_cast<DropMaterializedViewStatement*>(&statement)) return StatementKind::DROP_MATERIALIZED_VIEW;
+    if (dynamic_cast<CopyStatement*>(&statement)) return StatementKind::COPY;
+    return StatementKind::INVALID;
+}
+
+// Tables whose versions validate a cached result, or false if the query
+// reads a virtual table (whose contents are not versioned)
+bool collectCacheableTables(const SelectStatement& select, const Database& database,
+                            std::vector<ResultCache::TableVersion>& tables) {
+    std::vector<std::string> names{select.from_table};
+    for (const auto& join : select.joins) {
+        names.push_back(join.table);
+    }
+    for (const auto& name : names) {
+        if (database.hasVirtualTable(name)) return false;
+        tables.push_back({name, database.getTableVersion(name)});
+    }
+    return true;
+}
+
+// A statement of a script. An INSERT that others were folded into keeps
+// the source range of each of them, so that they can be run one by one.
+struct ScriptStatement {
+    ParsedStatement parsed;
+    std::vector<std::pair<size_t, size_t>> merged; // empty unless merged
+};
+
+// Folds each INSERT into a preceding INSERT into the same table and
+// columns, so runs of single-row INSERTs become one multi-row statement
+std::vector<ScriptStatement> mergeInserts(std::vector<ParsedStatement>& statements) {
+    std::vector<ScriptStatement> merged;
+    merged.reserve(statements.size());
+    for (auto& parsed : statements) {
+        auto insert = dynamic_cast<InsertStatement*>(parsed.statement.get());
+        auto previous = merged.empty() ? nullptr
+                                       : dynamic_cast<InsertStatement*>(merged.back().parsed.statement.get());
+        if (insert && previous && insert->table_name == previous->table_name &&
+            insert->columns == previous->columns) {
+            ScriptStatement& target = merged.back();
+            if (target.merged.empty()) {
+                target.merged.emplace_back(target.parsed.source_begin, target.parsed.source_end);
+            }
+            target.merged.emplace_back(parsed.source_begin, parsed.source_end);
+            for (auto& values : insert->values) {
+                previous->values.push_back(std::move(values));
+            }
+            target.parsed.source_end = parsed.source_end;
+        } else {
+            merged.push_back({std::move(parsed), {}});
+        }
+    }
+    return merged;
+}
+
+// True if the query was cancelled or ran past its deadline
+bool interrupted(const QueryControl& control) {
+    try {
+        control.checkInterrupt();
+        return false;
+    } catch (const QueryInterrupted&) {
+        return true;
+    }
+}
+
+// Source text of a statement without its leading whitespace
+std::string statementText(const std::string& sql, size_t begin, size_t end) {
+    std::string text = sql.substr(begin, end - begin);
+    text.erase(0, text.find_first_not_of(" \t\r\n"));
+    return text;
+}
+
+// A column visible to the expressions of a SELECT, for describe()
+struct VisibleColumn {
+    std::string table; // alias if one was given
+    const Column* column;
+};
+
+const Schema& tableSchema(const Database& database, const std::string& name) {
+    if (const Table* table = database.getTable(name)) {
+        return table->getSchema();
+    }
+    if (const VirtualTable* table = database.getVirtualTable(name)) {
+        return table->getSchema();
+    }
+    throw std::runtime_error("Table not found: " + name);
+}
+
+DataType resultType(Expression& expr, const std::vector<VisibleColumn>& columns) {
+    if (auto column = dynamic_cast<ColumnExpression*>(&expr)) {
+        for (const auto& visible : columns) {
+            if (visible.column->name == column->column_name &&
+                (column->table_name.empty() || column->table_name == visible.table)) {
+                return visible.column->type;
+            }
+        }
+        throw std::runtime_error("Column not found: " + expressionToString(expr));
+    }
+    if (auto literal = dynamic_cast<LiteralExpression*>(&expr)) {
+        return literal->value.getType();
+    }
+    if (auto aggregate = dynamic_cast<AggregateExpression*>(&expr)) {
+        switch (aggregate->function) {
+            case AggregateExpression::Function::COUNT: return DataType::INTEGER;
+            case AggregateExpression::Function::AVG: return DataType::REAL;
+            default: return resultType(*aggregate->argument, columns);
+        }
+    }
+    if (auto unary = dynamic_cast<UnaryExpression*>(&expr)) {
+        DataType operand = resultType(*unary->operand, columns);
+        return unary->op == UnaryExpression::Operator::NOT ? DataType::BOOLEAN : operand;
+    }
+    if (auto binary = dynamic_cast<BinaryExpression*>(&expr)) {
+        DataType left = resultType(*binary->left, columns);
+        DataType right = resultType(*binary->right, columns);
+        switch (binary->op) {
+            case BinaryExpression::Operator::ADD:
+            case BinaryExpression::Operator::SUBTRACT:
+            case BinaryExpression::Operator::MULTIPLY:
+            case BinaryExpression::Operator::DIVIDE:
+                if (left == DataType::NULL_TYPE || right == DataType::NULL_TYPE) {
+                    return DataType::NULL_TYPE;
+                }
+                return left == DataType::INTEGER && right == DataType::INTEGER ? DataType::INTEGER : DataType::REAL;
+            default:
+                return DataType::BOOLEAN;
+        }
+    }
+    throw std::runtime_error("Unsupported expression");
+}
+
+// Column names follow PostgreSQL: the column, the aggregate function, or
+// ?column? for anything else
+std::string resultName(Expression& expr) {
+    if (auto column = dynamic_cast<ColumnExpression*>(&expr)) {
+        return column->column_name;
+    }
+    if (auto aggregate = dynamic_cast<AggregateExpression*>(&expr)) {
+        std::string name = aggregateFunctionName(aggregate->function);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        return name;
+    }
+    return "?column?";
+}
+
+} // namespace
+
 QueryEngine::QueryEngine() {
     codegen_ = std::make_unique<LLVMCodeGenerator>();
+    codegen_->setMaterializedViews(&materialized_views_);
+    registerSystemTables(database_, metrics_, codegen_->getJITStats(), memory_tracker_, query_registry_,
+                         result_cache_);
 }
 
 QueryEngine::~QueryEngine() = default;
@@ -13,31 +183,247 @@ QueryEngine::~QueryEngine() = default;
 std::vector<Row> QueryEngine::execute(const std::string& sql) {
     clearError();
     
+    auto start = std::chrono::steady_clock::now();
+    QueryExecution execution;
+    execution.control = query_registry_.start(sql, query_timeout_ms_);
+    auto results = executeStatement(sql, execution);
+    finishStatement(sql, execution, start, results.size());
+    return results;
+}
+
+std::vector<Row> QueryEngine::executeScript(const std::string& sql) {
+    clearError();
+    
+    // The statements outlive their executions, so they get one arena for
+    // the whole script
+    AstArena arena;
+    std::vector<ParsedStatement> statements;
+    try {
+        Lexer lexer(sql);
+        Parser parser(lexer.tokenize(), &arena);
+        statements = parser.parseScript();
+    } catch (const std::exception& e) {
+        setError(e.what());
+        return {};
+    }
+    auto script = mergeInserts(statements);
+    
+    // Each statement is registered, timed and logged on its own; scripts
+    // do not go through the result cache
+    std::vector<Row> results;
+    for (auto& statement : script) {
+        std::string text = statementText(sql, statement.parsed.source_begin, statement.parsed.source_end);
+        
+        auto start = std::chrono::steady_clock::now();
+        QueryExecution execution;
+        execution.statement = std::move(statement.parsed.statement);
+        execution.kind = classifyStatement(*execution.statement);
+        execution.control = query_registry_.start(text, query_timeout_ms_);
+        results = runStatement(execution, "");
+        if (!last_error_.empty() && !statement.merged.empty() && !interrupted(*execution.control)) {
+            // A failed INSERT stores nothing, so the merged statements run
+            // again one at a time: those before the failing one keep their
+            // rows and the error is reported for the statement that raised it
+            query_registry_.finish(execution.control->getQueryId());
+            clearError();
+            for (const auto& range : statement.merged) {
+                std::string part = statementText(sql, range.first, range.second);
+                auto part_start = std::chrono::steady_clock::now();
+                QueryExecution part_execution;
+                part_execution.control = query_registry_.start(part, query_timeout_ms_);
+                results = executeStatement(part, part_execution);
+                finishStatement(part, part_execution, part_start, results.size());
+                if (!last_error_.empty()) {
+                    break;
+                }
+            }
+        } else {
+            finishStatement(text, execution, start, results.size());
+        }
+        if (!last_error_.empty()) {
+            break;
+        }
+    }
+    return results;
+}
+
+std::vector<QueryEngine::ResultColumn> QueryEngine::describe(const std::string& sql) {
+    clearError();
+    std::vector<ResultColumn> result;
+    try {
+        AstArena arena;
+        Lexer lexer(sql);
+        Parser parser(lexer.tokenize(), &arena);
+        auto statement = parser.parseStatement();
+        auto select = dynamic_cast<SelectStatement*>(statement.get());
+        if (!select) {
+            return result;
+        }
+        
+        std::vector<VisibleColumn> columns;
+        auto addTable = [&](const std::string& table, const std::string& alias) {
+            for (const auto& column : tableSchema(database_, table).getColumns()) {
+                columns.push_back({alias.empty() ? table : alias, &column});
+            }
+        };
+        addTable(select->from_table, select->from_alias);
+        for (const auto& join : select->joins) {
+            addTable(join.table, join.alias);
+        }
+        
+        for (auto& expr : select->select_list) {
+            auto column = dynamic_cast<ColumnExpression*>(expr.get());
+            if (column && column->column_name == "*") {
+                for (const auto& visible : columns) {
+                    result.push_back({visible.column->name, visible.column->type});
+                }
+            } else {
+                result.push_back({resultName(*expr), resultType(*expr, columns)});
+            }
+        }
+    } catch (const std::exception& e) {
+        setError(e.what());
+        result.clear();
+    }
+    return result;
+}
+
+bool QueryEngine::executeForExport(const std::string& sql, Schema& schema, std::vector<Row>& results) {
+    auto columns = describe(sql);
+    if (!last_error_.empty()) {
+        return false;
+    }
+    results = execute(sql);
+    if (!last_error_.empty()) {
+        return false;
+    }
+    
+    Schema described;
+    for (const auto& column : columns) {
+        described.addColumn(Column(column.name, column.type));
+    }
+    schema = resolveResultSchema(described, results);
+    return true;
+}
+
+std::string QueryEngine::executeArrow(const std::string& sql) {
+    Schema schema;
+    std::vector<Row> results;
+    if (!executeForExport(sql, schema, results)) {
+        return {};
+    }
+    try {
+        return encodeArrowStream(schema, results);
+    } catch (const std::exception& e) {
+        setError(e.what());
+        return {};
+    }
+}
+
+bool QueryEngine::executeArrowArray(const std::string& sql, ArrowSchema* out_schema, ArrowArray* out_array) {
+    Schema schema;
+    std::vector<Row> results;
+    if (!executeForExport(sql, schema, results)) {
+        return false;
+    }
+    try {
+        auto columns = rowsToArrowColumns(schema, results, 0, results.size());
+        exportArrowColumns(std::move(columns), static_cast<int64_t>(results.size()), out_schema, out_array);
+        return true;
+    } catch (const std::exception& e) {
+        setError(e.what());
+        return false;
+    }
+}
+
+void QueryEngine::finishStatement(const std::string& sql, const QueryExecution& execution,
+                                  std::chrono::steady_clock::time_point start, uint64_t rows_returned) {
+    query_registry_.finish(execution.control->getQueryId());
+    uint64_t micros = elapsedMicros(start);
+    last_kind_ = execution.kind;
+    bool stores_rows = execution.kind == StatementKind::INSERT || execution.kind == StatementKind::COPY;
+    last_row_count_ = stores_rows ? codegen_->getRowsInserted() : rows_returned;
+    
+    metrics_.recordQuery(execution.kind, micros, rows_returned, !last_error_.empty());
+    if (slow_query_log_ && slow_query_log_->isSlow(micros)) {
+        logSlowQuery(sql, execution, micros, rows_returned);
+    }
+}
+
+std::vector<Row> QueryEngine::executeStatement(const std::string& sql, QueryExecution& execution) {
+    auto phase_start = std::chrono::steady_clock::now();
+    auto& phases = execution.phases;
+    std::string cache_key;
+    
     try {
         // Step 1: Tokenize the SQL
         Lexer lexer(sql);
         auto tokens = lexer.tokenize();
+        phases.lex_us = elapsedMicros(phase_start);
         
-        if (tokens.empty()) {
+        if (tokens.front().type == TokenType::EOF_TOKEN) {
             setError("No tokens found in SQL");
             return {};
         }
         
+        // Repeated reads of unchanged tables are answered from the cache
+        if (result_cache_.isEnabled() && tokens.front().type == TokenType::SELECT) {
+            cache_key = ResultCache::makeKey(tokens);
+            std::vector<Row> cached;
+            if (result_cache_.lookup(cache_key, database_, cached)) {
+                execution.kind = StatementKind::SELECT;
+                execution.cache_hit = true;
+                return cached;
+            }
+        }
+        
         // Step 2: Parse tokens into AST
-        Parser parser(tokens);
-        auto statement = parser.parseStatement();
+        Parser parser(tokens, &execution.arena);
+        execution.statement = parser.parseStatement();
+        phases.parse_us = elapsedMicros(phase_start);
         
-        if (!statement) {
+        if (!execution.statement) {
             setError("Failed to parse SQL statement");
             return {};
         }
+        execution.kind = classifyStatement(*execution.statement);
+    } catch (const std::exception& e) {
+        setError(e.what());
+        return {};
+    }
+    return runStatement(execution, cache_key);
+}
+
+std::vector<Row> QueryEngine::runStatement(QueryExecution& execution, const std::string& cache_key) {
+    auto phase_start = std::chrono::steady_clock::now();
+    auto& phases = execution.phases;
+    
+    try {
+        // Versions are captured up front so that a concurrent write makes
+        // the stored entry stale rather than being missed
+        std::vector<ResultCache::TableVersion> cache_tables;
+        bool cacheable = !cache_key.empty() && execution.kind == StatementKind::SELECT &&
+            collectCacheableTables(static_cast<SelectStatement&>(*execution.statement), database_, cache_tables);
         
         // Step 3: Generate and execute code
-        codegen_->generateCode(*statement, database_);
+        execution.control->checkInterrupt();
+        QueryMemoryContext memory(memory_tracker_, memory_tracker_.getQueryLimit());
+        codegen_->generateCode(*execution.statement, database_, &memory, execution.control.get());
+        if (codegen_->hasCompiledCode()) {
+            phases.codegen_us = elapsedMicros(phase_start);
+        }
         codegen_->execute();
+        // Kernels compiled while the scan runs count as execution
+        uint64_t jit_us = elapsedMicros(phase_start);
+        phases.compile_us = codegen_->getLastCompileMicros();
+        phases.execute_us = jit_us - std::min(jit_us, phases.compile_us);
         
-        // Step 4: Return results
-        return codegen_->getResults();
+        // Step 4: Hand the results over to the caller without copying
+        auto results = codegen_->takeResults();
+        if (cacheable) {
+            result_cache_.insert(cache_key, std::move(cache_tables), results);
+        }
+        return results;
         
     } catch (const std::exception& e) {
         setError(e.what());
@@ -45,4 +431,39 @@ std::vector<Row> QueryEngine::execute(const std::string& sql) {
     }
 }
 
-} // namespace sqlengine
\ No newline at end of file
+void QueryEngine::enableSlowQueryLog(const std::string& path, uint64_t threshold_us) {
+    slow_query_log_.reset();
+    slow_query_log_ = std::make_unique<SlowQueryLog>(path, threshold_us);
+}
+
+void QueryEngine::disableSlowQueryLog() {
+    slow_query_log_.reset();
+}
+
+void QueryEngine::logSlowQuery(const std::string& sql, const QueryExecution& execution,
+                               uint64_t duration_us, uint64_t rows_returned) {
+    SlowQueryRecord record;
+    record.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.duration_us = duration_us;
+    record.statement = statementKindName(execution.kind);
+    record.rows_returned = rows_returned;
+    record.phases = execution.phases;
+    record.error = last_error_;
+    
+    // Formatting work happens only for queries over the threshold
+    try {
+        Lexer lexer(sql);
+        record.normalized_sql = normalizeQuery(lexer.tokenize());
+    } catch (const std::exception&) {
+        record.normalized_sql = sql;
+    }
+    if (execution.statement) {
+        record.plan = describePlan(*execution.statement);
+        record.rows_scanned = codegen_->getRowsScanned();
+    }
+    
+    slow_query_log_->submit(std::move(record));
+}
+
+} // namespace sqlengine
@@ -0,0 +1,81 @@
+#include "query_runtime.h"
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Transforms/IPO/AlwaysInliner.h>
+#include <llvm/Transforms/IPO/GlobalDCE.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <stdexcept>
+
+namespace sqlengine {
+
+// Generated from query_runtime.ll at build time
+extern const unsigned char kQueryRuntimeBitcode[];
+extern const size_t kQueryRuntimeBitcode_size;
+
+std::unique_ptr<llvm::Module> loadQueryRuntime(llvm::LLVMContext& context) {
+    llvm::StringRef bitcode(reinterpret_cast<const char*>(kQueryRuntimeBitcode), kQueryRuntimeBitcode_size);
+    auto buffer = llvm::MemoryBuffer::getMemBuffer(bitcode, "query_runtime", /*RequiresNullTerminator=*/false);
+    auto runtime = llvm::getOwningLazyBitcodeModule(std::move(buffer), context);
+    if (!runtime) {
+        throw std::runtime_error("Failed to load query runtime: " + llvm::toString(runtime.takeError()));
+    }
+    return std::move(*runtime);
+}
+
+llvm::FunctionCallee declareRuntimeFunction(llvm::Module& module, const llvm::Module& runtime,
+                                            const std::string& name) {
+    const llvm::Function* function = runtime.getFunction(name);
+    if (!function || function->isIntrinsic()) {
+        throw std::runtime_error("Unknown runtime function: " + name);
+    }
+    return module.getOrInsertFunction(name, function->getFunctionType());
+}
+
+void linkQueryRuntime(llvm::Module& module) {
+    auto runtime = loadQueryRuntime(module.getContext());
+    bool used = false;
+    for (const auto& function : module.functions()) {
+        if (function.isDeclaration() && !function.isIntrinsic() && runtime->getFunction(function.getName())) {
+            used = true;
+            break;
+        }
+    }
+    if (!used) {
+        return;
+    }
+    
+    // Only the helpers the module refers to are materialized and linked;
+    // they become internal so that modules never share helper symbols
+    bool failed = llvm::Linker::linkModules(module, std::move(runtime), llvm::Linker::LinkOnlyNeeded,
+        [](llvm::Module& linked, const llvm::StringSet<>& helpers) {
+            llvm::internalizeModule(linked, [&helpers](const llvm::GlobalValue& value) {
+                return !value.hasName() || !helpers.count(value.getName());
+            });
+        });
+    if (failed) {
+        throw std::runtime_error("Failed to link query runtime");
+    }
+    
+    // Inline the helpers into their callers and drop the bodies
+    llvm::LoopAnalysisManager loop_analyses;
+    llvm::FunctionAnalysisManager function_analyses;
+    llvm::CGSCCAnalysisManager cgscc_analyses;
+    llvm::ModuleAnalysisManager module_analyses;
+    llvm::PassBuilder builder;
+    builder.registerModuleAnalyses(module_analyses);
+    builder.registerCGSCCAnalyses(cgscc_analyses);
+    builder.registerFunctionAnalyses(function_analyses);
+    builder.registerLoopAnalyses(loop_analyses);
+    builder.crossRegisterProxies(loop_analyses, function_analyses, cgscc_analyses, module_analyses);
+    
+    llvm::ModulePassManager passes;
+    passes.addPass(llvm::AlwaysInlinerPass());
+    passes.addPass(llvm::GlobalDCEPass());
+    passes.run(module, module_analyses);
+}
+
+} // namespace sqlengine
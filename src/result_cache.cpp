@@ -0,0 +1,111 @@
+#include "result_cache.h"
+
+namespace sqlengine {
+
+ResultCache::ResultCache(size_t capacity_bytes) : capacity_(capacity_bytes) {}
+
+void ResultCache::setCapacity(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_.store(bytes, std::memory_order_relaxed);
+    evictTo(bytes);
+}
+
+std::string ResultCache::makeKey(const std::vector<Token>& tokens) {
+    std::string key = normalizeQuery(tokens);
+    for (const auto& token : tokens) {
+        char tag;
+        switch (token.type) {
+            case TokenType::INTEGER_LITERAL: tag = 'i'; break;
+            case TokenType::REAL_LITERAL: tag = 'r'; break;
+            case TokenType::STRING_LITERAL: tag = 's'; break;
+            default: continue;
+        }
+        // Length-prefixed so that no literal value can run into the next one
+        key += '\0';
+        key += tag;
+        key += std::to_string(token.value.size());
+        key += ':';
+        key += token.value;
+    }
+    return key;
+}
+
+bool ResultCache::lookup(const std::string& key, const Database& database, std::vector<Row>& results) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto entry = found->second;
+    for (const auto& table : entry->tables) {
+        if (database.getTableVersion(table.table) != table.version) {
+            erase(entry);
+            invalidations_.fetch_add(1, std::memory_order_relaxed);
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    entries_.splice(entries_.begin(), entries_, entry);
+    results = entry->rows;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ResultCache::insert(const std::string& key, std::vector<TableVersion> tables, const std::vector<Row>& rows) {
+    size_t bytes = key.size() + sizeof(Entry);
+    for (const auto& table : tables) {
+        bytes += table.table.size() + sizeof(TableVersion);
+    }
+    for (const auto& row : rows) {
+        bytes += estimateRowSize(row);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t capacity = capacity_.load(std::memory_order_relaxed);
+    if (bytes > capacity) return;
+
+    auto existing = index_.find(key);
+    if (existing != index_.end()) {
+        erase(existing->second);
+    }
+    evictTo(capacity - bytes);
+
+    entries_.push_front(Entry{key, std::move(tables), rows, bytes});
+    index_.emplace(key, entries_.begin());
+    bytes_ += bytes;
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+size_t ResultCache::getBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+size_t ResultCache::getEntryCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void ResultCache::erase(std::list<Entry>::iterator entry) {
+    bytes_ -= entry->bytes;
+    index_.erase(entry->key);
+    entries_.erase(entry);
+}
+
+void ResultCache::evictTo(size_t capacity) {
+    while (bytes_ > capacity && !entries_.empty()) {
+        erase(std::prev(entries_.end()));
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace sqlengine
@@ -0,0 +1,67 @@
+; Runtime helpers for generated query code.
+;
+; Assembled to bitcode at build time and embedded in the engine (see
+; query_runtime.h). Helpers a query module calls are linked into it as
+; internal functions and, being alwaysinline, disappear into the caller,
+; so they cost no more than the equivalent hand-emitted IR.
+;
+; Conventions: NULL bitmaps hold one bit per row (set = NULL, least
+; significant bit first), and checked arithmetic returns the result
+; together with an error flag so callers can OR flags over a batch and
+; branch once.
+
+; ---------------------------------------------------------------------------
+; NULL bitmaps
+
+define i1 @sql_is_null(i8* %bitmap, i64 %row) alwaysinline {
+entry:
+  %byte_index = lshr i64 %row, 3
+  %ptr = getelementptr inbounds i8, i8* %bitmap, i64 %byte_index
+  %byte = load i8, i8* %ptr
+  %bit = trunc i64 %row to i8
+  %shift = and i8 %bit, 7
+  %shifted = lshr i8 %byte, %shift
+  %result = trunc i8 %shifted to i1
+  ret i1 %result
+}
+
+; ---------------------------------------------------------------------------
+; Checked arithmetic: { result, error }
+
+declare { i64, i1 } @llvm.sadd.with.overflow.i64(i64, i64)
+declare { i64, i1 } @llvm.ssub.with.overflow.i64(i64, i64)
+declare { i64, i1 } @llvm.smul.with.overflow.i64(i64, i64)
+
+define { i64, i1 } @sql_add_checked(i64 %a, i64 %b) alwaysinline {
+entry:
+  %result = call { i64, i1 } @llvm.sadd.with.overflow.i64(i64 %a, i64 %b)
+  ret { i64, i1 } %result
+}
+
+define { i64, i1 } @sql_sub_checked(i64 %a, i64 %b) alwaysinline {
+entry:
+  %result = call { i64, i1 } @llvm.ssub.with.overflow.i64(i64 %a, i64 %b)
+  ret { i64, i1 } %result
+}
+
+define { i64, i1 } @sql_mul_checked(i64 %a, i64 %b) alwaysinline {
+entry:
+  %result = call { i64, i1 } @llvm.smul.with.overflow.i64(i64 %a, i64 %b)
+  ret { i64, i1 } %result
+}
+
+; Division by zero and INT64_MIN / -1 are errors. The divisor is replaced
+; by 1 in those cases, so the division never traps and needs no branch.
+define { i64, i1 } @sql_div_checked(i64 %a, i64 %b) alwaysinline {
+entry:
+  %zero = icmp eq i64 %b, 0
+  %min = icmp eq i64 %a, -9223372036854775808
+  %minus_one = icmp eq i64 %b, -1
+  %overflow = and i1 %min, %minus_one
+  %error = or i1 %zero, %overflow
+  %divisor = select i1 %error, i64 1, i64 %b
+  %quotient = sdiv i64 %a, %divisor
+  %value = insertvalue { i64, i1 } undef, i64 %quotient, 0
+  %result = insertvalue { i64, i1 } %value, i1 %error, 1
+  ret { i64, i1 } %result
+}
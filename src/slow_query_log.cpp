@@ -0,0 +1,106 @@
+#include "slow_query_log.h"
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+namespace sqlengine {
+
+namespace {
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size() + 2);
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    escaped += buf;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+// Upper bound on how long the writer sleeps when it may have missed a wakeup
+constexpr auto kWriterPollInterval = std::chrono::milliseconds(100);
+
+} // namespace
+
+SlowQueryLog::SlowQueryLog(const std::string& path, uint64_t threshold_us, size_t queue_capacity)
+    : threshold_us_(threshold_us),
+      out_(path, std::ios::app),
+      queue_(queue_capacity) {
+    if (!out_) {
+        throw std::runtime_error("Cannot open slow query log: " + path);
+    }
+    writer_ = std::thread(&SlowQueryLog::writerLoop, this);
+}
+
+SlowQueryLog::~SlowQueryLog() {
+    stopping_.store(true, std::memory_order_release);
+    wakeup_.notify_one();
+    writer_.join();
+}
+
+bool SlowQueryLog::submit(SlowQueryRecord record) {
+    if (!queue_.tryPush(std::move(record))) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    wakeup_.notify_one();
+    return true;
+}
+
+void SlowQueryLog::writerLoop() {
+    while (!stopping_.load(std::memory_order_acquire)) {
+        if (drain() == 0) {
+            std::unique_lock<std::mutex> lock(wakeup_mutex_);
+            wakeup_.wait_for(lock, kWriterPollInterval);
+        }
+    }
+    drain();
+}
+
+size_t SlowQueryLog::drain() {
+    size_t count = 0;
+    SlowQueryRecord record;
+    while (queue_.tryPop(record)) {
+        writeRecord(record);
+        ++count;
+    }
+    if (count > 0) {
+        out_.flush();
+        written_.fetch_add(count, std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void SlowQueryLog::writeRecord(const SlowQueryRecord& record) {
+    out_ << "{\"timestamp_ms\":" << record.timestamp_ms
+         << ",\"duration_us\":" << record.duration_us
+         << ",\"statement\":\"" << jsonEscape(record.statement) << "\""
+         << ",\"sql\":\"" << jsonEscape(record.normalized_sql) << "\""
+         << ",\"plan\":\"" << jsonEscape(record.plan) << "\""
+         << ",\"rows_scanned\":" << record.rows_scanned
+         << ",\"rows_returned\":" << record.rows_returned
+         << ",\"phases_us\":{\"lex\":" << record.phases.lex_us
+         << ",\"parse\":" << record.phases.parse_us
+         << ",\"codegen\":" << record.phases.codegen_us
+         << ",\"compile\":" << record.phases.compile_us
+         << ",\"execute\":" << record.phases.execute_us << "}";
+    if (!record.error.empty()) {
+        out_ << ",\"error\":\"" << jsonEscape(record.error) << "\"";
+    }
+    out_ << "}\n";
+}
+
+} // namespace sqlengine
@@ -0,0 +1,406 @@
+#include "sort.h"
+#include "pdqsort.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace sqlengine {
+
+namespace {
+
+// Runs merged at once; more runs are merged in several passes so that
+// the number of open readers (and their buffers) stays bounded
+constexpr size_t kMaxMergeFanIn = 64;
+constexpr size_t kMergeBlockSize = 64 * 1024;
+
+// Radix buckets at most this large are finished with pdqsort
+constexpr size_t kRadixSortCutoff = 64;
+
+void appendBigEndian(std::string& out, uint64_t value) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+}
+
+} // namespace
+
+void encodeSortKey(const Row& row, const std::vector<SortColumn>& columns, std::string& out) {
+    for (const auto& column : columns) {
+        const Value& value = row[column.index];
+
+        // The NULL marker is not inverted for DESC, so NULL placement is
+        // controlled only by nulls_first
+        if (value.isNull()) {
+            out.push_back(column.nulls_first ? 0 : 2);
+            continue;
+        }
+        out.push_back(1);
+
+        size_t start = out.size();
+        switch (value.getType()) {
+            case DataType::INTEGER:
+                // Flipping the sign bit makes two's complement order unsigned
+                appendBigEndian(out, static_cast<uint64_t>(value.get<int64_t>()) ^ (uint64_t(1) << 63));
+                break;
+            case DataType::REAL: {
+                double d = value.get<double>();
+                if (d == 0.0) d = 0.0; // -0.0 sorts equal to 0.0
+                if (std::isnan(d)) d = std::numeric_limits<double>::quiet_NaN();
+                uint64_t bits;
+                std::memcpy(&bits, &d, sizeof(bits));
+                bits = (bits >> 63) ? ~bits : bits ^ (uint64_t(1) << 63);
+                appendBigEndian(out, bits);
+                break;
+            }
+            case DataType::BOOLEAN:
+                out.push_back(value.get<bool>() ? 1 : 0);
+                break;
+            case DataType::TEXT:
+                // 0x00 is escaped as 0x00 0xFF and the string ends with
+                // 0x00 0x00, so prefixes sort before longer strings
+                for (char c : value.get<std::string>()) {
+                    out.push_back(c);
+                    if (c == '\0') out.push_back(static_cast<char>(0xFF));
+                }
+                out.push_back(0);
+                out.push_back(0);
+                break;
+            default:
+                break;
+        }
+
+        if (column.descending) {
+            for (size_t i = start; i < out.size(); ++i) {
+                out[i] = static_cast<char>(~static_cast<unsigned char>(out[i]));
+            }
+        }
+    }
+}
+
+// K-way merge of sorted runs using a loser tree: each output row costs
+// log2(k) key comparisons, replaying only the path of the source it came from
+class ExternalSorter::Merger {
+public:
+    explicit Merger(const std::vector<SpillFile*>& runs) {
+        for (auto* run : runs) {
+            Source source;
+            source.reader = std::make_unique<SpillReader>(*run, kMergeBlockSize);
+            source.exhausted = !source.reader->next(source.record);
+            sources_.push_back(std::move(source));
+        }
+        build();
+    }
+
+    bool nextRecord(std::string& record) {
+        if (sources_.empty()) {
+            return false;
+        }
+        size_t winner = tree_[0];
+        Source& source = sources_[winner];
+        if (source.exhausted) {
+            return false;
+        }
+        record.swap(source.record);
+        source.exhausted = !source.reader->next(source.record);
+        replay(winner);
+        return true;
+    }
+
+private:
+    struct Source {
+        std::unique_ptr<SpillReader> reader;
+        std::string record;
+        bool exhausted = false;
+    };
+
+    std::vector<Source> sources_;
+    std::vector<size_t> tree_; // tree_[0] is the winner, tree_[1..k-1] hold losers
+
+    // Exhausted sources compare greater than everything; ties go to the
+    // earlier run, which keeps the merge stable
+    bool less(size_t a, size_t b) const {
+        if (sources_[a].exhausted) return false;
+        if (sources_[b].exhausted) return true;
+        int cmp = keyedRecordKey(sources_[a].record).compare(keyedRecordKey(sources_[b].record));
+        return cmp < 0 || (cmp == 0 && a < b);
+    }
+
+    void build() {
+        size_t k = sources_.size();
+        tree_.assign(std::max<size_t>(k, 1), 0);
+        if (k == 0) {
+            return;
+        }
+
+        // winners[n] is the winner of the subtree rooted at node n; leaves are k..2k-1
+        std::vector<size_t> winners(2 * k);
+        for (size_t i = 0; i < k; ++i) {
+            winners[k + i] = i;
+        }
+        for (size_t node = k - 1; node >= 1; --node) {
+            size_t left = winners[2 * node];
+            size_t right = winners[2 * node + 1];
+            if (less(left, right)) {
+                winners[node] = left;
+                tree_[node] = right;
+            } else {
+                winners[node] = right;
+                tree_[node] = left;
+            }
+        }
+        tree_[0] = (k == 1) ? 0 : winners[1];
+    }
+
+    void replay(size_t source) {
+        size_t k = sources_.size();
+        size_t winner = source;
+        for (size_t node = (source + k) / 2; node >= 1; node /= 2) {
+            if (less(tree_[node], winner)) {
+                std::swap(tree_[node], winner);
+            }
+        }
+        tree_[0] = winner;
+    }
+};
+
+ExternalSorter::ExternalSorter(std::vector<SortColumn> columns, QueryMemoryContext* memory,
+                               std::string spill_directory)
+    : columns_(std::move(columns)), memory_(memory), spill_directory_(std::move(spill_directory)) {}
+
+ExternalSorter::~ExternalSorter() {
+    merger_.reset();
+    releaseBuffer();
+}
+
+void ExternalSorter::add(Row row) {
+    scratch_key_.clear();
+    encodeSortKey(row, columns_, scratch_key_);
+
+    // The slot is counted twice to cover the radix sort's scatter buffer
+    size_t bytes = 2 * sizeof(SortSlot) + scratch_key_.size() + estimateRowSize(row);
+    if (memory_ && !memory_->tryReserve(bytes)) {
+        // Out of budget: write the buffered rows out as a sorted run. A
+        // single row that does not fit on its own is a hard error.
+        if (!rows_.empty()) {
+            spillRun();
+        }
+        memory_->reserve(bytes);
+    }
+    buffered_bytes_ += bytes;
+
+    SortSlot slot;
+    slot.prefix = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        unsigned char byte = i < scratch_key_.size() ? static_cast<unsigned char>(scratch_key_[i]) : 0;
+        slot.prefix = (slot.prefix << 8) | byte;
+    }
+    slot.key_offset = key_arena_.size();
+    slot.key_length = static_cast<uint32_t>(scratch_key_.size());
+    slot.row = static_cast<uint32_t>(rows_.size());
+
+    key_arena_.append(scratch_key_);
+    rows_.push_back(std::move(row));
+    slots_.push_back(slot);
+}
+
+void ExternalSorter::finish() {
+    if (runs_.empty()) {
+        sortBuffer();
+        output_position_ = 0;
+        return;
+    }
+
+    if (!rows_.empty()) {
+        spillRun();
+    }
+
+    // Reduce the number of runs until they can be merged in one pass. Each
+    // pass merges consecutive groups of runs, and every merged run takes
+    // the place of its inputs, so runs stay in input order and ties still
+    // favor earlier rows.
+    while (runs_.size() > kMaxMergeFanIn) {
+        std::vector<std::unique_ptr<SpillFile>> merged_runs;
+        for (size_t begin = 0; begin < runs_.size(); begin += kMaxMergeFanIn) {
+            size_t end = std::min(runs_.size(), begin + kMaxMergeFanIn);
+            if (end - begin == 1) {
+                merged_runs.push_back(std::move(runs_[begin]));
+                continue;
+            }
+            std::vector<SpillFile*> group;
+            for (size_t i = begin; i < end; ++i) {
+                group.push_back(runs_[i].get());
+            }
+
+            auto merged = std::make_unique<SpillFile>(spill_directory_);
+            {
+                Merger merger(group);
+                std::string record;
+                while (merger.nextRecord(record)) {
+                    merged->appendRecord(record);
+                }
+            }
+            merged->finishWriting();
+            merged_runs.push_back(std::move(merged));
+        }
+        runs_ = std::move(merged_runs);
+    }
+
+    std::vector<SpillFile*> all_runs;
+    for (auto& run : runs_) {
+        all_runs.push_back(run.get());
+    }
+    merger_ = std::make_unique<Merger>(all_runs);
+}
+
+bool ExternalSorter::next(Row& row) {
+    if (merger_) {
+        std::string record;
+        if (!merger_->nextRecord(record)) {
+            return false;
+        }
+        row = keyedRecordRow(record);
+        return true;
+    }
+
+    if (output_position_ >= slots_.size()) {
+        releaseBuffer();
+        return false;
+    }
+
+    // Rows are moved out as they are returned, so release their share of
+    // the budget right away; keys and slots are released at the end
+    row = std::move(rows_[slots_[output_position_++].row]);
+    if (memory_) {
+        size_t row_bytes = std::min(estimateRowSize(row), buffered_bytes_);
+        memory_->release(row_bytes);
+        buffered_bytes_ -= row_bytes;
+    }
+    return true;
+}
+
+namespace {
+
+// Byte `depth` of a slot's key as a radix bucket: 0 once the key has
+// ended, otherwise byte value + 1
+inline size_t radixBucket(uint64_t prefix, const char* arena, uint64_t key_offset,
+                          uint32_t key_length, size_t depth) {
+    if (depth >= key_length) {
+        return 0;
+    }
+    if (depth < 8) {
+        return ((prefix >> (56 - 8 * depth)) & 0xFF) + 1;
+    }
+    return static_cast<unsigned char>(arena[key_offset + depth]) + 1;
+}
+
+} // namespace
+
+void ExternalSorter::sortBuffer() {
+    if (slots_.size() < 2) {
+        return;
+    }
+    std::vector<SortSlot> scratch(slots_.size());
+    radixSort(slots_.data(), slots_.data() + slots_.size(), 0, scratch.data());
+}
+
+void ExternalSorter::radixSort(SortSlot* begin, SortSlot* end, size_t depth, SortSlot* scratch) {
+    const char* arena = key_arena_.data();
+
+    for (;;) {
+        size_t count = static_cast<size_t>(end - begin);
+
+        if (count <= kRadixSortCutoff) {
+            // All keys in the bucket share their first `depth` bytes.
+            // Ties fall back to insertion order, which keeps the sort stable.
+            pdqsort(begin, end, [arena, depth](const SortSlot& a, const SortSlot& b) {
+                if (depth < 8 && a.prefix != b.prefix) {
+                    return a.prefix < b.prefix;
+                }
+                size_t from = std::max<size_t>(depth, 8);
+                size_t common = std::min(a.key_length, b.key_length);
+                if (from < common) {
+                    int cmp = std::memcmp(arena + a.key_offset + from, arena + b.key_offset + from, common - from);
+                    if (cmp != 0) return cmp < 0;
+                }
+                if (a.key_length != b.key_length) return a.key_length < b.key_length;
+                return a.row < b.row;
+            });
+            return;
+        }
+
+        size_t counts[257] = {0};
+        for (SortSlot* slot = begin; slot != end; ++slot) {
+            ++counts[radixBucket(slot->prefix, arena, slot->key_offset, slot->key_length, depth)];
+        }
+
+        // Skip bytes every key shares without moving anything. Keys that
+        // have all ended are equal and already in insertion order.
+        if (counts[0] == count) {
+            return;
+        }
+        bool single_bucket = false;
+        for (size_t bucket = 1; bucket < 257; ++bucket) {
+            if (counts[bucket] == count) {
+                single_bucket = true;
+                break;
+            }
+        }
+        if (single_bucket) {
+            ++depth;
+            continue;
+        }
+
+        // Stable scatter into the scratch buffer, then copy back
+        size_t offsets[257];
+        size_t total = 0;
+        for (size_t bucket = 0; bucket < 257; ++bucket) {
+            offsets[bucket] = total;
+            total += counts[bucket];
+        }
+        for (SortSlot* slot = begin; slot != end; ++slot) {
+            scratch[offsets[radixBucket(slot->prefix, arena, slot->key_offset, slot->key_length, depth)]++] = *slot;
+        }
+        std::copy(scratch, scratch + count, begin);
+
+        size_t start = counts[0];
+        for (size_t bucket = 1; bucket < 257; ++bucket) {
+            if (counts[bucket] > 1) {
+                radixSort(begin + start, begin + start + counts[bucket], depth + 1, scratch + start);
+            }
+            start += counts[bucket];
+        }
+        return;
+    }
+}
+
+void ExternalSorter::spillRun() {
+    sortBuffer();
+
+    auto run = std::make_unique<SpillFile>(spill_directory_);
+    std::string record;
+    std::string key;
+    for (const auto& slot : slots_) {
+        key.assign(key_arena_, slot.key_offset, slot.key_length);
+        record.clear();
+        encodeKeyedRecord(key, rows_[slot.row], record);
+        run->appendRecord(record);
+    }
+    run->finishWriting();
+    runs_.push_back(std::move(run));
+
+    releaseBuffer();
+}
+
+void ExternalSorter::releaseBuffer() {
+    if (memory_ && buffered_bytes_ > 0) {
+        memory_->release(buffered_bytes_);
+    }
+    buffered_bytes_ = 0;
+    output_position_ = 0;
+    std::string().swap(key_arena_);
+    std::vector<Row>().swap(rows_);
+    std::vector<SortSlot>().swap(slots_);
+}
+
+} // namespace sqlengine
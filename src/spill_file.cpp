@@ -0,0 +1,256 @@
+#include "spill_file.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace sqlengine {
+
+namespace {
+
+enum class ValueTag : uint8_t {
+    NULL_VALUE = 0,
+    INTEGER = 1,
+    REAL = 2,
+    TEXT = 3,
+    BOOLEAN = 4
+};
+
+template<typename T>
+void appendRaw(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+T readRaw(const char*& cursor, const char* end) {
+    if (static_cast<size_t>(end - cursor) < sizeof(T)) {
+        throw std::runtime_error("Corrupt spill record");
+    }
+    T value;
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+
+} // namespace
+
+void encodeRow(const Row& row, std::string& out) {
+    appendRaw<uint32_t>(out, static_cast<uint32_t>(row.size()));
+    for (const auto& value : row) {
+        switch (value.getType()) {
+            case DataType::INTEGER:
+                out.push_back(static_cast<char>(ValueTag::INTEGER));
+                appendRaw<int64_t>(out, value.get<int64_t>());
+                break;
+            case DataType::REAL:
+                out.push_back(static_cast<char>(ValueTag::REAL));
+                appendRaw<double>(out, value.get<double>());
+                break;
+            case DataType::TEXT: {
+                const auto& text = value.get<std::string>();
+                out.push_back(static_cast<char>(ValueTag::TEXT));
+                appendRaw<uint32_t>(out, static_cast<uint32_t>(text.size()));
+                out.append(text);
+                break;
+            }
+            case DataType::BOOLEAN:
+                out.push_back(static_cast<char>(ValueTag::BOOLEAN));
+                out.push_back(value.get<bool>() ? 1 : 0);
+                break;
+            default:
+                out.push_back(static_cast<char>(ValueTag::NULL_VALUE));
+                break;
+        }
+    }
+}
+
+Row decodeRow(const char* data, size_t length) {
+    const char* cursor = data;
+    const char* end = data + length;
+
+    Row row;
+    row.reserve(readRaw<uint32_t>(cursor, end));
+    while (cursor < end) {
+        auto tag = static_cast<ValueTag>(readRaw<uint8_t>(cursor, end));
+        switch (tag) {
+            case ValueTag::INTEGER:
+                row.emplace_back(readRaw<int64_t>(cursor, end));
+                break;
+            case ValueTag::REAL:
+                row.emplace_back(readRaw<double>(cursor, end));
+                break;
+            case ValueTag::TEXT: {
+                auto size = readRaw<uint32_t>(cursor, end);
+                if (static_cast<size_t>(end - cursor) < size) {
+                    throw std::runtime_error("Corrupt spill record");
+                }
+                row.emplace_back(std::string(cursor, size));
+                cursor += size;
+                break;
+            }
+            case ValueTag::BOOLEAN:
+                row.emplace_back(readRaw<uint8_t>(cursor, end) != 0);
+                break;
+            default:
+                row.emplace_back(nullptr);
+                break;
+        }
+    }
+    return row;
+}
+
+void encodeKeyedRecord(const std::string& key, const Row& row, std::string& out) {
+    appendRaw<uint32_t>(out, static_cast<uint32_t>(key.size()));
+    out.append(key);
+    encodeRow(row, out);
+}
+
+std::string_view keyedRecordKey(const std::string& record) {
+    const char* cursor = record.data();
+    auto key_length = readRaw<uint32_t>(cursor, record.data() + record.size());
+    if (record.size() - sizeof(uint32_t) < key_length) {
+        throw std::runtime_error("Corrupt spill record");
+    }
+    return std::string_view(cursor, key_length);
+}
+
+Row keyedRecordRow(const std::string& record) {
+    size_t offset = sizeof(uint32_t) + keyedRecordKey(record).size();
+    return decodeRow(record.data() + offset, record.size() - offset);
+}
+
+// SpillFile implementation
+SpillFile::SpillFile(const std::string& directory) {
+    std::string path = directory + "/sqlengine_spill_XXXXXX";
+    std::vector<char> path_buffer(path.begin(), path.end());
+    path_buffer.push_back('\0');
+
+    fd_ = ::mkstemp(path_buffer.data());
+    if (fd_ < 0) {
+        throw std::runtime_error("Cannot create spill file in " + directory + ": " + std::strerror(errno));
+    }
+    ::unlink(path_buffer.data());
+    write_buffer_.reserve(kWriteBufferSize);
+}
+
+SpillFile::~SpillFile() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void SpillFile::appendRecord(const std::string& record) {
+    appendRaw<uint32_t>(write_buffer_, static_cast<uint32_t>(record.size()));
+    write_buffer_.append(record);
+    ++records_;
+    if (write_buffer_.size() >= kWriteBufferSize) {
+        flushBuffer();
+    }
+}
+
+void SpillFile::finishWriting() {
+    flushBuffer();
+}
+
+void SpillFile::flushBuffer() {
+    const char* data = write_buffer_.data();
+    size_t remaining = write_buffer_.size();
+    while (remaining > 0) {
+        ssize_t written = ::pwrite(fd_, data, remaining, static_cast<off_t>(size_));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("Spill write failed: ") + std::strerror(errno));
+        }
+        data += written;
+        remaining -= static_cast<size_t>(written);
+        size_ += static_cast<uint64_t>(written);
+    }
+    write_buffer_.clear();
+}
+
+size_t SpillFile::readAt(uint64_t offset, char* buffer, size_t length) const {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t n = ::pread(fd_, buffer + total, length - total, static_cast<off_t>(offset + total));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("Spill read failed: ") + std::strerror(errno));
+        }
+        if (n == 0) break;
+        total += static_cast<size_t>(n);
+    }
+    return total;
+}
+
+// SpillReader implementation
+SpillReader::SpillReader(const SpillFile& file, size_t block_size)
+    : file_(file), block_size_(block_size) {
+    block_ = readBlock(0);
+    next_offset_ = block_.size();
+    startPrefetch();
+}
+
+SpillReader::~SpillReader() {
+    if (prefetch_.valid()) {
+        prefetch_.wait();
+    }
+}
+
+std::vector<char> SpillReader::readBlock(uint64_t offset) const {
+    std::vector<char> block;
+    if (offset >= file_.getSize()) {
+        return block;
+    }
+    block.resize(static_cast<size_t>(std::min<uint64_t>(block_size_, file_.getSize() - offset)));
+    block.resize(file_.readAt(offset, block.data(), block.size()));
+    return block;
+}
+
+void SpillReader::startPrefetch() {
+    if (next_offset_ >= file_.getSize()) {
+        return;
+    }
+    uint64_t offset = next_offset_;
+    prefetch_ = std::async(std::launch::async, [this, offset]() { return readBlock(offset); });
+}
+
+bool SpillReader::advanceBlock() {
+    if (!prefetch_.valid()) {
+        return false;
+    }
+    block_ = prefetch_.get();
+    position_ = 0;
+    next_offset_ += block_.size();
+    startPrefetch();
+    return !block_.empty();
+}
+
+bool SpillReader::readBytes(char* out, size_t length) {
+    while (length > 0) {
+        if (position_ == block_.size() && !advanceBlock()) {
+            return false;
+        }
+        size_t chunk = std::min(length, block_.size() - position_);
+        std::memcpy(out, block_.data() + position_, chunk);
+        position_ += chunk;
+        out += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool SpillReader::next(std::string& record) {
+    uint32_t length;
+    if (!readBytes(reinterpret_cast<char*>(&length), sizeof(length))) {
+        return false;
+    }
+    record.resize(length);
+    if (!readBytes(&record[0], length)) {
+        throw std::runtime_error("Truncated spill record");
+    }
+    return true;
+}
+
+} // namespace sqlengine
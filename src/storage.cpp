@@ -1,6 +1,7 @@
 #include "storage.h"
 #include <stdexcept>
 #include <algorithm>
+#include <atomic>
 
 namespace sqlengine {
 
@@ -69,6 +70,16 @@ bool Value::operator!=(const Value& other) const {
     return !(*this == other);
 }
 
+size_t estimateRowSize(const Row& row) {
+    size_t size = sizeof(Row) + row.capacity() * sizeof(Value);
+    for (const auto& value : row) {
+        if (value.getType() == DataType::TEXT) {
+            size += value.get<std::string>().size();
+        }
+    }
+    return size;
+}
+
 // Schema implementation
 void Schema::addColumn(const Column& col) {
     column_index_[col.name] = columns_.size();
@@ -99,21 +110,75 @@ size_t Schema::getColumnIndex(const std::string& name) const {
 }
 
 // Table implementation
+namespace {
+
+std::atomic<uint64_t> table_version_counter{0};
+
+uint64_t nextTableVersion() {
+    return table_version_counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+} // namespace
+
 Table::Table(const std::string& name, const Schema& schema)
-    : name_(name), schema_(schema) {}
+    : name_(name), schema_(schema), version_(nextTableVersion()) {}
 
 void Table::insertRow(const Row& row) {
     if (!validateRow(row)) {
         throw std::runtime_error("Row validation failed");
     }
+    notifyInsert(&row, 1);
+    byte_size_ += estimateRowSize(row);
     rows_.push_back(row);
+    version_ = nextTableVersion();
 }
 
 void Table::insertRow(Row&& row) {
     if (!validateRow(row)) {
         throw std::runtime_error("Row validation failed");
     }
+    notifyInsert(&row, 1);
+    byte_size_ += estimateRowSize(row);
     rows_.push_back(std::move(row));
+    version_ = nextTableVersion();
+}
+
+void Table::insertRows(std::vector<Row>&& rows) {
+    for (const auto& row : rows) {
+        if (!validateRow(row)) {
+            throw std::runtime_error("Row validation failed");
+        }
+    }
+    rows_.reserve(rows_.size() + rows.size());
+    notifyInsert(rows.data(), rows.size());
+    for (auto& row : rows) {
+        byte_size_ += estimateRowSize(row);
+        rows_.push_back(std::move(row));
+    }
+    version_ = nextTableVersion();
+}
+
+void Table::addListener(std::shared_ptr<TableListener> listener) {
+    listeners_.push_back(std::move(listener));
+}
+
+void Table::removeListener(const TableListener* listener) {
+    listeners_.erase(std::remove_if(listeners_.begin(), listeners_.end(),
+                                    [listener](const auto& entry) { return entry.get() == listener; }),
+                     listeners_.end());
+}
+
+void Table::notifyInsert(const Row* rows, size_t count) {
+    if (listeners_.empty()) {
+        return;
+    }
+    // No listener applies the rows until every listener has accepted them
+    for (const auto& listener : listeners_) {
+        listener->prepareInsert(rows, count);
+    }
+    for (const auto& listener : listeners_) {
+        listener->commitInsert();
+    }
 }
 
 bool Table::validateRow(const Row& row) const {
@@ -142,9 +207,44 @@ bool Table::validateRow(const Row& row) const {
     return true;
 }
 
+// VirtualTable implementation
+VirtualTable::VirtualTable(const std::string& name, const Schema& schema, RowGenerator generator)
+    : name_(name), schema_(schema), generator_(std::move(generator)) {}
+
+VirtualTable::VirtualTable(const std::string& name, const Schema& schema, ScanGenerator generator,
+                           const std::string& source_path)
+    : name_(name), schema_(schema), scan_generator_(std::move(generator)), source_path_(source_path) {}
+
+std::unique_ptr<Table> VirtualTable::materialize() const {
+    ScanRequest request;
+    request.columns.assign(schema_.getColumnCount(), true);
+    return materialize(request);
+}
+
+std::unique_ptr<Table> VirtualTable::materialize(const ScanRequest& request) const {
+    if (!scan_generator_) {
+        auto snapshot = std::make_unique<Table>(name_, schema_);
+        snapshot->insertRows(generator_());
+        return snapshot;
+    }
+    
+    // Columns left out of the scan hold NULLs, also where they are NOT NULL
+    Schema schema;
+    for (size_t i = 0; i < schema_.getColumnCount(); ++i) {
+        Column column = schema_.getColumn(i);
+        if (i >= request.columns.size() || !request.columns[i]) {
+            column.nullable = true;
+        }
+        schema.addColumn(column);
+    }
+    auto snapshot = std::make_unique<Table>(name_, schema);
+    snapshot->insertRows(scan_generator_(request));
+    return snapshot;
+}
+
 // Database implementation
 void Database::createTable(const std::string& name, const Schema& schema) {
-    if (hasTable(name)) {
+    if (hasTable(name) || hasVirtualTable(name)) {
         throw std::runtime_error("Table already exists: " + name);
     }
     tables_[name] = std::make_unique<Table>(name, schema);
@@ -165,9 +265,17 @@ bool Database::hasTable(const std::string& name) const {
 }
 
 void Database::dropTable(const std::string& name) {
+    if (hasVirtualTable(name)) {
+        throw std::runtime_error("Cannot drop system table: " + name);
+    }
     tables_.erase(name);
 }
 
+uint64_t Database::getTableVersion(const std::string& name) const {
+    const Table* table = getTable(name);
+    return table ? table->getVersion() : 0;
+}
+
 std::vector<std::string> Database::getTableNames() const {
     std::vector<std::string> names;
     for (const auto& pair : tables_) {
@@ -177,4 +285,35 @@ std::vector<std::string> Database::getTableNames() const {
     return names;
 }
 
+void Database::registerVirtualTable(const std::string& name, const Schema& schema,
+                                    VirtualTable::RowGenerator generator) {
+    if (hasTable(name) || hasVirtualTable(name)) {
+        throw std::runtime_error("Table already exists: " + name);
+    }
+    virtual_tables_[name] = std::make_unique<VirtualTable>(name, schema, std::move(generator));
+}
+
+void Database::registerExternalTable(const std::string& name, const Schema& schema,
+                                     VirtualTable::ScanGenerator generator, const std::string& source_path) {
+    if (hasTable(name) || hasVirtualTable(name)) {
+        throw std::runtime_error("Table already exists: " + name);
+    }
+    virtual_tables_[name] = std::make_unique<VirtualTable>(name, schema, std::move(generator), source_path);
+}
+
+const VirtualTable* Database::getVirtualTable(const std::string& name) const {
+    auto it = virtual_tables_.find(name);
+    return (it != virtual_tables_.end()) ? it->second.get() : nullptr;
+}
+
+bool Database::hasVirtualTable(const std::string& name) const {
+    return virtual_tables_.find(name) != virtual_tables_.end();
+}
+
+void Database::dropVirtualTable(const std::string& name) {
+    if (virtual_tables_.erase(name) == 0) {
+        throw std::runtime_error("Table not found: " + name);
+    }
+}
+
 } // namespace sqlengine
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "system_tables.h"
+
+namespace sqlengine {
+
+namespace {
+
+Value count(uint64_t value) {
+    return Value(static_cast<int64_t>(value));
+}
+
+Schema makeSchema(const std::vector<Column>& columns) {
+    Schema schema;
+    for (const auto& col : columns) {
+        schema.addColumn(col);
+    }
+    return schema;
+}
+
+const StatementKind kReportedKinds[] = {
+    StatementKind::SELECT,
+    StatementKind::INSERT,
+    StatementKind::CREATE_TABLE,
+    StatementKind::DROP_TABLE,
+    StatementKind::CREATE_MATERIALIZED_VIEW,
+    StatementKind::DROP_MATERIALIZED_VIEW,
+    StatementKind::COPY,
+    StatementKind::INVALID
+};
+
+} // namespace
+
+void registerSystemTables(Database& database, const EngineMetrics& metrics, const JITStats& jit_stats,
+                          const MemoryTracker& memory_tracker, const QueryRegistry& query_registry,
+                          const ResultCache& result_cache) {
+    database.registerVirtualTable("sys_queries", makeSchema({
+        Column("statement", DataType::TEXT),
+        Column("executions", DataType::INTEGER),
+        Column("errors", DataType::INTEGER),
+        Column("rows_returned", DataType::INTEGER),
+        Column("total_us", DataType::INTEGER),
+        Column("max_us", DataType::INTEGER),
+        Column("p50_us", DataType::INTEGER),
+        Column("p95_us", DataType::INTEGER),
+        Column("p99_us", DataType::INTEGER)
+    }), [&metrics]() {
+        std::vector<Row> rows;
+        for (StatementKind kind : kReportedKinds) {
+            const auto& m = metrics.get(kind);
+            rows.push_back({
+                Value(std::string(statementKindName(kind))),
+                count(m.executions.load(std::memory_order_relaxed)),
+                count(m.errors.load(std::memory_order_relaxed)),
+                count(m.rows_returned.load(std::memory_order_relaxed)),
+                count(m.latency.getTotalMicros()),
+                count(m.latency.getMaxMicros()),
+                count(m.latency.percentile(0.50)),
+                count(m.latency.percentile(0.95)),
+                count(m.latency.percentile(0.99))
+            });
+        }
+        return rows;
+    });
+
+    database.registerVirtualTable("sys_query_latency", makeSchema({
+        Column("statement", DataType::TEXT),
+        Column("le_us", DataType::INTEGER),
+        Column("count", DataType::INTEGER)
+    }), [&metrics]() {
+        std::vector<Row> rows;
+        for (StatementKind kind : kReportedKinds) {
+            const auto& latency = metrics.get(kind).latency;
+            for (size_t i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+                uint64_t bucket_count = latency.getBucketCount(i);
+                if (bucket_count == 0) {
+                    continue;
+                }
+                rows.push_back({
+                    Value(std::string(statementKindName(kind))),
+                    count(LatencyHistogram::getBucketUpperBound(i)),
+                    count(bucket_count)
+                });
+            }
+        }
+        return rows;
+    });
+
+    database.registerVirtualTable("sys_tables", makeSchema({
+        Column("name", DataType::TEXT),
+        Column("row_count", DataType::INTEGER),
+        Column("column_count", DataType::INTEGER),
+        Column("bytes", DataType::INTEGER)
+    }), [&database]() {
+        std::vector<Row> rows;
+        for (const auto& name : database.getTableNames()) {
+            const Table* table = database.getTable(name);
+            rows.push_back({
+                Value(name),
+                count(table->getRowCount()),
+                count(table->getSchema().getColumnCount()),
+                count(table->getByteSize())
+            });
+        }
+        return rows;
+    });
+
+    database.registerVirtualTable("sys_jit_cache", makeSchema({
+        Column("modules_compiled", DataType::INTEGER),
+        Column("compile_us", DataType::INTEGER),
+        Column("cache_hits", DataType::INTEGER),
+        Column("cache_misses", DataType::INTEGER),
+        Column("object_cache_loads", DataType::INTEGER),
+        Column("hit_rate", DataType::REAL),
+        Column("morsels_interpreted", DataType::INTEGER),
+        Column("morsels_compiled", DataType::INTEGER),
+        Column("kernel_compile_errors", DataType::INTEGER)
+    }), [&jit_stats]() {
+        uint64_t hits = jit_stats.cache_hits.load(std::memory_order_relaxed);
+        uint64_t misses = jit_stats.cache_misses.load(std::memory_order_relaxed);
+        double hit_rate = (hits + misses) ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+        return std::vector<Row>{{
+            count(jit_stats.modules_compiled.load(std::memory_order_relaxed)),
+            count(jit_stats.compile_micros.load(std::memory_order_relaxed)),
+            count(hits),
+            count(misses),
+            count(jit_stats.object_cache_loads.load(std::memory_order_relaxed)),
+            Value(hit_rate),
+            count(jit_stats.morsels_interpreted.load(std::memory_order_relaxed)),
+            count(jit_stats.morsels_compiled.load(std::memory_order_relaxed)),
+            count(jit_stats.kernel_compile_errors.load(std::memory_order_relaxed))
+        }};
+    });
+
+    database.registerVirtualTable("sys_memory", makeSchema({
+        Column("component", DataType::TEXT),
+        Column("bytes", DataType::INTEGER)
+    }), [&database, &memory_tracker, &result_cache]() {
+        uint64_t table_bytes = 0;
+        for (const auto& name : database.getTableNames()) {
+            table_bytes += database.getTable(name)->getByteSize();
+        }
+        return std::vector<Row>{
+            {Value(std::string("table_data")), count(table_bytes)},
+            {Value(std::string("query_memory_used")), count(memory_tracker.getUsed())},
+            {Value(std::string("query_memory_peak")), count(memory_tracker.getPeak())},
+            {Value(std::string("query_memory_limit")), count(memory_tracker.getQueryLimit())},
+            {Value(std::string("global_memory_limit")), count(memory_tracker.getGlobalLimit())},
+            {Value(std::string("memory_limit_hits")), count(memory_tracker.getLimitHits())},
+            {Value(std::string("result_cache")), count(result_cache.getBytes())}
+        };
+    });
+
+    database.registerVirtualTable("sys_running_queries", makeSchema({
+        Column("query_id", DataType::INTEGER),
+        Column("query", DataType::TEXT),
+        Column("elapsed_us", DataType::INTEGER),
+        Column("cancelled", DataType::BOOLEAN)
+    }), [&query_registry]() {
+        std::vector<Row> rows;
+        for (const auto& query : query_registry.getRunning()) {
+            rows.push_back({
+                count(query->getQueryId()),
+                Value(query->getSql()),
+                count(query->getElapsedMicros()),
+                Value(query->isCancelled())
+            });
+        }
+        return rows;
+    });
+
+    database.registerVirtualTable("sys_result_cache", makeSchema({
+        Column("entries", DataType::INTEGER),
+        Column("bytes", DataType::INTEGER),
+        Column("capacity", DataType::INTEGER),
+        Column("hits", DataType::INTEGER),
+        Column("misses", DataType::INTEGER),
+        Column("invalidations", DataType::INTEGER),
+        Column("evictions", DataType::INTEGER)
+    }), [&result_cache]() {
+        return std::vector<Row>{{
+            count(result_cache.getEntryCount()),
+            count(result_cache.getBytes()),
+            count(result_cache.getCapacity()),
+            count(result_cache.getHits()),
+            count(result_cache.getMisses()),
+            count(result_cache.getInvalidations()),
+            count(result_cache.getEvictions())
+        }};
+    });
+}
+
+} // namespace sqlengine